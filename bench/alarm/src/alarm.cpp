@@ -0,0 +1,51 @@
+#include "alarm.h"
+#include "dummy.h"
+
+Alarm::Alarm() {
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&cond, NULL);
+	rung = false;
+	timeouts = 0;
+}
+
+Alarm::~Alarm() {
+	pthread_cond_destroy(&cond);
+	pthread_mutex_destroy(&mutex);
+}
+
+void Alarm::ring_after(unsigned int secs) {
+
+	concurritStartInstrument();
+
+	sleep(secs);
+
+	pthread_mutex_lock(&mutex);
+	rung = true;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&mutex);
+
+	concurritEndInstrument();
+}
+
+bool Alarm::wait_for(unsigned int secs) {
+
+	concurritStartInstrument();
+
+	struct timespec abstime;
+	clock_gettime(CLOCK_REALTIME, &abstime);
+	abstime.tv_sec += secs;
+
+	pthread_mutex_lock(&mutex);
+	while(!rung) {
+		if(pthread_cond_timedwait(&cond, &mutex, &abstime) == ETIMEDOUT) {
+			break;
+		}
+	}
+	bool r = rung;
+	if(!r) timeouts++;
+	pthread_mutex_unlock(&mutex);
+
+	concurritEndInstrument();
+
+	return r;
+}
@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+// one thread rings the alarm after sleeping, others wait for it with a timeout
+class Alarm {
+public:
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool rung;
+	int timeouts;
+
+	Alarm();
+	~Alarm();
+
+	void ring_after(unsigned int secs);
+	bool wait_for(unsigned int secs);
+};
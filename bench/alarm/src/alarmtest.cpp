@@ -0,0 +1,98 @@
+#include <stdio.h>
+
+#include "alarm.h"
+
+#include "concurrit.h"
+
+
+void* ring_routine(void* arg)
+{
+
+  Alarm * alarm = (Alarm*) arg;
+
+  safe_assert(alarm != NULL);
+
+  alarm->ring_after(1);
+
+  return NULL;
+}
+
+void* wait_routine(void* arg)
+{
+
+  Alarm * alarm = (Alarm*) arg;
+
+  safe_assert(alarm != NULL);
+
+  alarm->wait_for(2);
+
+  return NULL;
+}
+
+
+CONCURRIT_BEGIN_MAIN()
+
+//============================================================//
+//============================================================//
+
+CONCURRIT_BEGIN_TEST(AlarmScenario, "Sleep and timed wait scenario")
+
+	SETUP() {
+		safe_assert(alarm == NULL);
+		alarm = new Alarm();
+	}
+
+	//---------------------------------------------
+
+	TEARDOWN() {
+		if(alarm != NULL) {
+			// the alarm rings at 1 second on the virtual clock, before the 2 second timeout in every interleaving
+			concurritAssert(alarm->rung);
+			concurritAssert(alarm->timeouts == 0);
+			delete alarm;
+		}
+		alarm = NULL;
+	}
+
+	//---------------------------------------------
+	Alarm* alarm;
+	//---------------------------------------------
+
+	TESTCASE() {
+		CALL_TEST(SearchSleeps);
+	}
+
+	//============================================================//
+
+	// GLOG_v=0 scripts/run_bench.sh alarm -g
+	// sleeps do not block, and the timed wait times out only when the virtual clock reaches its deadline
+	TEST(SearchSleeps) {
+
+		MAX_WAIT_TIME(3*USECSPERSEC);
+
+		CREATE_THREAD(1, wait_routine, (void*)alarm);
+		CREATE_THREAD(2, ring_routine, (void*)alarm);
+
+		TVAR(t1);
+		TVAR(t2);
+
+		EXISTS(t1, PTRUE, "Select thread t1");
+		EXISTS(t2, NOT(t1), "Select thread t2");
+
+		RUN_THREAD_THROUGH(t2, SLEEPS(), "t2 sleeps before ringing");
+
+		WHILE(!HAVE_ENDED(t1, t2)) {
+
+			TVAR(t);
+			CHOOSE_THREAD_BACKTRACK(t, (t1, t2), PTRUE, "Select t");
+			RUN_THREAD_THROUGH(t, WRITES() || ENDS(), "Run t until...");
+		}
+	}
+
+CONCURRIT_END_TEST(AlarmScenario)
+
+//============================================================//
+//============================================================//
+
+
+CONCURRIT_END_MAIN()
@@ -0,0 +1,125 @@
+#include <stdio.h>
+
+#include "spinlock.h"
+
+#define NUM_THREADS 2
+
+#include "concurrit.h"
+
+
+void* increment_routine(void* arg)
+{
+
+  SpinCounter * counter = (SpinCounter*) arg;
+
+  safe_assert(counter != NULL);
+
+  counter->increment_locked();
+  counter->increment_atomic();
+
+  return NULL;
+}
+
+
+CONCURRIT_BEGIN_MAIN()
+
+//============================================================//
+//============================================================//
+
+CONCURRIT_BEGIN_TEST(AtomicsScenario, "Spin lock and fetch-and-add scenario")
+
+	SETUP() {
+		safe_assert(counter == NULL);
+		counter = new SpinCounter();
+	}
+
+	//---------------------------------------------
+
+	TEARDOWN() {
+		if(counter != NULL) {
+			concurritAssert(counter->locked_count == NUM_THREADS);
+			concurritAssert(counter->atomic_count == NUM_THREADS);
+			delete counter;
+		}
+		counter = NULL;
+	}
+
+	//---------------------------------------------
+	SpinCounter* counter;
+	//---------------------------------------------
+
+	TESTCASE() {
+		CALL_TEST(SearchAtomics);
+	}
+
+	//============================================================//
+
+	// GLOG_v=0 scripts/run_bench.sh atomics -eatomic
+	// the only scheduling points are the atomic instructions, fences and thread ends
+	TEST(SearchAtomics) {
+
+		MAX_WAIT_TIME(3*USECSPERSEC);
+
+		for (int i = 0; i < NUM_THREADS; i++)
+		{
+			CREATE_THREAD(i+1, increment_routine, (void*)counter);
+		}
+
+		TVAR(t1);
+		TVAR(t2);
+
+		EXISTS(t1, PTRUE, "Select thread t1");
+		EXISTS(t2, NOT(t1), "Select thread t2");
+
+		RUN_THREAD_THROUGH(t1, ATOMIC((void*)&counter->word), "t1 takes the lock");
+
+		RUN_THREAD_THROUGH_N(t2, ATOMIC((void*)&counter->word), 2, "t2 fails to take the lock");
+
+		RUN_THREAD_THROUGH(t1, FENCES(), "t1 releases the lock");
+
+		WHILE(!HAVE_ENDED(t1, t2)) {
+
+			TVAR(t);
+			CHOOSE_THREAD_BACKTRACK(t, (t1, t2), PTRUE, "Select t");
+			RUN_THREAD_THROUGH(t, ATOMIC() || ENDS(), "Run t until...");
+		}
+	}
+
+	//============================================================//
+
+	// GLOG_v=0 scripts/run_bench.sh atomics -eauto
+	// the scheduling points follow the pending predicate: first writes of the count, then atomic instructions
+	TEST(SearchAuto) {
+
+		MAX_WAIT_TIME(3*USECSPERSEC);
+
+		for (int i = 0; i < NUM_THREADS; i++)
+		{
+			CREATE_THREAD(i+1, increment_routine, (void*)counter);
+		}
+
+		TVAR(t1);
+		TVAR(t2);
+
+		EXISTS(t1, PTRUE, "Select thread t1");
+		EXISTS(t2, NOT(t1), "Select thread t2");
+
+		RUN_THREAD_THROUGH(t1, READS(&counter->locked_count), "t1 reads the count in the critical section");
+
+		RUN_THREAD_THROUGH(t2, ATOMIC((void*)&counter->word), "t2 spins on the lock");
+
+		WHILE(!HAVE_ENDED(t1, t2)) {
+
+			TVAR(t);
+			CHOOSE_THREAD_BACKTRACK(t, (t1, t2), PTRUE, "Select t");
+			RUN_THREAD_THROUGH(t, ATOMIC((void*)&counter->atomic_count) || ENDS(), "Run t until...");
+		}
+	}
+
+CONCURRIT_END_TEST(AtomicsScenario)
+
+//============================================================//
+//============================================================//
+
+
+CONCURRIT_END_MAIN()
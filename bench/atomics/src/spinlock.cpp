@@ -0,0 +1,44 @@
+#include "spinlock.h"
+#include "dummy.h"
+
+SpinCounter::SpinCounter() {
+	word = 0;
+	locked_count = 0;
+	atomic_count = 0;
+}
+
+SpinCounter::~SpinCounter() {}
+
+void SpinCounter::lock() {
+	while(__sync_lock_test_and_set(&word, 1) != 0) {
+		while(word != 0) {
+			// spin
+		}
+	}
+}
+
+void SpinCounter::unlock() {
+	__sync_synchronize();
+	word = 0;
+}
+
+void SpinCounter::increment_locked() {
+
+	concurritStartInstrument();
+
+	lock();
+	long c = locked_count;
+	locked_count = c + 1;
+	unlock();
+
+	concurritEndInstrument();
+}
+
+void SpinCounter::increment_atomic() {
+
+	concurritStartInstrument();
+
+	__sync_fetch_and_add(&atomic_count, 1);
+
+	concurritEndInstrument();
+}
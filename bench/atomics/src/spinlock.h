@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+// test-and-set lock guarding a counter, and a lock-free counter updated with fetch-and-add
+class SpinCounter {
+public:
+	volatile int word;
+	long locked_count;
+	volatile long atomic_count;
+
+	SpinCounter();
+	~SpinCounter();
+
+	void lock();
+	void unlock();
+
+	void increment_locked();
+	void increment_atomic();
+};
@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) 2010-2011,
+ * Tayfun Elmas    <elmas@cs.berkeley.edu>
+ * All rights reserved.
+ * <p/>
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * <p/>
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * <p/>
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * <p/>
+ * 3. The names of the contributors may not be used to endorse or promote
+ * products derived from this software without specific prior written
+ * permission.
+ * <p/>
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "concurrit.h"
+
+using namespace concurrit;
+
+/********************************************************************************/
+
+static double now_in_nsecs() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// the former store of keyed auxiliary variables: one map per thread, all behind one rwlock
+template<typename K, typename T, K undef_key_, T undef_value_>
+class MapAuxVar1 {
+	typedef std::map<K, T> MM;
+	typedef std::map<THREADID, MM> M;
+public:
+	void set(const K& key, const T& value, THREADID t) {
+		ScopeWLock lock(&rwlock_);
+		MM& mm = map_[t];
+		if(value == undef_value_) {
+			typename MM::iterator itr = mm.find(key);
+			if(itr != mm.end()) mm.erase(itr);
+		} else {
+			mm[key] = value;
+		}
+	}
+
+	bool isset(THREADID t) {
+		ScopeRLock lock(&rwlock_);
+		typename M::iterator itr = map_.find(t);
+		return itr != map_.end() && !itr->second.empty();
+	}
+
+	void reset(THREADID t) {
+		ScopeWLock lock(&rwlock_);
+		typename M::iterator itr = map_.find(t);
+		if(itr != map_.end()) {
+			itr->second.clear();
+		}
+	}
+
+private:
+	RWLock rwlock_;
+	M map_;
+};
+
+/********************************************************************************/
+
+// one event of a transition: the thread records four accesses, then resets them when the transition ends
+template<typename V>
+static void RunEvents(V* var, THREADID tid, int rounds) {
+	const ADDRINT base = 0x1000 * (tid + 1);
+	for(int i = 0; i < rounds; ++i) {
+		var->set(base, 4, tid);
+		var->set(base + 8, 8, tid);
+		var->set(base + 16, 4, tid);
+		var->set(base + 24, 1, tid);
+		var->reset(tid);
+	}
+}
+
+template<typename V>
+struct RunArgs {
+	V* var;
+	THREADID tid;
+	int rounds;
+};
+
+template<typename V>
+static void* RunThread(void* p) {
+	RunArgs<V>* args = static_cast<RunArgs<V>*>(p);
+	RunEvents(args->var, args->tid, args->rounds);
+	return NULL;
+}
+
+// nanoseconds per event, with nthreads threads updating their own slots at the same time
+template<typename V>
+static double Measure(V* var, int nthreads, int rounds) {
+	std::vector<pthread_t> threads(nthreads);
+	std::vector<RunArgs<V> > args(nthreads);
+	double start = now_in_nsecs();
+	for(int i = 0; i < nthreads; ++i) {
+		args[i].var = var;
+		args[i].tid = i;
+		args[i].rounds = rounds;
+		safe_check(pthread_create(&threads[i], NULL, RunThread<V>, &args[i]) == 0);
+	}
+	for(int i = 0; i < nthreads; ++i) {
+		safe_check(pthread_join(threads[i], NULL) == 0);
+	}
+	return (now_in_nsecs() - start) / (double(rounds) * nthreads);
+}
+
+/********************************************************************************/
+
+int main(int argc, char** argv) {
+	int rounds = (argc > 1) ? atoi(argv[1]) : 1000000;
+	const int Trials = 5;
+
+	AuxState::Init();
+
+	const int nthreads_list[] = {1, 2, 4, 8};
+	for(size_t k = 0; k < sizeof(nthreads_list) / sizeof(int); ++k) {
+		const int nthreads = nthreads_list[k];
+		double map_nsecs = 0, slot_nsecs = 0;
+		for(int i = 0; i < Trials; ++i) {
+			MapAuxVar1<ADDRINT, uint32_t, 0, 0> map_var;
+			double nsecs = Measure(&map_var, nthreads, rounds / Trials);
+			map_nsecs = (map_nsecs == 0 || nsecs < map_nsecs) ? nsecs : map_nsecs;
+
+			AuxVar1<ADDRINT, uint32_t, 0, 0> slot_var("Reads");
+			nsecs = Measure(&slot_var, nthreads, rounds / Trials);
+			slot_nsecs = (slot_nsecs == 0 || nsecs < slot_nsecs) ? nsecs : slot_nsecs;
+
+			safe_check(!map_var.isset(0) && !slot_var.isset(0));
+		}
+		printf("threads: %2d  map+rwlock: %6.1f ns/event  slot tables: %6.1f ns/event\n", nthreads, map_nsecs, slot_nsecs);
+	}
+
+	return 0;
+}
@@ -0,0 +1,24 @@
+#include "account.h"
+#include "dummy.h"
+
+Account::Account() {
+	balance = 0;
+	memset(history, 0, sizeof(history));
+	num_deposits = 0;
+}
+
+Account::~Account() {}
+
+void Account::deposit(long amount) {
+
+	concurritStartInstrument();
+
+	long b = balance;
+	balance = b + amount;
+
+	int i = num_deposits;
+	history[i % HISTORY_SIZE] = amount;
+	num_deposits = i + 1;
+
+	concurritEndInstrument();
+}
@@ -0,0 +1,21 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#define HISTORY_SIZE 8
+
+// balance with a log of the deposits, updated without synchronization
+class Account {
+public:
+	long balance;
+	long history[HISTORY_SIZE];
+	int num_deposits;
+
+	Account();
+	~Account();
+
+	void deposit(long amount);
+};
@@ -0,0 +1,125 @@
+#include <stdio.h>
+
+#include "account.h"
+
+#define NUM_THREADS 2
+#define NUM_DEPOSITS 4
+
+#include "concurrit.h"
+
+
+void* deposit_routine(void* arg)
+{
+
+  Account * account = (Account*) arg;
+
+  safe_assert(account != NULL);
+
+  for (int i = 0; i < NUM_DEPOSITS; i++)
+  {
+    account->deposit(1);
+  }
+
+  return NULL;
+}
+
+
+CONCURRIT_BEGIN_MAIN()
+
+//============================================================//
+//============================================================//
+
+CONCURRIT_BEGIN_TEST(BatchScenario, "Batched steps over an unsynchronized account")
+
+	SETUP() {
+		safe_assert(account == NULL);
+		account = new Account();
+	}
+
+	//---------------------------------------------
+
+	TEARDOWN() {
+		if(account != NULL)
+			delete account;
+		account = NULL;
+	}
+
+	//---------------------------------------------
+	Account* account;
+	//---------------------------------------------
+
+	TESTCASE() {
+		CALL_TEST(RunThroughN);
+	}
+
+	//============================================================//
+
+	// GLOG_v=0 scripts/run_bench.sh batch -i -j
+	// t1 consumes two writes of the balance in one handoff, t2 then logs a deposit in between
+	TEST(RunThroughN) {
+
+		MAX_WAIT_TIME(3*USECSPERSEC);
+
+		for (int i = 0; i < NUM_THREADS; i++)
+		{
+			CREATE_THREAD(i+1, deposit_routine, (void*)account);
+		}
+
+		TVAR(t1);
+		TVAR(t2);
+
+		EXISTS(t1, PTRUE, "Select thread t1");
+		EXISTS(t2, NOT(t1), "Select thread t2");
+
+		RUN_THREAD_THROUGH_N(t1, WRITES(&account->balance), 2, "t1 deposits twice");
+
+		RUN_THREAD_THROUGH(t2, WRITES_RANGE(account->history, sizeof(account->history)), "t2 logs a deposit");
+
+		RUN_THREAD_THROUGH_N(t1, READS(&account->balance) || WRITES(&account->balance), 3, "t1 reads and writes the balance");
+
+		WHILE(!HAVE_ENDED(t1, t2)) {
+
+			TVAR(t);
+			CHOOSE_THREAD_BACKTRACK(t, (t1, t2), PTRUE, "Select t");
+			RUN_THREAD_THROUGH(t, ACCESSES_RANGE(account, sizeof(Account)) || ENDS(), "Run t until...");
+		}
+	}
+
+	//============================================================//
+
+	// GLOG_v=0 scripts/run_bench.sh batch -i
+	// same interleaving with the inlined predicates, which record all accesses
+	TEST(RunThroughNExpr) {
+
+		MAX_WAIT_TIME(3*USECSPERSEC);
+
+		for (int i = 0; i < NUM_THREADS; i++)
+		{
+			CREATE_THREAD(i+1, deposit_routine, (void*)account);
+		}
+
+		TVAR(t1);
+		TVAR(t2);
+
+		EXISTS(t1, PTRUE, "Select thread t1");
+		EXISTS(t2, NOT(t1), "Select thread t2");
+
+		RUN_THREAD_THROUGH_N(t1, E_WRITES(), 2, "t1 writes twice");
+
+		RUN_THREAD_THROUGH(t2, E_WRITES() || E_ENDS(t2), "t2 writes once");
+
+		WHILE(!HAVE_ENDED(t1, t2)) {
+
+			TVAR(t);
+			CHOOSE_THREAD_BACKTRACK(t, (t1, t2), PTRUE, "Select t");
+			RUN_THREAD_THROUGH(t, E_ACCESSES() || E_ENDS(), "Run t until...");
+		}
+	}
+
+CONCURRIT_END_TEST(BatchScenario)
+
+//============================================================//
+//============================================================//
+
+
+CONCURRIT_END_MAIN()
@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) 2010-2011,
+ * Tayfun Elmas    <elmas@cs.berkeley.edu>
+ * All rights reserved.
+ * <p/>
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * <p/>
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * <p/>
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * <p/>
+ * 3. The names of the contributors may not be used to endorse or promote
+ * products derived from this software without specific prior written
+ * permission.
+ * <p/>
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "concurrit.h"
+
+using namespace concurrit;
+
+/********************************************************************************/
+
+static int x, y, z;
+static void f() {}
+static void g() {}
+static void loop() {}
+
+struct Event {
+	EventKind kind;
+	void* addr; // the address accessed, or the function called
+};
+
+// one iteration of a loop in the code under test (in loop): a call to g, and accesses to z with their scheduling points
+static const Event LoopEvents[] = {
+	{ FuncCall, (void*) &g },
+	{ MemRead, &z }, { MemAccessBefore, NULL },
+	{ MemWrite, &z }, { MemAccessBefore, NULL },
+	{ MemRead, &z }, { MemAccessBefore, NULL },
+	{ MemWrite, &z }, { MemAccessBefore, NULL },
+};
+
+static const int NumLoopEvents = sizeof(LoopEvents) / sizeof(Event);
+
+struct Run {
+	int transitions;
+	int evals; // conjuncts evaluated
+};
+
+// replays the events of the loop as PinMonitor handles them, and evaluates the installed constraints at each scheduling point.
+// precise passes the changes of AuxUpdatesOf, otherwise those of AuxChangesOf as before
+static Run Replay(const TransitionConstraintsPtr& constraints, Coroutine* co, int iterations, bool precise) {
+	TransitionConjunction conjunction;
+	conjunction.Update(constraints);
+
+	// the programs of the conjuncts, evaluated in full to check the cached values
+	std::vector<PredicateProgram> programs(constraints->size());
+	for(size_t i = 0; i < constraints->size(); ++i) {
+		programs[i].Compile((*constraints)[i]);
+	}
+
+	const THREADID tid = co->tid();
+	AuxState::Tid->set_thread(co);
+	unsigned tree_version = 1;
+	Run run = { 0, 0 };
+	for(int i = 0; i < iterations; ++i) {
+		// the node changes now and then, and the thread reads x and writes y in some iterations
+		if(i % 64 == 0) ++tree_version;
+		for(int k = 0; k < NumLoopEvents; ++k) {
+			Event event = LoopEvents[k];
+			if(k == 1 && i % 16 == 0) event.addr = &x;
+			if(k == 3 && i % 32 == 0) event.addr = &y;
+
+			// the updates of the auxiliary state, as in PinMonitor, x and y are the watched addresses
+			switch(event.kind) {
+			case MemRead:
+				if(event.addr == &x) {
+					AuxState::Reads->set(PTR2ADDRINT(event.addr), 4, tid);
+					co->OnAuxChanges(AUXDEP_READS);
+				}
+				continue;
+			case MemWrite:
+				if(event.addr == &y) {
+					AuxState::Writes->set(PTR2ADDRINT(event.addr), 4, tid);
+					co->OnAuxChanges(AUXDEP_WRITES);
+				}
+				continue;
+			case FuncCall:
+				AuxState::CallsFrom->set(PTR2ADDRINT((void*) &loop), true, tid);
+				AuxState::CallsTo->set(PTR2ADDRINT(event.addr), true, tid);
+				break;
+			default:
+				break;
+			}
+
+			// the scheduling point
+			co->OnAuxChanges(precise ? PinMonitor::AuxUpdatesOf(event.kind) : PinMonitor::AuxChangesOf(event.kind));
+			conjunction.AddChanges(tid, co->TakeAuxChanges());
+			const bool result = conjunction.Eval(co, tree_version, &run.evals);
+
+			bool expected = true;
+			for(size_t c = 0; c < programs.size() && expected; ++c) {
+				expected = programs[c].Eval(co);
+			}
+			if(result != expected) {
+				safe_fail("Cached conjuncts evaluate to %d, not to %d, at event %d of iteration %d", result, expected, k, i);
+			}
+			++run.transitions;
+
+			// the thread finishes the transition
+			AuxState::Reset(tid);
+		}
+	}
+	return run;
+}
+
+/********************************************************************************/
+
+int main(int argc, char** argv) {
+	int iterations = (argc > 1) ? atoi(argv[1]) : 1024;
+
+	AuxState::Init();
+
+	Coroutine* co1 = new Coroutine(1, NULL);
+	Coroutine* co2 = new Coroutine(2, NULL);
+	ThreadVarPtr t2(new ThreadVar(co2, "t2"));
+
+	// the constraints a test installs with CONSTRAIN_ALL
+	TransitionConstraintsPtr constraints(new TransitionConstraints());
+	constraints->push_back(TransitionPredicatePtr(new TransitionConstraintAll(!READS(&x))));
+	constraints->push_back(TransitionPredicatePtr(new TransitionConstraintAll(!WRITES(&y))));
+	constraints->push_back(TransitionPredicatePtr(new TransitionConstraintAll(!CALLS((void*) &f))));
+	constraints->push_back(TransitionPredicatePtr(new TransitionConstraintAll(!ENDS())));
+	constraints->push_back(TransitionPredicatePtr(new TransitionConstraintAll(TID != t2)));
+	const int n = constraints->size();
+
+	Run before = Replay(constraints, co1, iterations, false);
+	Run after = Replay(constraints, co1, iterations, true);
+	safe_check(before.transitions == after.transitions);
+
+	printf("transitions: %d  conjuncts: %d\n", after.transitions, n);
+	printf("without the cache:               %5.2f conjuncts evaluated per transition\n", double(n));
+	printf("accesses passing READS|WRITES:   %5.2f conjuncts evaluated per transition\n", double(before.evals) / before.transitions);
+	printf("accesses passing their updates:  %5.2f conjuncts evaluated per transition\n", double(after.evals) / after.transitions);
+	safe_check(after.evals < before.evals && before.evals < n * before.transitions);
+
+	return 0;
+}
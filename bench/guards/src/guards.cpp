@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2010-2011,
+ * Tayfun Elmas    <elmas@cs.berkeley.edu>
+ * All rights reserved.
+ * <p/>
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * <p/>
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * <p/>
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * <p/>
+ * 3. The names of the contributors may not be used to endorse or promote
+ * products derived from this software without specific prior written
+ * permission.
+ * <p/>
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "concurrit.h"
+
+using namespace concurrit;
+
+/********************************************************************************/
+
+// the events of one iteration of a loop in the code under test: a call, four reads and two writes,
+// each access after its scheduling point, and an atomic update
+static const EventKind LoopEvents[] = {
+	FuncCall,
+	MemAccessBefore, MemRead, MemAccessBefore, MemRead, MemAccessBefore, MemWrite,
+	MemAccessBefore, MemRead, MemAccessBefore, MemRead, MemAccessBefore, MemWrite,
+	AtomicAccess
+};
+
+static const int NumLoopEvents = sizeof(LoopEvents) / sizeof(EventKind);
+
+struct EventCounts {
+	int not_instrumented; // no analysis call is inserted for the event
+	int guarded_out; // the inlined guard of the pin tool drops the event
+	int delivered; // the pin tool calls back into concurrit
+};
+
+// the events of the thread while it takes a node with the dependencies again and again,
+// after the first callback returned the kinds the thread can drop
+static EventCounts Count(unsigned dependencies, int iterations, bool guards) {
+	const uint32_t instrumented = PinMonitor::InstrumentedKinds(dependencies);
+	const uint32_t skip_kinds = guards ? PinMonitor::SkippableKinds(dependencies) : 0;
+	EventCounts counts = { 0, 0, 0 };
+	for(int i = 0; i < iterations; ++i) {
+		for(int k = 0; k < NumLoopEvents; ++k) {
+			const uint32_t bit = 1U << LoopEvents[k];
+			if((instrumented & bit) == 0) {
+				++counts.not_instrumented;
+			} else if((skip_kinds & bit) != 0) {
+				++counts.guarded_out;
+			} else {
+				++counts.delivered;
+			}
+		}
+	}
+	return counts;
+}
+
+static EventCounts Measure(const char* name, const TransitionPredicatePtr& pred, int iterations, bool guards = true) {
+	PredicateProgram program;
+	program.Compile(pred);
+	EventCounts counts = Count(program.dependencies(), iterations, guards);
+	const int total = iterations * NumLoopEvents;
+	safe_check(counts.not_instrumented + counts.guarded_out + counts.delivered == total);
+	printf("%-24s events: %d  not instrumented: %5.1f%%  guarded out: %5.1f%%  delivered: %5.1f%%\n", name, total,
+			100.0 * counts.not_instrumented / total, 100.0 * counts.guarded_out / total, 100.0 * counts.delivered / total);
+	return counts;
+}
+
+/********************************************************************************/
+
+int main(int argc, char** argv) {
+	int iterations = (argc > 1) ? atoi(argv[1]) : 1000;
+
+	AuxState::Init();
+
+	const unsigned scheduling_points = Config::SchedulingPoints;
+	const bool scoped = Config::ScopedInstrumentation;
+
+	// every event reaches concurrit without scoping and guards
+	Config::ScopedInstrumentation = false;
+	printf("without scoped instrumentation and guards:\n");
+	EventCounts all = Measure("READS", READS(), iterations, false);
+	safe_check(all.delivered == iterations * NumLoopEvents);
+
+	Config::ScopedInstrumentation = true;
+
+	// all kinds but synchronization operations are scheduling points, so the guards drop the events
+	printf("default scheduling points:\n");
+	EventCounts reads = Measure("READS", READS(), iterations);
+	EventCounts calls = Measure("CALLS", CALLS(), iterations);
+	EventCounts ends = Measure("ENDS", ENDS(), iterations);
+	// a node over reads needs the reads and the scheduling points of the accesses, but not the writes and the call
+	safe_check(reads.not_instrumented == 2 * iterations && reads.guarded_out == iterations);
+	// a node over calls needs only the call
+	safe_check(calls.not_instrumented == 6 * iterations && calls.delivered == iterations);
+	safe_check(ends.delivered == 0);
+
+	// only synchronization operations are scheduling points, so the events no predicate needs are not instrumented
+	Config::SchedulingPoints = (1U << SyncLock) | (1U << SyncUnlock) | (1U << SyncWait) | (1U << SyncSignal);
+	printf("-esync:\n");
+	reads = Measure("READS", READS(), iterations);
+	calls = Measure("CALLS", CALLS(), iterations);
+	ends = Measure("ENDS", ENDS(), iterations);
+	safe_check(ends.not_instrumented == iterations * NumLoopEvents);
+	safe_check(calls.delivered == iterations);
+
+	// a trace sees every event
+	Config::SaveExecutionTraceToFile = true;
+	printf("saving the trace:\n");
+	ends = Measure("ENDS", ENDS(), iterations);
+	safe_check(ends.delivered == iterations * NumLoopEvents);
+	Config::SaveExecutionTraceToFile = false;
+
+	Config::SchedulingPoints = scheduling_points;
+	Config::ScopedInstrumentation = scoped;
+
+	return 0;
+}
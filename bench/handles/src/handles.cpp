@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) 2010-2011,
+ * Tayfun Elmas    <elmas@cs.berkeley.edu>
+ * All rights reserved.
+ * <p/>
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * <p/>
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * <p/>
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * <p/>
+ * 3. The names of the contributors may not be used to endorse or promote
+ * products derived from this software without specific prior written
+ * permission.
+ * <p/>
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "refcount.h"
+
+#include <boost/shared_ptr.hpp>
+#include <pthread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+using namespace concurrit;
+
+/********************************************************************************/
+
+// the engine copies the handles of the operands of a predicate and of the thread variables while
+// evaluating a transition. all threads copy the handles of the same objects, so with atomic counts
+// the counts bounce between the caches of the threads. run under "perf stat -e cache-misses" to see that.
+
+struct SharedNode {
+	virtual ~SharedNode() {}
+	virtual bool Eval(int tid) { return (tid & 1) != 0; }
+};
+
+struct AtomicNode : public RefCounted<AtomicNode> {
+	virtual ~AtomicNode() {}
+	virtual bool Eval(int tid) { return (tid & 1) != 0; }
+};
+
+struct LocalNode : public LocalRefCounted<LocalNode> {
+	virtual ~LocalNode() {}
+	virtual bool Eval(int tid) { return (tid & 1) != 0; }
+};
+
+static const int NumOperands = 8;
+
+static std::vector<boost::shared_ptr<SharedNode>> shared_nodes;
+static std::vector<boost::intrusive_ptr<AtomicNode>> atomic_nodes;
+static std::vector<boost::intrusive_ptr<LocalNode>> local_nodes;
+
+static int rounds = 1000000;
+static int mode = 0;
+
+static double now_in_nsecs() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// evaluates the operands as NAryTransitionPredicate::EvalState does
+template<typename Ptr, bool copy>
+static int EvalAll(std::vector<Ptr>& nodes, int tid) {
+	int count = 0;
+	for(int i = 0; i < rounds; ++i) {
+		for(typename std::vector<Ptr>::iterator itr = nodes.begin(); itr != nodes.end(); ++itr) {
+			if(copy) {
+				Ptr current = (*itr);
+				count += current->Eval(tid + i);
+			} else {
+				const Ptr& current = (*itr);
+				count += current->Eval(tid + i);
+			}
+		}
+	}
+	return count;
+}
+
+static void* thread_func(void* arg) {
+	int tid = static_cast<int>(reinterpret_cast<intptr_t>(arg));
+	int count = 0;
+	switch(mode) {
+	case 0: count = EvalAll<boost::shared_ptr<SharedNode>, true>(shared_nodes, tid); break;
+	case 1: count = EvalAll<boost::intrusive_ptr<AtomicNode>, true>(atomic_nodes, tid); break;
+	case 2: count = EvalAll<boost::intrusive_ptr<LocalNode>, true>(local_nodes, tid); break;
+	case 3: count = EvalAll<boost::intrusive_ptr<AtomicNode>, false>(atomic_nodes, tid); break;
+	default: abort();
+	}
+	return reinterpret_cast<void*>(static_cast<intptr_t>(count));
+}
+
+static void Measure(const char* name, int num_threads) {
+	std::vector<pthread_t> threads(num_threads);
+	double start = now_in_nsecs();
+	for(int k = 0; k < num_threads; ++k) {
+		pthread_create(&threads[k], NULL, thread_func, reinterpret_cast<void*>(static_cast<intptr_t>(k)));
+	}
+	for(int k = 0; k < num_threads; ++k) {
+		pthread_join(threads[k], NULL);
+	}
+	double nsecs = now_in_nsecs() - start;
+	double evals = double(rounds) * NumOperands * num_threads;
+	printf("%-40s %2d threads: %6.2f ns per operand, %8.1f M operands/s\n", name, num_threads,
+			nsecs / evals * num_threads, evals / nsecs * 1e3);
+}
+
+/********************************************************************************/
+
+int main(int argc, char** argv) {
+	rounds = (argc > 1) ? atoi(argv[1]) : 1000000;
+	int max_threads = (argc > 2) ? atoi(argv[2]) : 4;
+
+	for(int i = 0; i < NumOperands; ++i) {
+		shared_nodes.push_back(boost::shared_ptr<SharedNode>(new SharedNode()));
+		atomic_nodes.push_back(boost::intrusive_ptr<AtomicNode>(new AtomicNode()));
+		local_nodes.push_back(boost::intrusive_ptr<LocalNode>(new LocalNode()));
+	}
+
+	for(int n = 1; n <= max_threads; n *= 2) {
+		mode = 0; Measure("copy boost::shared_ptr", n);
+		mode = 1; Measure("copy intrusive_ptr (atomic count)", n);
+		// the local count is not safe to update concurrently
+		if(n == 1) { mode = 2; Measure("copy intrusive_ptr (local count)", n); }
+		mode = 3; Measure("borrow intrusive_ptr", n);
+	}
+
+	return 0;
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+
+#include "slot.h"
+
+#include "concurrit.h"
+
+
+void* put_routine(void* arg)
+{
+
+  Slot * slot = (Slot*) arg;
+
+  safe_assert(slot != NULL);
+
+  slot->put(1);
+
+  return NULL;
+}
+
+void* take_routine(void* arg)
+{
+
+  Slot * slot = (Slot*) arg;
+
+  safe_assert(slot != NULL);
+
+  int v = slot->take();
+  safe_assert(v == 1);
+
+  return NULL;
+}
+
+
+CONCURRIT_BEGIN_MAIN()
+
+//============================================================//
+//============================================================//
+
+CONCURRIT_BEGIN_TEST(LocksScenario, "Mutex and condition variable scenario")
+
+	SETUP() {
+		safe_assert(slot == NULL);
+		slot = new Slot();
+	}
+
+	//---------------------------------------------
+
+	TEARDOWN() {
+		if(slot != NULL) {
+			concurritAssert(slot->taken == 1);
+			concurritAssert(!slot->full);
+			delete slot;
+		}
+		slot = NULL;
+	}
+
+	//---------------------------------------------
+	Slot* slot;
+	//---------------------------------------------
+
+	TESTCASE() {
+		CALL_TEST(SearchSync);
+	}
+
+	//============================================================//
+
+	// GLOG_v=0 scripts/run_bench.sh locks -esync
+	// the scheduling points are the pthread operations; a thread blocked in the original
+	// pthread_mutex_lock or pthread_cond_wait is not selected until the call returns
+	TEST(SearchSync) {
+
+		MAX_WAIT_TIME(3*USECSPERSEC);
+
+		CREATE_THREAD(1, take_routine, (void*)slot);
+		CREATE_THREAD(2, put_routine, (void*)slot);
+
+		TVAR(t1);
+		TVAR(t2);
+
+		EXISTS(t1, PTRUE, "Select thread t1");
+		EXISTS(t2, NOT(t1), "Select thread t2");
+
+		RUN_THREAD_THROUGH(t1, WAITS((void*)&slot->cond), "t1 finds the slot empty and waits");
+
+		RUN_THREAD_THROUGH(t2, LOCKS((void*)&slot->mutex), "t2 locks the slot");
+
+		RUN_THREAD_THROUGH(t2, SIGNALS((void*)&slot->cond), "t2 fills the slot and signals");
+
+		WHILE(!HAVE_ENDED(t1, t2)) {
+
+			TVAR(t);
+			CHOOSE_THREAD_BACKTRACK(t, (t1, t2), PTRUE, "Select t");
+			RUN_THREAD_THROUGH(t, LOCKS() || UNLOCKS() || ENDS(), "Run t until...");
+		}
+	}
+
+CONCURRIT_END_TEST(LocksScenario)
+
+//============================================================//
+//============================================================//
+
+
+CONCURRIT_END_MAIN()
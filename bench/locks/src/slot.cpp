@@ -0,0 +1,46 @@
+#include "slot.h"
+#include "dummy.h"
+
+Slot::Slot() {
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&cond, NULL);
+	full = false;
+	value = 0;
+	taken = 0;
+}
+
+Slot::~Slot() {
+	pthread_cond_destroy(&cond);
+	pthread_mutex_destroy(&mutex);
+}
+
+void Slot::put(int v) {
+
+	concurritStartInstrument();
+
+	pthread_mutex_lock(&mutex);
+	value = v;
+	full = true;
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&mutex);
+
+	concurritEndInstrument();
+}
+
+int Slot::take() {
+
+	concurritStartInstrument();
+
+	pthread_mutex_lock(&mutex);
+	while(!full) {
+		pthread_cond_wait(&cond, &mutex);
+	}
+	int v = value;
+	full = false;
+	taken++;
+	pthread_mutex_unlock(&mutex);
+
+	concurritEndInstrument();
+
+	return v;
+}
@@ -0,0 +1,21 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+// single-slot channel guarded by a mutex, takers wait on a condition variable while the slot is empty
+class Slot {
+public:
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool full;
+	int value;
+	int taken;
+
+	Slot();
+	~Slot();
+
+	void put(int v);
+	int take();
+};
@@ -0,0 +1,42 @@
+#include "pages.h"
+#include "dummy.h"
+
+static long* new_page() {
+	void* page = NULL;
+	if(posix_memalign(&page, PAGE_SIZE_BYTES, PAGE_SIZE_BYTES) != 0) {
+		fprintf(stderr, "Cannot allocate a page!\n");
+		exit(-1);
+	}
+	return static_cast<long*>(page);
+}
+
+Pages::Pages() {
+	for(int i = 0; i < NUM_WORKERS; ++i) {
+		own[i] = new_page();
+	}
+	shared = new_page();
+	for(int i = 0; i < NUM_WORKERS; ++i) {
+		shared[i] = 0;
+	}
+}
+
+Pages::~Pages() {
+	for(int i = 0; i < NUM_WORKERS; ++i) {
+		free(own[i]);
+	}
+	free(shared);
+}
+
+void Pages::work(int i) {
+
+	concurritStartInstrument();
+
+	long sum = 0;
+	for(int k = 0; k < 4; ++k) {
+		own[i][k] = k;
+		sum += own[i][k];
+	}
+	shared[i] = sum;
+
+	concurritEndInstrument();
+}
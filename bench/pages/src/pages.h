@@ -0,0 +1,20 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#define PAGE_SIZE_BYTES 4096
+#define NUM_WORKERS 2
+
+// each worker fills its own page, then stores its result in a page shared by the workers
+class Pages {
+public:
+	long* own[NUM_WORKERS];
+	long* shared;
+
+	Pages();
+	~Pages();
+
+	void work(int i);
+};
@@ -0,0 +1,97 @@
+#include <stdio.h>
+
+#include "pages.h"
+
+#include "concurrit.h"
+
+
+void* work0_routine(void* arg)
+{
+
+  Pages * pages = (Pages*) arg;
+
+  safe_assert(pages != NULL);
+
+  pages->work(0);
+
+  return NULL;
+}
+
+void* work1_routine(void* arg)
+{
+
+  Pages * pages = (Pages*) arg;
+
+  safe_assert(pages != NULL);
+
+  pages->work(1);
+
+  return NULL;
+}
+
+
+CONCURRIT_BEGIN_MAIN()
+
+//============================================================//
+//============================================================//
+
+CONCURRIT_BEGIN_TEST(PagesScenario, "Thread-private and shared pages scenario")
+
+	SETUP() {
+		safe_assert(pages == NULL);
+		pages = new Pages();
+	}
+
+	//---------------------------------------------
+
+	TEARDOWN() {
+		if(pages != NULL) {
+			concurritAssert(pages->shared[0] == 6);
+			concurritAssert(pages->shared[1] == 6);
+			delete pages;
+		}
+		pages = NULL;
+	}
+
+	//---------------------------------------------
+	Pages* pages;
+	//---------------------------------------------
+
+	TESTCASE() {
+		CALL_TEST(SearchUnshared);
+	}
+
+	//============================================================//
+
+	// GLOG_v=0 scripts/run_bench.sh pages -n
+	// the writes to a worker's own page are not scheduling points, as only it touches the page.
+	// the pages are usually reallocated at the same addresses, and the search replays each prefix
+	// in a new execution, which must stop at the same writes as the first time
+	TEST(SearchUnshared) {
+
+		MAX_WAIT_TIME(3*USECSPERSEC);
+
+		CREATE_THREAD(1, work0_routine, (void*)pages);
+		CREATE_THREAD(2, work1_routine, (void*)pages);
+
+		TVAR(t1);
+		TVAR(t2);
+
+		EXISTS(t1, PTRUE, "Select thread t1");
+		EXISTS(t2, NOT(t1), "Select thread t2");
+
+		WHILE(!HAVE_ENDED(t1, t2)) {
+
+			TVAR(t);
+			CHOOSE_THREAD_BACKTRACK(t, (t1, t2), PTRUE, "Select t");
+			RUN_THREAD_THROUGH(t, WRITES() || ENDS(), "Run t until a write to the shared page");
+		}
+	}
+
+CONCURRIT_END_TEST(PagesScenario)
+
+//============================================================//
+//============================================================//
+
+
+CONCURRIT_END_MAIN()
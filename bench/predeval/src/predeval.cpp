@@ -0,0 +1,178 @@
+/**
+ * Copyright (c) 2010-2011,
+ * Tayfun Elmas    <elmas@cs.berkeley.edu>
+ * All rights reserved.
+ * <p/>
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * <p/>
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * <p/>
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * <p/>
+ * 3. The names of the contributors may not be used to endorse or promote
+ * products derived from this software without specific prior written
+ * permission.
+ * <p/>
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "concurrit.h"
+
+using namespace concurrit;
+
+/********************************************************************************/
+
+static double now_in_nsecs() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// evaluates pred for each thread in threads, as in selecting a thread at a scheduling point.
+// the scenario ticks the sample clock for each transition, whichever form evaluates it
+static double EvalTree(const TransitionPredicatePtr& pred, std::vector<Coroutine*>& threads, int rounds, int* count) {
+	double start = now_in_nsecs();
+	for(int i = 0; i < rounds; ++i) {
+		for(size_t k = 0; k < threads.size(); ++k) {
+			AuxState::Tid->set_thread(threads[k]);
+			PredicateProgram::TickSampleClock();
+			if(pred->EvalState(threads[k])) ++(*count);
+		}
+	}
+	return now_in_nsecs() - start;
+}
+
+static double EvalProgram(PredicateProgram& program, std::vector<Coroutine*>& threads, int rounds, int* count) {
+	double start = now_in_nsecs();
+	for(int i = 0; i < rounds; ++i) {
+		for(size_t k = 0; k < threads.size(); ++k) {
+			AuxState::Tid->set_thread(threads[k]);
+			PredicateProgram::TickSampleClock();
+			if(program.Eval(threads[k])) ++(*count);
+		}
+	}
+	return now_in_nsecs() - start;
+}
+
+// the two forms run alternately in several trials, and the fastest trial of each is reported
+static void Measure(const char* name, const TransitionPredicatePtr& pred, std::vector<Coroutine*>& threads, int rounds) {
+	const int Trials = 10;
+
+	PredicateProgram program;
+	program.Compile(pred);
+
+	int tree_count = 0, program_count = 0;
+	double tree_nsecs = 0, program_nsecs = 0;
+	for(int i = 0; i < 2 * Trials; ++i) {
+		// the forms take turns in running first
+		if(((i / 2) % 2 == 0) == (i % 2 == 0)) {
+			double nsecs = EvalTree(pred, threads, rounds / Trials, &tree_count);
+			tree_nsecs = (tree_nsecs == 0 || nsecs < tree_nsecs) ? nsecs : tree_nsecs;
+		} else {
+			double nsecs = EvalProgram(program, threads, rounds / Trials, &program_count);
+			program_nsecs = (program_nsecs == 0 || nsecs < program_nsecs) ? nsecs : program_nsecs;
+		}
+	}
+
+	if(tree_count != program_count) {
+		safe_fail("Compiled program of %s disagrees with the tree: %d vs. %d", name, program_count, tree_count);
+	}
+
+	double evals = double(rounds / Trials) * threads.size();
+	printf("%-32s tree: %6.1f ns  program: %6.1f ns  (%s%s)\n", name,
+			tree_nsecs / evals, program_nsecs / evals, program.tree() != NULL ? "by tree: " : "", program.ToString().c_str());
+}
+
+// predicates over the current thread read only tracked auxiliary variables, so their transitions can be skipped
+static void CheckTracked(const char* name, const TransitionPredicatePtr& pred) {
+	PredicateProgram program;
+	program.Compile(pred);
+	if((program.dependencies() & AUXDEP_UNKNOWN) != 0) {
+		safe_fail("%s depends on untracked state: %s", name, program.ToString().c_str());
+	}
+}
+
+// every thread reads, so the last operand of the or decides it. sampling must move that operand first,
+// and the sampled evaluations in the adapted order must cost less than in the declared order
+static void MeasureReorder(std::vector<Coroutine*>& threads, int rounds) {
+	const int sample_rate = Config::AdaptiveSampleRate;
+	Config::AdaptiveSampleRate = 16;
+
+	for(size_t k = 0; k < threads.size(); ++k) {
+		AuxState::Reads->set(0x2000, 4, threads[k]->tid());
+	}
+
+	const uint64_t declared = AdaptiveNAry::sampled_declared_cycles();
+	const uint64_t adaptive = AdaptiveNAry::sampled_adaptive_cycles();
+	const unsigned long reorders = AdaptiveNAry::num_reorders();
+
+	Measure("WRITES||CALLS||HITS_PC||READS", WRITES() || CALLS() || HITS_PC() || READS(), threads, rounds);
+
+	const uint64_t declared_cycles = AdaptiveNAry::sampled_declared_cycles() - declared;
+	const uint64_t adaptive_cycles = AdaptiveNAry::sampled_adaptive_cycles() - adaptive;
+	const unsigned long num_reorders = AdaptiveNAry::num_reorders() - reorders;
+	printf("%-32s reorders: %lu  sampled cycles: %llu declared, %llu adapted\n", "", num_reorders,
+			static_cast<unsigned long long>(declared_cycles), static_cast<unsigned long long>(adaptive_cycles));
+	if(num_reorders == 0 || adaptive_cycles >= declared_cycles) {
+		safe_fail("Operands of WRITES||CALLS||HITS_PC||READS were not reordered");
+	}
+
+	Config::AdaptiveSampleRate = sample_rate;
+}
+
+/********************************************************************************/
+
+int main(int argc, char** argv) {
+	int rounds = (argc > 1) ? atoi(argv[1]) : 1000000;
+
+	AuxState::Init();
+
+	std::vector<Coroutine*> threads;
+	for(THREADID tid = 1; tid <= 4; ++tid) {
+		threads.push_back(new Coroutine(tid, NULL));
+	}
+
+	// thread 2 reads, thread 4 ends; the others have no events
+	AuxState::Reads->set(0x1000, 4, 2);
+	AuxState::Ends->set(true, 4);
+
+	ThreadVarPtr t1(new ThreadVar(threads[0], "t1"));
+	ThreadVarPtr t2(new ThreadVar(threads[1], "t2"));
+
+	CheckTracked("READS", READS());
+	CheckTracked("WRITES(x)", WRITES((void*)0x1000));
+	CheckTracked("ENDS", ENDS());
+	CheckTracked("!ENDS && (TID==t1 || READS)", !ENDS() && ((TID == t1) || READS()));
+	CheckTracked("E_READS||E_ENDS", E_READS() || E_ENDS());
+
+	Measure("READS||WRITES||CALLS||HITS_PC||ENDS", READS() || WRITES() || CALLS() || HITS_PC() || ENDS(), threads, rounds);
+	Measure("TID==t1 && READS", (TID == t1) && READS(), threads, rounds);
+	Measure("ANY_THREAD - t1 - t2", AnyThreadExpr::create() - t1 - t2, threads, rounds);
+	Measure("!ENDS && (PTRUE || READS)", !ENDS() && (TransitionPredicate::True() || READS()), threads, rounds);
+
+	// inlined expression predicates
+	Measure("E_READS||E_WRITES||E_CALLS||...", E_READS() || E_WRITES() || E_CALLS() || E_HITS_PC() || E_ENDS(), threads, rounds);
+	Measure("E_BY(t1) && E_READS", E_BY(t1) && E_READS(), threads, rounds);
+	Measure("E_COND(tid > 2) && !E_ENDS", E_COND(CURRENT_THREAD->tid() > 2) && !E_ENDS(), threads, rounds);
+
+	// adaptive order of pure operands, sets reads for all threads
+	MeasureReorder(threads, rounds);
+
+	return 0;
+}
@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2010-2011,
+ * Tayfun Elmas    <elmas@cs.berkeley.edu>
+ * All rights reserved.
+ * <p/>
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * <p/>
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * <p/>
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * <p/>
+ * 3. The names of the contributors may not be used to endorse or promote
+ * products derived from this software without specific prior written
+ * permission.
+ * <p/>
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "concurrit.h"
+
+using namespace concurrit;
+
+/********************************************************************************/
+
+static double now_in_nsecs() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// nanoseconds per check of a thread against the node, the same as when a thread offers itself to an EXISTS
+static double Measure(ExistsThreadNode* node, std::vector<Coroutine*>& threads, int rounds) {
+	const size_t n = threads.size();
+	int selected = 0;
+	double start = now_in_nsecs();
+	for(int i = 0; i < rounds; ++i) {
+		Coroutine* co = threads[(size_t(i) * 7919) % n];
+		if(node->CheckAndSelectThread(co) == 0) {
+			node->lvar()->clear_thread();
+			++selected;
+		}
+	}
+	double nsecs = (now_in_nsecs() - start) / rounds;
+	safe_check(selected > 0);
+	return nsecs;
+}
+
+/********************************************************************************/
+
+int main(int argc, char** argv) {
+	int rounds = (argc > 1) ? atoi(argv[1]) : 1000000;
+	const int Trials = 5;
+
+	const int nthreads_list[] = {16, 64, 256, 1024, 4096};
+	for(size_t k = 0; k < sizeof(nthreads_list) / sizeof(int); ++k) {
+		const int nthreads = nthreads_list[k];
+
+		// the threads are never started, only their identities are checked
+		std::vector<Coroutine*> threads;
+		ThreadVarPtrSet scope;
+		for(int i = 0; i < nthreads; ++i) {
+			Coroutine* co = new Coroutine(i + 1, NULL);
+			threads.push_back(co);
+			ThreadVarPtr t(new ThreadVar(co, "T" + to_string(i)));
+			scope.insert(t);
+		}
+
+		StaticDSLInfo info(RECORD_SRCLOC(), "EXISTS");
+		ExistsThreadNode scoped(&info, &scope);
+		ExistsThreadNode unscoped(&info, NULL);
+
+		double scoped_nsecs = 0, without_nsecs = 0, unscoped_nsecs = 0;
+		for(int i = 0; i < Trials; ++i) {
+			double nsecs = Measure(&scoped, threads, rounds / Trials);
+			scoped_nsecs = (scoped_nsecs == 0 || nsecs < scoped_nsecs) ? nsecs : scoped_nsecs;
+
+			nsecs = Measure(&unscoped, threads, rounds / Trials);
+			unscoped_nsecs = (unscoped_nsecs == 0 || nsecs < unscoped_nsecs) ? nsecs : unscoped_nsecs;
+
+			{ TVAR(late);
+			  WITHOUT(late);
+			  ExistsThreadNode restricted(&info, &scope);
+			  // bound after the block is entered and the node is created, still excluded
+			  late << threads[0];
+			  safe_check(restricted.CheckAndSelectThread(threads[0]) == -1);
+			  nsecs = Measure(&restricted, threads, rounds / Trials);
+			  without_nsecs = (without_nsecs == 0 || nsecs < without_nsecs) ? nsecs : without_nsecs;
+			}
+		}
+		printf("threads: %5d  scoped: %6.1f ns/check  scoped, WITHOUT: %6.1f ns/check  unscoped: %6.1f ns/check\n",
+				nthreads, scoped_nsecs, without_nsecs, unscoped_nsecs);
+	}
+
+	return 0;
+}
@@ -39,6 +39,7 @@
 #include "exception.h"
 #include "coroutine.h"
 #include "transpred.h"
+#include "predexpr.h"
 #include "pinmonitor.h"
 #include "threadvar.h"
 
@@ -85,23 +86,19 @@ namespace concurrit {
 /********************************************************************************/
 
 // represents a set of coroutines to restrict the group to the rest of those
+// the set is pushed on the current restriction, and popped on exit
 class WithoutThreads {
 public:
-	WithoutThreads(ThreadVarPtrSet* scope, ThreadVarPtrSet set) : scope_(scope), set_(set) {
-		safe_check(!set.empty());
-		for(ThreadVarPtrSet::iterator itr = set_.begin(), end = set_.end(); itr != end; ++itr) {
-			scope_->Remove(*itr);
-		}
+	WithoutThreads(ThreadVarPtrSet* set) : set_(set) {
+		safe_check(!set_->empty());
+		ThreadRestriction::Current()->Push(set_, false);
 	}
 
 	~WithoutThreads() {
-		for(ThreadVarPtrSet::iterator itr = set_.begin(), end = set_.end(); itr != end; ++itr) {
-			scope_->Add(*itr);
-		}
+		ThreadRestriction::Current()->Pop(set_, false);
 	}
 private:
-	DECL_FIELD(ThreadVarPtrSet*, scope)
-	DECL_FIELD_REF(ThreadVarPtrSet, set)
+	DECL_FIELD(ThreadVarPtrSet*, set)
 };
 
 /********************************************************************************/
@@ -109,43 +106,21 @@ private:
 // represents a set of coroutines to restrict the group to only those
 class WithThreads {
 public:
-	WithThreads(ThreadVarPtrSet* scope, ThreadVarPtrSet set) {
-		safe_check(!set.empty());
-		ThreadVarPtrSet others = *scope;
-		for(ThreadVarPtrSet::iterator itr = set.begin(), end = set.end(); itr != end; ++itr) {
-			others.erase(*itr);
-		}
-		without_ = new WithoutThreads(scope, others); // takes out others
+	WithThreads(ThreadVarPtrSet* set) : set_(set) {
+		safe_check(!set_->empty());
+		ThreadRestriction::Current()->Push(set_, true);
 	}
 
 	~WithThreads() {
-		delete without_; // puts back others
+		ThreadRestriction::Current()->Pop(set_, true);
 	}
 
 private:
-	DECL_FIELD_REF(WithoutThreads*, without)
+	DECL_FIELD(ThreadVarPtrSet*, set)
 };
 
 /********************************************************************************/
 
-/* restricting a block of code to a set of thread variables
- * usage:
- * { WITH(s);
- *   ....
- * }
- * { WITHOUT(s);
- *   ....
- * }
- */
-
-#define WITH(...) \
-	WithThreads ADD_LINE(__withthreads__)(scope(), MAKE_THREADVARPTRSET(__VA_ARGS__))
-
-#define WITHOUT(...) \
-	WithoutThreads ADD_LINE(__withoutthreads__)(scope(), MAKE_THREADVARPTRSET(__VA_ARGS__))
-
-/********************************************************************************/
-
 // this is used for the pin instrumentation
 //extern void BeginStrand(const char* name);
 
@@ -154,6 +129,10 @@ private:
 #define STATIC_DSL_INFO_NAME			ADD_LINE(__static_dsl_info_)
 #define	DECL_STATIC_DSL_INFO(code) 		static StaticDSLInfo STATIC_DSL_INFO_NAME (RECORD_SRCLOC(), (code));
 
+// evaluates e, building its predicates through the build cache of the static info of the statement,
+// so that later executions find them there instead of in PredicateTable
+#define DSL_BUILD(e)					(PredicateBuildScope(STATIC_DSL_INFO_NAME.predicates()), e)
+
 /********************************************************************************/
 
 #define STAR(nd, stmt, cond, code) 	static StaticChoiceInfo STATIC_DSL_INFO_NAME((nd), (RECORD_SRCLOC()), (code)); stmt((cond) && DSLChoice(&STATIC_DSL_INFO_NAME))
@@ -297,9 +276,9 @@ inline TransitionPredicatePtr _DISTINCT(ThreadVarPtrSet scope, ThreadVarPtr t =
 
 #define	DECL_STATIC_SELECT_THREAD_INFO(scope, code)		static StaticSelectThreadInfo STATIC_DSL_INFO_NAME (MAKE_THREADVARPTRSET scope, RECORD_SRCLOC(), (code));
 
-#define _EXISTS(op, t, s, ...)					DECL_STATIC_SELECT_THREAD_INFO(s, op " " #t); t << DSLExistsThread(&STATIC_DSL_INFO_NAME, (STATIC_DSL_INFO_NAME.scope()), ## __VA_ARGS__);
+#define _EXISTS(op, t, s, ...)					DECL_STATIC_SELECT_THREAD_INFO(s, op " " #t); t << DSL_BUILD(DSLExistsThread(&STATIC_DSL_INFO_NAME, (STATIC_DSL_INFO_NAME.scope()), ## __VA_ARGS__));
 
-#define _FORALL(op, t, s, ...)					DECL_STATIC_SELECT_THREAD_INFO(s, op " " #t); t << DSLForallThread(&STATIC_DSL_INFO_NAME, (STATIC_DSL_INFO_NAME.scope()), ## __VA_ARGS__);
+#define _FORALL(op, t, s, ...)					DECL_STATIC_SELECT_THREAD_INFO(s, op " " #t); t << DSL_BUILD(DSLForallThread(&STATIC_DSL_INFO_NAME, (STATIC_DSL_INFO_NAME.scope()), ## __VA_ARGS__));
 
 /********************************************************************************/
 
@@ -315,17 +294,36 @@ inline TransitionPredicatePtr _DISTINCT(ThreadVarPtrSet scope, ThreadVarPtr t =
 
 /********************************************************************************/
 
-#define ASSERT_ALL(pred) 			TransitionPredicatePtr __assertion_##__LINE__(pred); AssertionInstaller __assertion_installer_##__LINE__(this, __assertion_##__LINE__);
+/* restricting the thread selections in a block of code to a set of thread variables
+ * usage:
+ * { WITH(t1, t2);
+ *   ....
+ * }
+ * { WITHOUT(t);
+ *   ....
+ * }
+ * the set is kept in the static info of the block, and the variables are looked up when a thread is selected
+ */
+
+#define WITH(...) \
+	DECL_STATIC_SELECT_THREAD_INFO((__VA_ARGS__), "WITH") WithThreads ADD_LINE(__withthreads__)(STATIC_DSL_INFO_NAME.scope())
+
+#define WITHOUT(...) \
+	DECL_STATIC_SELECT_THREAD_INFO((__VA_ARGS__), "WITHOUT") WithoutThreads ADD_LINE(__withoutthreads__)(STATIC_DSL_INFO_NAME.scope())
+
+/********************************************************************************/
+
+#define ASSERT_ALL(pred) 			static PredicateBuildCache ADD_LINE(__assertion_predicates_); TransitionPredicatePtr __assertion_##__LINE__((PredicateBuildScope(&ADD_LINE(__assertion_predicates_)), TransitionPredicatePtr(pred))); AssertionInstaller __assertion_installer_##__LINE__(this, __assertion_##__LINE__);
 
 /********************************************************************************/
 
-#define CONSTRAIN_ALL(pred) 		TransitionPredicatePtr __constraint_##__LINE__(new TransitionConstraintAll(pred)); ConstraintInstaller __constraint_installer_##__LINE__(this, __constraint_##__LINE__);
+#define CONSTRAIN_ALL(pred) 		static PredicateBuildCache ADD_LINE(__constraint_all_predicates_); TransitionPredicatePtr __constraint_##__LINE__((PredicateBuildScope(&ADD_LINE(__constraint_all_predicates_)), TransitionPredicatePtr(new TransitionConstraintAll(pred)))); ConstraintInstaller __constraint_installer_##__LINE__(this, __constraint_##__LINE__);
 
-#define CONSTRAIN_FST(pred) 		TransitionPredicatePtr __constraint_##__LINE__(new TransitionConstraintFirst(pred)); ConstraintInstaller __constraint_installer_##__LINE__(this, __constraint_##__LINE__);
+#define CONSTRAIN_FST(pred) 		static PredicateBuildCache ADD_LINE(__constraint_fst_predicates_); TransitionPredicatePtr __constraint_##__LINE__((PredicateBuildScope(&ADD_LINE(__constraint_fst_predicates_)), TransitionPredicatePtr(new TransitionConstraintFirst(pred)))); ConstraintInstaller __constraint_installer_##__LINE__(this, __constraint_##__LINE__);
 
 /********************************************************************************/
 
-#define _RUN_THROUGH1(r, ...) 		DECL_STATIC_DSL_INFO("RUN_THROUGH " #r); DSLRunThrough(&STATIC_DSL_INFO_NAME, (r), ## __VA_ARGS__);
+#define _RUN_THROUGH1(r, ...) 		DECL_STATIC_DSL_INFO("RUN_THROUGH " #r); DSL_BUILD(DSLRunThrough(&STATIC_DSL_INFO_NAME, (r), ## __VA_ARGS__));
 
 #define _RUN_THROUGH2a(p, r, ...) 	{ CONSTRAIN_FST(p); _RUN_THROUGH1((r), ## __VA_ARGS__); }
 
@@ -342,7 +340,14 @@ inline TransitionPredicatePtr _DISTINCT(ThreadVarPtrSet scope, ThreadVarPtr t =
 
 /********************************************************************************/
 
-#define _RUN_UNTIL1(r, ...) 		DECL_STATIC_DSL_INFO("RUN_UNTIL " #r); DSLRunUntil(&STATIC_DSL_INFO_NAME, (r), ## __VA_ARGS__);
+// runs through num_steps transitions satisfying r, each one recorded in the path as a separate step
+#define _RUN_THROUGH_N1(r, n, ...) 	DECL_STATIC_DSL_INFO("RUN_THROUGH_N " #r); DSL_BUILD(DSLRunThroughN(&STATIC_DSL_INFO_NAME, (r), (n), ## __VA_ARGS__));
+
+#define _RUN_THROUGH_N(q, r, n, ...) { CONSTRAIN_ALL(q); _RUN_THROUGH_N1((r), (n), ## __VA_ARGS__); }
+
+/********************************************************************************/
+
+#define _RUN_UNTIL1(r, ...) 		DECL_STATIC_DSL_INFO("RUN_UNTIL " #r); DSL_BUILD(DSLRunUntil(&STATIC_DSL_INFO_NAME, (r), ## __VA_ARGS__));
 
 #define _RUN_UNTIL2a(p, r, ...) 	{ CONSTRAIN_FST(p); _RUN_UNTIL1((r), ## __VA_ARGS__); }
 
@@ -369,6 +374,11 @@ inline TransitionPredicatePtr _DISTINCT(ThreadVarPtrSet scope, ThreadVarPtr t =
 
 /********************************************************************************/
 
+#define RUN_THREADS_THROUGH_N(ts, q, n, ...)	_RUN_THROUGH_N(ts, (q), (n), ## __VA_ARGS__)
+#define RUN_THREAD_THROUGH_N(t, q, n, ...)		_RUN_THROUGH_N(BY(t), (q), (n), ## __VA_ARGS__)
+
+/********************************************************************************/
+
 #define WAIT_FOR_THREAD(t, ...)				    _EXISTS("WaitForThread", t, (), ## __VA_ARGS__)
 
 #define _WAIT_FOR_DISTINCT_THREADS(ts, p, ...) \
@@ -457,29 +467,54 @@ inline TransitionPredicatePtr _ENDS(ThreadVarPtr t = ThreadVarPtr()) {
 
 inline TransitionPredicatePtr _READS(void* x = NULL, ThreadVarPtr t = ThreadVarPtr()) {
 	if(t == NULL) t = TID;
-	if(x == NULL)
+	if(x == NULL) {
+		PinMonitor::WatchAllAccesses();
 		return safe_notnull(AuxState::Reads.get())->TP0(AuxState::Reads, t);
-	else
+	} else {
+		PinMonitor::WatchAccesses(PTR2ADDRINT(x), 1);
 		return safe_notnull(AuxState::Reads.get())->TP1(AuxState::Reads, PTR2ADDRINT(x), t);
+	}
 }
 
 #define READS(...)		_READS(__VA_ARGS__)
 
+// true if the thread reads any byte of [x, x+size), e.g., READS_RANGE(&obj, sizeof(obj)) for a whole object
+inline TransitionPredicatePtr _READS_RANGE(void* x, size_t size, ThreadVarPtr t = ThreadVarPtr()) {
+	if(t == NULL) t = TID;
+	PinMonitor::WatchAccesses(PTR2ADDRINT(x), size);
+	return TPAccessRange::create(AuxState::Reads, PTR2ADDRINT(x), size, t);
+}
+
+#define READS_RANGE(...)	_READS_RANGE(__VA_ARGS__)
+
 /********************************************************************************/
 
 inline TransitionPredicatePtr _WRITES(void* x = NULL, ThreadVarPtr t = ThreadVarPtr()) {
 	if(t == NULL) t = TID;
-	if(x == NULL)
+	if(x == NULL) {
+		PinMonitor::WatchAllAccesses();
 		return safe_notnull(AuxState::Writes.get())->TP0(AuxState::Writes, t);
-	else
+	} else {
+		PinMonitor::WatchAccesses(PTR2ADDRINT(x), 1);
 		return safe_notnull(AuxState::Writes.get())->TP1(AuxState::Writes, PTR2ADDRINT(x), t);
+	}
 }
 
 #define WRITES(...)		_WRITES(__VA_ARGS__)
 
+// true if the thread writes any byte of [x, x+size), e.g., WRITES_RANGE(&obj, sizeof(obj)) for a whole object
+inline TransitionPredicatePtr _WRITES_RANGE(void* x, size_t size, ThreadVarPtr t = ThreadVarPtr()) {
+	if(t == NULL) t = TID;
+	PinMonitor::WatchAccesses(PTR2ADDRINT(x), size);
+	return TPAccessRange::create(AuxState::Writes, PTR2ADDRINT(x), size, t);
+}
+
+#define WRITES_RANGE(...)	_WRITES_RANGE(__VA_ARGS__)
+
 /********************************************************************************/
 
 #define ACCESSES(...)	(READS(__VA_ARGS__) || WRITES(__VA_ARGS__))
+#define ACCESSES_RANGE(...)	(READS_RANGE(__VA_ARGS__) || WRITES_RANGE(__VA_ARGS__))
 
 #define TO_READ(...)	READS(__VA_ARGS__)
 #define TO_WRITES(...)	WRITES(__VA_ARGS__)
@@ -515,6 +550,84 @@ inline TransitionPredicatePtr _RETURNS(void* f = NULL, ThreadVarPtr t = ThreadVa
 
 /********************************************************************************/
 
+// synchronization operations on the object at address x (a mutex, condition variable, rwlock, barrier or semaphore)
+// these are scheduling points only when enabled with -esync
+
+inline TransitionPredicatePtr _LOCKS(void* x = NULL, ThreadVarPtr t = ThreadVarPtr()) {
+	if(t == NULL) t = TID;
+	if(x == NULL)
+		return safe_notnull(AuxState::Locks.get())->TP0(AuxState::Locks, t);
+	else
+		return safe_notnull(AuxState::Locks.get())->TP3(AuxState::Locks, PTR2ADDRINT(x), true, t);
+}
+
+#define LOCKS(...)		_LOCKS(__VA_ARGS__)
+
+inline TransitionPredicatePtr _UNLOCKS(void* x = NULL, ThreadVarPtr t = ThreadVarPtr()) {
+	if(t == NULL) t = TID;
+	if(x == NULL)
+		return safe_notnull(AuxState::Unlocks.get())->TP0(AuxState::Unlocks, t);
+	else
+		return safe_notnull(AuxState::Unlocks.get())->TP3(AuxState::Unlocks, PTR2ADDRINT(x), true, t);
+}
+
+#define UNLOCKS(...)	_UNLOCKS(__VA_ARGS__)
+
+inline TransitionPredicatePtr _WAITS(void* x = NULL, ThreadVarPtr t = ThreadVarPtr()) {
+	if(t == NULL) t = TID;
+	if(x == NULL)
+		return safe_notnull(AuxState::Waits.get())->TP0(AuxState::Waits, t);
+	else
+		return safe_notnull(AuxState::Waits.get())->TP3(AuxState::Waits, PTR2ADDRINT(x), true, t);
+}
+
+#define WAITS(...)		_WAITS(__VA_ARGS__)
+
+inline TransitionPredicatePtr _SIGNALS(void* x = NULL, ThreadVarPtr t = ThreadVarPtr()) {
+	if(t == NULL) t = TID;
+	if(x == NULL)
+		return safe_notnull(AuxState::Signals.get())->TP0(AuxState::Signals, t);
+	else
+		return safe_notnull(AuxState::Signals.get())->TP3(AuxState::Signals, PTR2ADDRINT(x), true, t);
+}
+
+#define SIGNALS(...)	_SIGNALS(__VA_ARGS__)
+
+/********************************************************************************/
+
+// atomic read-modify-write instructions (lock-prefixed, xchg with memory) on address x, and fences
+// with -eatomic, these are the only scheduling points besides thread ends
+
+inline TransitionPredicatePtr _ATOMIC(void* x = NULL, ThreadVarPtr t = ThreadVarPtr()) {
+	if(t == NULL) t = TID;
+	if(x == NULL)
+		return safe_notnull(AuxState::Atomics.get())->TP0(AuxState::Atomics, t);
+	else
+		return safe_notnull(AuxState::Atomics.get())->TP3(AuxState::Atomics, PTR2ADDRINT(x), true, t);
+}
+
+#define ATOMIC(...)		_ATOMIC(__VA_ARGS__)
+
+inline TransitionPredicatePtr _FENCES(ThreadVarPtr t = ThreadVarPtr()) {
+	if(t == NULL) t = TID;
+	return safe_notnull(AuxState::Atomics.get())->TP3(AuxState::Atomics, AuxState::FenceKey, true, t);
+}
+
+#define FENCES(...)		_FENCES(__VA_ARGS__)
+
+/********************************************************************************/
+
+// sleeps of the thread, which are events only with virtual time (-g)
+
+inline TransitionPredicatePtr _SLEEPS(ThreadVarPtr t = ThreadVarPtr()) {
+	if(t == NULL) t = TID;
+	return safe_notnull(AuxState::Sleeps.get())->TP0(AuxState::Sleeps, t);
+}
+
+#define SLEEPS(...)		_SLEEPS(__VA_ARGS__)
+
+/********************************************************************************/
+
 inline TransitionPredicatePtr _CALLS(void* f = NULL, ThreadVarPtr t = ThreadVarPtr()) {
 	if(t == NULL) t = TID;
 	if(f == NULL)
@@ -568,8 +681,48 @@ inline TransitionPredicatePtr _HITS_PC(int pc = -1, ThreadVarPtr t = ThreadVarPt
 
 /********************************************************************************/
 
+// inlined variants of the predicates above, combined with &&, || and ! into a single evaluator type.
+// ThreadVars given to them must outlive the predicate (as TVARs do).
+// E_COND(c) turns an expression c over CURRENT_THREAD (a Coroutine*) into such a predicate.
+
+typedef AuxVar1<ADDRINT, uint32_t, 0, 0> AuxVar_Accesses;
+typedef AuxVar1<ADDRINT, bool, 0, false> AuxVar_Calls;
+typedef AuxVar0<bool, false> AuxVar_Flag;
+
+// any address, so all accesses are recorded
+inline AuxVar_Accesses* _E_WATCH_ALL(AuxVar_Accesses* var) {
+	PinMonitor::WatchAllAccesses();
+	return var;
+}
+
+#define E_READS(...)	AuxIsSetExpr<AuxVar_Accesses>(_E_WATCH_ALL(AuxState::Reads.get()), _E_TVAR(__VA_ARGS__))
+#define E_WRITES(...)	AuxIsSetExpr<AuxVar_Accesses>(_E_WATCH_ALL(AuxState::Writes.get()), _E_TVAR(__VA_ARGS__))
+#define E_ACCESSES(...)	(E_READS(__VA_ARGS__) || E_WRITES(__VA_ARGS__))
+#define E_CALLS(...)	AuxIsSetExpr<AuxVar_Calls>(AuxState::CallsTo.get(), _E_TVAR(__VA_ARGS__))
+#define E_ENTERS(...)	AuxIsSetExpr<AuxVar_Calls>(AuxState::Enters.get(), _E_TVAR(__VA_ARGS__))
+#define E_RETURNS(...)	AuxIsSetExpr<AuxVar_Calls>(AuxState::Returns.get(), _E_TVAR(__VA_ARGS__))
+#define E_LOCKS(...)	AuxIsSetExpr<AuxVar_Calls>(AuxState::Locks.get(), _E_TVAR(__VA_ARGS__))
+#define E_UNLOCKS(...)	AuxIsSetExpr<AuxVar_Calls>(AuxState::Unlocks.get(), _E_TVAR(__VA_ARGS__))
+#define E_WAITS(...)	AuxIsSetExpr<AuxVar_Calls>(AuxState::Waits.get(), _E_TVAR(__VA_ARGS__))
+#define E_SIGNALS(...)	AuxIsSetExpr<AuxVar_Calls>(AuxState::Signals.get(), _E_TVAR(__VA_ARGS__))
+#define E_ATOMIC(...)	AuxIsSetExpr<AuxVar_Calls>(AuxState::Atomics.get(), _E_TVAR(__VA_ARGS__))
+#define E_ENDS(...)		AuxIsSetExpr<AuxVar_Flag>(AuxState::Ends.get(), _E_TVAR(__VA_ARGS__))
+#define E_SLEEPS(...)	AuxIsSetExpr<AuxVar_Flag>(AuxState::Sleeps.get(), _E_TVAR(__VA_ARGS__))
+#define E_HITS_PC(...)	AuxIsSetExpr<AuxVar_Flag>(AuxState::AtPc.get(), _E_TVAR(__VA_ARGS__))
+#define E_IN_FUNC(f, ...)	InFuncExpr(PTR2ADDRINT(f), _E_TVAR(__VA_ARGS__))
+#define E_BY(t)			ByExpr(safe_notnull((t).get()), false)
+#define E_NOT_BY(t)		ByExpr(safe_notnull((t).get()), true)
+
+#define E_COND(c)		MakeLambdaExpr([=](Coroutine* CURRENT_THREAD) -> bool { return (c); })
+
+inline ThreadVar* _E_TVAR(const ThreadVarPtr& t = ThreadVarPtr()) {
+	return t.get();
+}
+
+/********************************************************************************/
+
 typedef AuxConst0<ADDRINT, ADDRINT(0)> AuxVar0_ADDRINT;
-typedef boost::shared_ptr<AuxVar0_ADDRINT> AuxVar0_ADDRINT_PTR;
+typedef boost::intrusive_ptr<AuxVar0_ADDRINT> AuxVar0_ADDRINT_PTR;
 #define AVAR(x)		AuxVar0_ADDRINT_PTR x(new AuxVar0_ADDRINT(ADDRINT(0)));
 
 /********************************************************************************/
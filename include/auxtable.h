@@ -0,0 +1,214 @@
+/**
+ * Copyright (c) 2010-2011,
+ * Tayfun Elmas    <elmas@cs.berkeley.edu>
+ * All rights reserved.
+ * <p/>
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * <p/>
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * <p/>
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * <p/>
+ * 3. The names of the contributors may not be used to endorse or promote
+ * products derived from this software without specific prior written
+ * permission.
+ * <p/>
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef AUXTABLE_H_
+#define AUXTABLE_H_
+
+#include "common.h"
+#include "thread.h"
+
+namespace concurrit {
+
+/********************************************************************************/
+
+// epochs start from 1, so zero-initialized memory is never current
+inline unsigned int NextAuxEpoch(unsigned int epoch) {
+	return (epoch + 1 == 0) ? 1 : (epoch + 1);
+}
+
+// values are read by other threads while they are written, so they are accessed atomically.
+// the epoch of a value is stored after it (release), and loaded before it (acquire)
+template<typename T>
+inline T AuxLoad(T* p) {
+	T value;
+	__atomic_load(p, &value, __ATOMIC_RELAXED);
+	return value;
+}
+
+template<typename T>
+inline void AuxStore(T* p, T value) {
+	__atomic_store(p, &value, __ATOMIC_RELAXED);
+}
+
+/********************************************************************************/
+
+// table of per-thread slots, indexed by tid + 1 (slot 0 is for tid -1).
+// each slot is on its own cache line and is zero when first allocated.
+// lookups do not lock; only allocating a new chunk of slots does.
+template<typename S>
+class AuxSlotTable {
+	union Line {
+		S slot;
+		char pad[((sizeof(S) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE) * CACHE_LINE_SIZE];
+	};
+public:
+	static const int ChunkSize = 64;
+	static const int MaxChunks = 1024;
+	static const int MaxSlots = ChunkSize * MaxChunks;
+
+	AuxSlotTable() : chunks_(NULL) {}
+	~AuxSlotTable() {
+		if(chunks_ != NULL) {
+			for(int i = 0; i < MaxChunks; ++i) {
+				if(chunks_[i] != NULL) free(chunks_[i]);
+			}
+			delete[] chunks_;
+		}
+	}
+
+	// returns NULL if the slot of t has not been allocated yet
+	inline S* find(THREADID t) {
+		return at(t + 1);
+	}
+
+	// allocates the slot of t if necessary
+	inline S* get(THREADID t) {
+		S* s = find(t);
+		return (s != NULL) ? s : allocate(t + 1);
+	}
+
+	inline S* at(int i) {
+		safe_assert(0 <= i && i < MaxSlots);
+		Line** chunks = __atomic_load_n(&chunks_, __ATOMIC_ACQUIRE);
+		if(chunks == NULL) return NULL;
+		Line* chunk = __atomic_load_n(&chunks[i / ChunkSize], __ATOMIC_ACQUIRE);
+		return (chunk == NULL) ? NULL : &chunk[i % ChunkSize].slot;
+	}
+
+private:
+	S* allocate(int i) {
+		safe_assert(0 <= i && i < MaxSlots);
+		ScopeMutex m(&mutex_);
+
+		if(chunks_ == NULL) {
+			Line** chunks = new Line*[MaxChunks];
+			memset(chunks, 0, MaxChunks * sizeof(Line*));
+			__atomic_store_n(&chunks_, chunks, __ATOMIC_RELEASE);
+		}
+
+		Line** entry = &chunks_[i / ChunkSize];
+		if(*entry == NULL) {
+			void* chunk = NULL;
+			if(posix_memalign(&chunk, CACHE_LINE_SIZE, ChunkSize * sizeof(Line)) != 0) {
+				safe_fail("Cannot allocate auxiliary state slots!");
+			}
+			memset(chunk, 0, ChunkSize * sizeof(Line));
+			__atomic_store_n(entry, static_cast<Line*>(chunk), __ATOMIC_RELEASE);
+		}
+		return &(*entry)[i % ChunkSize].slot;
+	}
+
+	Line** chunks_;
+	Mutex mutex_;
+};
+
+/********************************************************************************/
+
+// small open-addressing table of a thread, keyed by addresses.
+// an entry is empty unless its epoch is the current epoch of the owning slot,
+// so resetting the table is a single epoch increment (and clearing the list of taken entries).
+// the entries taken since the reset are listed in order, so they are visited without scanning the capacity.
+template<typename K, typename T>
+struct AuxHashEntry {
+	unsigned int epoch;
+	K key;
+	T value;
+};
+
+template<typename K, typename T>
+struct AuxHashTable {
+	static const int InitialCapacity = 8;
+
+	explicit AuxHashTable(int capacity) : capacity_(capacity), num_taken_(0) {
+		safe_assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+		entries_ = static_cast<AuxHashEntry<K,T>*>(calloc(capacity, sizeof(AuxHashEntry<K,T>)));
+		safe_assert(entries_ != NULL);
+		taken_ = static_cast<int*>(calloc(capacity, sizeof(int)));
+		safe_assert(taken_ != NULL);
+	}
+	~AuxHashTable() {
+		free(taken_);
+		free(entries_);
+	}
+
+	inline unsigned int home(const K& key) {
+		uint64_t h = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL;
+		return static_cast<unsigned int>(h >> 32) & (capacity_ - 1);
+	}
+
+	// returns the entry of key, or the empty entry where key would go
+	inline AuxHashEntry<K,T>* probe(const K& key, unsigned int epoch) {
+		unsigned int mask = capacity_ - 1;
+		unsigned int i = home(key);
+		for(int n = 0; n < capacity_; ++n, i = (i + 1) & mask) {
+			AuxHashEntry<K,T>* e = &entries_[i];
+			if(__atomic_load_n(&e->epoch, __ATOMIC_ACQUIRE) != epoch || AuxLoad(&e->key) == key) {
+				return e;
+			}
+		}
+		return NULL;
+	}
+
+	// called by the owner after e is taken by a new key
+	inline void on_taken(AuxHashEntry<K,T>* e) {
+		const int n = num_taken_;
+		safe_assert(n < capacity_);
+		taken_[n] = static_cast<int>(e - entries_);
+		__atomic_store_n(&num_taken_, n + 1, __ATOMIC_RELEASE);
+	}
+
+	inline void clear_taken() {
+		__atomic_store_n(&num_taken_, 0, __ATOMIC_RELEASE);
+	}
+
+	inline int num_taken() {
+		return __atomic_load_n(&num_taken_, __ATOMIC_ACQUIRE);
+	}
+
+	// the n-th taken entry, which may have been reset meanwhile, so its epoch is to be checked
+	inline AuxHashEntry<K,T>* taken(int n) {
+		return &entries_[taken_[n]];
+	}
+
+	int capacity_;
+	AuxHashEntry<K,T>* entries_;
+	int* taken_;
+	int num_taken_;
+};
+
+/********************************************************************************/
+
+} // end namespace
+
+#endif /* AUXTABLE_H_ */
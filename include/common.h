@@ -55,6 +55,8 @@
 #include <limits.h>
 #include <climits>
 #include <libgen.h>
+#include <fcntl.h>
+#include <sys/file.h>
 
 // std libraries
 #include <vector>
@@ -83,6 +85,17 @@ namespace concurrit {
 #define UNUSED __attribute__((unused))
 #endif
 
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+// puts the fields declared after it on a different cache line than the ones before it
+#define DECL_CACHE_LINE_PAD(n) \
+		private: \
+		char __cache_line_pad_##n##__[CACHE_LINE_SIZE]; \
+		private: \
+
+
 #ifndef USE
 #define USE(x) ((void)(x))
 #endif
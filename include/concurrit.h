@@ -114,6 +114,7 @@ namespace concurrit {
 #include "pinmonitor.h"
 #include "dsl.h"
 #include "transpred.h"
+#include "predexpr.h"
 #include "instrument.h"
 #include "manual.h"
 #include "interpos.h"
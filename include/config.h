@@ -38,6 +38,20 @@ namespace concurrit {
 
 //enum ExecutionModeType {MODE_SINGLE = 0, MODE_SERVER = 1, MODE_CLIENT = 2};
 
+// none: leave placement to the OS
+// spread: pin each parallel search worker to a distinct physical core, chosen by AffinityWorkerIndex or claimed,
+// spread: pin each parallel search worker to a distinct core, chosen by AffinityWorkerIndex,
+//         the controlled threads of the worker stay compact on that core
+enum AffinityPolicyType {AFFINITY_NONE = 0, AFFINITY_COMPACT = 1, AFFINITY_SPREAD = 2};
+
+inline const char* AffinityPolicyToString(AffinityPolicyType policy) {
+	switch(policy) {
+	case AFFINITY_COMPACT: return "compact";
+	case AFFINITY_SPREAD: return "spread";
+	default: return "none";
+	}
+}
+
 class Config {
 public:
 	static bool OnlyShowHelp;
@@ -57,7 +71,25 @@ public:
 	static bool MarkEndingBranchesCovered;
 	static bool SaveExecutionTraceToFile;
 	static bool CancelThreadsToRestart;
+	static AffinityPolicyType AffinityPolicy;
+	static int AffinityWorkerIndex; // index of this search worker in spread mode, -1 means claim the first free core
+	static int CoroutineStackSizeKB;
+	static int MaxParkedCoroutines;
+	static int StressDelayRate; // delays per thousand events, 0 disables the stress mode
+	static long StressMaxDelayUSecs;
+	static unsigned int StressSeed;
+	static char* StressReplayFile; // schedule saved by a failing stress execution, replayed under control
+	static unsigned int SchedulingPoints; // bit (1U << kind) is set for each EventKind that is a scheduling point
+	static bool ScheduleFences; // fences are AtomicAccess scheduling points, set by -eatomic
+	static bool RunAhead; // threads run natively between scheduling points, other events are scheduling points if a compiled predicate depends on them
+	static bool VirtualTime; // controlled threads sleep and read clocks on a virtual clock
+	static bool WatchAccesses; // only the accesses to the addresses predicates refer to update READS/WRITES
+	static bool FilterUnsharedAccesses; // the pin tool drops accesses to pages that only one thread touched so far
+	static bool ScopedInstrumentation; // the pin tool instruments only the events that scheduling points and predicates need
+	static int AdaptiveSampleRate; // n-ary predicates are profiled once every N transitions to reorder their operands, 0 disables reordering
 //	static ExecutionModeType ExecutionMode;
+	static inline bool IsStressMode() { return StressDelayRate > 0; }
+	static inline bool IsStressReplay() { return StressReplayFile != NULL; }
 	static bool ParseCommandLine(int argc = -1, char **argv = NULL);
 	static bool ParseCommandLine(const main_args& args);
 };
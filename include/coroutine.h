@@ -49,8 +49,10 @@ class ExecutionTree;
 enum MessageType {MSG_INVALID = 0, MSG_STARTED = 1, MSG_TRANSFER = 2, MSG_RESTART = 3, MSG_TERMINATE = 4, MSG_EXCEPTION = 5};
 
 // absent means does not exist, an existing coroutine does not take absent status
+// blocked means in a controlled transition, native_blocked means blocked in an original
+// (interpositioned) blocking call between controlled transitions
 typedef int StatusType;
-const int ABSENT = 0, PASSIVE = 1, ENABLED = 2, WAITING = 3/*for message*/, BLOCKED = 4, ENDED = 5, TERMINATED = 6;
+const int ABSENT = 0, PASSIVE = 1, ENABLED = 2, WAITING = 3/*for message*/, BLOCKED = 4, NATIVE_BLOCKED = 5, ENDED = 6, TERMINATED = 7;
 
 // for log messages
 #define CO_TITLE	"[" << tid_ << "] "
@@ -78,6 +80,9 @@ public:
 
 	static Coroutine* Current();
 
+	// NULL if the running thread has not started a coroutine yet
+	static inline Coroutine* CurrentOrNull() { return current_; }
+
 	void Transfer(Coroutine* target, MessageType msg = MSG_TRANSFER);
 	void Transfer(Channel<MessageType>* channel, MessageType msg = MSG_TRANSFER);
 
@@ -93,16 +98,41 @@ public:
 		return (status_ >= ENDED);
 	}
 
+	// sets the status to to only if it is from, returns if it was
+	inline bool cas_status(StatusType from, StatusType to) {
+		return __sync_bool_compare_and_swap(&status_, from, to);
+	}
+
 	void StartControlledTransition();
 	void FinishControlledTransition();
 
+	// clears the state kept from the last run, done in Start and when a parked coroutine is reused
+	void ResetRunState();
+
 	inline char* instr_callback_info() {
 		return instr_callback_info_;
 	}
 
+	// records the auxiliary variables (AuxDependency bits) changed by an event of this thread
+	inline void OnAuxChanges(unsigned changes) {
+		aux_changes_ |= changes;
+	}
+
+	// returns the variables changed since the last call
+	inline unsigned TakeAuxChanges() {
+		unsigned changes = aux_changes_;
+		aux_changes_ = 0;
+		return changes;
+	}
+
 private:
 
+	// hot fields, written by this coroutine and polled by others on every transition
+	DECL_CACHE_LINE_PAD(0)
 	DECL_VOL_FIELD(StatusType, status)
+	DECL_FIELD(SourceLocation*, srcloc)
+	DECL_CACHE_LINE_PAD(1)
+
 	DECL_FIELD(CoroutineGroup*, group)
 	DECL_FIELD_REF(Channel<MessageType>, channel)
 
@@ -118,16 +148,62 @@ private:
 
 	DECL_FIELD(ThreadVarPtr, tvar)
 
+	// random state of the stress mode, seeded on each (re)start
+	DECL_FIELD_REF(unsigned int, stress_rand_state)
+
+	// auxiliary variables changed since the last evaluated controlled transition
+	DECL_FIELD(unsigned, aux_changes)
+
+	// node this thread took (without consuming) at its last evaluated controlled transition,
+	// with the version of the execution tree, the auxiliary variables read by the
+	// predicates, and the variables changed before that transition
+	DECL_FIELD(ExecutionTree*, last_taken_node)
+	DECL_FIELD(unsigned, last_taken_version)
+	DECL_FIELD(unsigned, last_taken_dependencies)
+	DECL_FIELD(unsigned, last_taken_changes)
+
+	// true while the thread runs the code under test, and not concurrit's runtime on its behalf
+	DECL_FIELD(bool, in_sut)
+
+	// deadline (on the virtual clock) of the original call the thread is blocked in, 0 if untimed
+	DECL_VOL_FIELD(uint64_t, native_deadline)
+
+	// virtual time the thread last read or woke up at, where its next sleep starts; 0 is the start of the execution
+	DECL_FIELD(uint64_t, vtime)
+
 //	DECL_FIELD(bool, is_driver_thread)
 
-	DECL_FIELD(SourceLocation*, srcloc)
 	char instr_callback_info_[256];
 
 	DECL_STATIC_FIELD(Coroutine*, main)
 
+	// coroutine of the running thread, set when the coroutine starts running
+	static __thread Coroutine* current_;
+
 	DISALLOW_COPY_AND_ASSIGN(Coroutine)
 };
 
+/********************************************************************************/
+
+// marks the running thread as executing concurrit's runtime in the current scope,
+// so that the synchronization operations of the runtime are not taken as events of the code under test
+class RuntimeScope {
+public:
+	RuntimeScope() : co_(Coroutine::CurrentOrNull()), in_sut_(co_ != NULL && co_->in_sut()) {
+		if(in_sut_) co_->set_in_sut(false);
+	}
+	~RuntimeScope() {
+		if(in_sut_) co_->set_in_sut(true);
+	}
+private:
+	Coroutine* co_;
+	bool in_sut_;
+
+	DISALLOW_COPY_AND_ASSIGN(RuntimeScope)
+};
+
+/********************************************************************************/
+
 typedef std::set<Coroutine*> CoroutinePtrSet;
 #define for_each_coroutine(s, co) \
 	CoroutinePtrSet::iterator __itr__ = (s).begin(); \
@@ -40,6 +40,7 @@
 #include "dot.h"
 
 #include <atomic>
+#include <boost/unordered_map.hpp>
 
 namespace concurrit {
 
@@ -64,6 +65,8 @@ public:
 private:
 	DECL_FIELD(SourceLocation*, srcloc)
 	DECL_FIELD(std::string, message)
+	// the predicates the statement builds in each execution
+	DECL_FIELD_REF(PredicateBuildCache, predicates)
 
 	friend class ExecutionTree;
 };
@@ -461,13 +464,22 @@ public:
 		scope_ = scope;
 		pred_ = pred;
 
-		// scope_size_ == 0 means scope is NULL, so use the total number of threads when needed
-		scope_size_ = scope_ != NULL ? scope_->size() : 0;
+		// the WITH and WITHOUT blocks the statement is in
+		restriction_ = *ThreadRestriction::Current();
+
+		// the predicate is evaluated directly, compile it only to report its dependencies
+		if((Config::ScopedInstrumentation || Config::RunAhead) && pred_ != NULL && pred_ != TransitionPredicate::True()) {
+			PredicateProgram program;
+			program.Compile(pred_);
+		}
 
 		lvar_->clear_thread();
 	}
 
 	bool CanSelectThread(Coroutine* thread) {
+		if(!restriction_.empty() && !restriction_.Allows(thread)) {
+			return false;
+		}
 		// if no pred, then this means TRUE, so skip checking pred
 		if(pred_ == NULL || pred_ == TransitionPredicate::True()) {
 			return true;
@@ -494,13 +506,17 @@ public:
 //		selected_tid_ = current->tid();
 	}
 
+	// number of the threads the node can select: members of the scope, or of the group if the scope is empty,
+	// that the restriction allows
+	size_t NumSelectable(CoroutineGroup* group);
+
 	virtual int CheckAndSelectThread(Coroutine* current, int child_index_in_stack = -1) = 0;
 	virtual ThreadVarPtr& var(int child_index) = 0;
 
 private:
 	DECL_FIELD(TransitionPredicatePtr, pred)
 	DECL_FIELD(ThreadVarPtrSet*, scope)
-	DECL_FIELD(size_t, scope_size)
+	DECL_FIELD_REF(ThreadRestriction, restriction)
 	DECL_FIELD(ThreadVarPtr, lvar)
 };
 
@@ -545,7 +561,7 @@ public:
 		safe_assert(child_index_in_stack == -1 || child_index_in_stack == 0);
 
 		if(scope_ != NULL && !scope_->empty()) {
-			ThreadVarPtr t = scope_->FindByThread(thread);
+			const ThreadVarPtr& t = scope_->FindByThread(thread);
 			if(t == NULL) {
 				return -1;
 			}
@@ -555,7 +571,7 @@ public:
 				return -1;
 			}
 		} else {
-			if(covered_vars_.FindByThread(thread) != NULL) {
+			if(covered_tids_.contains(tid)) {
 				return -1;
 			}
 		}
@@ -574,14 +590,14 @@ public:
 		safe_assert(lvar_ != NULL && !lvar_->is_empty());
 
 		Coroutine* thread = lvar_->thread();
-		ThreadVarPtr t;
 		if(scope_ != NULL && !scope_->empty()) {
-			t = scope_->FindByThread(thread);
+			const ThreadVarPtr& t = scope_->FindByThread(thread);
+			safe_assert(t != NULL && thread == t->thread());
+			covered_vars_.insert(t);
 		} else {
-			t = create_thread_var(thread);
+			// without a scope, threads are covered by their tids
+			covered_tids_.insert(thread->tid());
 		}
-		safe_assert(t != NULL && thread == t->thread());
-		covered_vars_.insert(t);
 	}
 
 	//override
@@ -592,13 +608,14 @@ public:
 
 private:
 	DECL_FIELD_REF(ThreadVarPtrSet, covered_vars)
+	DECL_FIELD_REF(ThreadSet, covered_tids)
 //	DECL_FIELD(THREADID, selected_tid)
 };
 
 /********************************************************************************/
 
 class ForallThreadNode : public SelectThreadNode {
-	typedef std::map<ThreadVar*, int> ThreadVarToIdxMap;
+	typedef boost::unordered_map<ThreadVar*, int> ThreadVarToIdxMap;
 public:
 	ForallThreadNode(StaticDSLInfo* static_info = NULL,
 					 ThreadVarPtrSet* scope = NULL,
@@ -642,23 +659,26 @@ public:
 
 		safe_assert(lvar_->is_empty());
 
-		ThreadVarPtr t;
+		int child_index = -1;
 		if(scope_ != NULL && !scope_->empty()) {
-			t = scope_->FindByThread(thread);
+			const ThreadVarPtr& t = scope_->FindByThread(thread);
 			if(t == NULL) {
 				return -1;
 			}
 			safe_assert(thread == t->thread());
-		} else {
-			t = create_thread_var(thread);
-		}
 
-		// check condition
-		if(!CanSelectThread(thread)) {
-			return -1;
+			// check condition
+			if(!CanSelectThread(thread)) {
+				return -1;
+			}
+			child_index = add_or_get_child_index(t);
+		} else {
+			// check condition
+			if(!CanSelectThread(thread)) {
+				return -1;
+			}
+			child_index = add_or_get_child_index(create_thread_var(thread));
 		}
-
-		int child_index = add_or_get_child_index(t);
 		safe_assert(check_index(child_index));
 		safe_assert(child_index_in_stack == -1 || check_index(child_index_in_stack));
 
@@ -728,6 +748,9 @@ public:
 			   const ThreadVarPtr& var = ThreadVarPtr()) {
 		pred_ = pred;
 		var_ = var;
+		if(pred_ != NULL) {
+			program_.Compile(pred_);
+		}
 	}
 
 	virtual const char* Kind() = 0;
@@ -755,6 +778,8 @@ public:
 private:
 	DECL_FIELD(TransitionPredicatePtr, pred)
 	DECL_FIELD(ThreadVarPtr, var)
+	// flat form of pred, evaluated instead of pred
+	DECL_FIELD_REF(PredicateProgram, program)
 };
 
 /********************************************************************************/
@@ -790,17 +815,27 @@ private:
 
 /********************************************************************************/
 
+// a batch of n steps (RUN_THROUGH_N) is a chain of n run-through nodes, one for each step, so each step is
+// in the path. the thread consuming a step publishes the next one itself, without handing control back to main
+
 class RunThroughNode : public TransitionNode {
 public:
 	RunThroughNode(StaticDSLInfo* static_info,
 					 const TransitionPredicatePtr& pred,
 					 const ThreadVarPtr& var = ThreadVarPtr(),
-					 ExecutionTree* parent = NULL)
-	: TransitionNode(static_info, pred, var, parent, 1) {}
+					 ExecutionTree* parent = NULL,
+					 int num_steps = 1)
+	: TransitionNode(static_info, pred, var, parent, 1), num_steps_(num_steps) {}
 
 	~RunThroughNode() {}
 
 	const char* Kind() { return "RunThroughNode"; }
+
+	// returns the node of the next step of the batch, linked as the child of this node, or NULL for the last step
+	RunThroughNode* NextStep();
+
+private:
+	DECL_FIELD(int, num_steps) // steps left in the batch, including this one
 };
 
 /********************************************************************************/
@@ -905,9 +940,25 @@ public:
 	// same as AcquireRefEx, but triggers backtrack exception if the node is an end node
 	ExecutionTree* AcquireRefEx(AcquireRefMode mode, long timeout_usec = -1);
 
-	// if child_index >= 0, adds the (node,child_index) to path and nullifies atomic_ref
+	// if child_index >= 0, adds the (node,child_index) to path and sets atomic_ref to next (NULL by default)
 	// otherwise, puts node back to atomic_ref
-	void ReleaseRef(ExecutionTree* node = NULL, int child_index = -1);
+	void ReleaseRef(ExecutionTree* node = NULL, int child_index = -1, ExecutionTree* next = NULL);
+
+	// current node, read without locking atomic_ref (so it can be the lock node)
+	inline ExecutionTree* PeekRef() {
+		return GetRef(std::memory_order_acquire);
+	}
+
+	// incremented when the current node changes, or when a thread variable or constraint
+	// the evaluation of the current node depends on changes
+	inline unsigned version() {
+		return version_.load(std::memory_order_acquire);
+	}
+
+	inline void BumpVersion() {
+		version_.fetch_add(1, std::memory_order_acq_rel);
+		PinMonitor::InvalidateGuards();
+	}
 
 	void AddToPath(ExecutionTree* node, int child_index);
 
@@ -956,6 +1007,9 @@ private:
 	ExecutionTreeRef atomic_ref_;
 	Semaphore sem_ref_;
 
+	std::atomic<unsigned> version_;
+	ExecutionTree* acquired_; // node returned by the last AcquireRef, protected by atomic_ref
+
 //	DECL_FIELD(Mutex, mutex)
 //	DECL_FIELD(ConditionVar, cv)
 
@@ -41,6 +41,9 @@ namespace concurrit {
 class Scenario;
 
 typedef std::map<THREADID, Coroutine*> MembersMap;
+// dense, indexed by tid; slots of main and of taken-out members are NULL
+typedef std::vector<Coroutine*> MembersTable;
+typedef std::map<pthread_t, Coroutine*> PThreadToMemberMap;
 
 /*
  * represents a set of coroutines
@@ -53,6 +56,11 @@ public:
 	CoroutineGroup();
 	~CoroutineGroup() {}
 
+	// takes a parked coroutine if any, otherwise creates a new one; does not add it
+	static Coroutine* NewMember(THREADID tid, ThreadEntryFunction function, void* arg);
+	// terminates the coroutines parked by Finish
+	static void FinishParked();
+
 	void AddMember(Coroutine* member);
 	Coroutine* GetNextCreatedMember(THREADID tid = -1);
 	Coroutine* GetNthCreatedMember(int i, THREADID tid = -1);
@@ -74,6 +82,9 @@ public:
 	Coroutine* GetMember(THREADID tid);
 	Coroutine* GetMember(const pthread_t& pid);
 
+	// records the pthread of a started member for GetMember(pthread_t)
+	void IndexPThread(Coroutine* member);
+
 	/*
 	 * choose a next enabled thread (chosen randomly)
 	 * returns NULL is no one is enabled: deadlock
@@ -92,6 +103,23 @@ public:
 	 */
 	bool IsAllEnded();
 
+	/*
+	 * return if all of the started, live members are blocked in original untimed calls,
+	 * so no member can reach its next controlled transition
+	 */
+	bool IsAllNativeBlocked();
+
+	/*
+	 * return the earliest deadline of the members blocked in original timed calls,
+	 * or 0 if a started, live member is running between controlled transitions
+	 */
+	uint64_t GetIdleDeadline();
+
+	// called by a member when it returns from an original blocking call
+	inline void OnNativeWakeup() {
+		__atomic_fetch_add(&native_wakeups_, 1, __ATOMIC_RELEASE);
+	}
+
 //	bool CheckCurrent(Coroutine* current);
 
 	void KillAll(int signal_number, THREADID sender = 0);
@@ -104,12 +132,23 @@ private:
 	DECL_FIELD(THREADID, next_tid)
 
 	DECL_FIELD_REF(MembersMap, members)
+	DECL_FIELD_REF(MembersTable, member_table)
+	DECL_FIELD_REF(PThreadToMemberMap, pthread_to_member)
 
 	DECL_FIELD_REF(std::vector<THREADID>, member_tidseq)
 	DECL_FIELD(int, next_idx)
 
 	DECL_FIELD_REF(Mutex, create_mutex)
 
+	// number of returns from original blocking calls, to tell a persistent deadlock from a passing one
+	DECL_VOL_FIELD(unsigned, native_wakeups)
+
+	// ended coroutines kept alive across scenarios, up to Config::MaxParkedCoroutines
+	DECL_STATIC_FIELD_REF(std::vector<Coroutine*>, parked)
+
+private:
+	void set_table_slot(THREADID tid, Coroutine* member);
+
 	friend class Concurrit;
 	friend class Scenario;
 	friend class Coroutine;
@@ -46,6 +46,74 @@ struct PinToolOptions {
 	uint32_t TrackFuncCalls;
 	uint32_t InstrTopLevelFuncs;
 	uint32_t InstrAfterMemoryAccess;
+	ADDRINT GuardTable; // address of the PinGuardTable of concurrit
+	uint32_t InstrumentedKinds; // bit (1U << kind) is set for each EventKind the pin tool instruments
+	uint32_t FilterUnsharedAccesses; // drop memory accesses to pages that only one thread touched so far
+	ADDRINT WatchTable; // address of the PinWatchTable of concurrit
+	uint32_t ResolveSourceLocations; // resolve file, function and line of the locations in reported events
+	uint32_t InstrumentFences; // report fences as AtomicAccess events without an address
+};
+
+/***********************************************************************/
+
+// guards of the events the pin tool reports, owned by concurrit and read in place by the pin tool.
+// after each reported event, concurrit returns in the event buffer the kinds of events the thread
+// can drop without calling back (skip_kinds), which stay valid while epoch does not change
+struct PinGuardTable {
+	volatile uint32_t epoch;
+};
+
+/***********************************************************************/
+
+// memory ranges whose reads and writes concurrit records in its READS/WRITES auxiliary variables,
+// owned by concurrit and read in place by the pin tool. a snapshot is never modified once published,
+// and replaced snapshots are freed only between executions, so both sides read the current one without locking.
+// the bloom filter has a bit for each page of each range, so most unwatched accesses fail on it
+
+struct PinWatchRange {
+	ADDRINT begin;
+	ADDRINT end; // exclusive
+};
+
+struct PinWatchSnapshot {
+	static const uint32_t PageBits = 12;
+	static const uint32_t BloomBits = 1024;
+
+	uint32_t watch_all; // ranges are ignored, all accesses are recorded
+	uint32_t num_ranges;
+	uint64_t bloom[BloomBits / 64];
+	PinWatchRange ranges[1]; // num_ranges sorted, disjoint ranges, allocated with the snapshot
+
+	static inline uint32_t BloomIndex(ADDRINT page) {
+		return static_cast<uint32_t>((static_cast<uint64_t>(page) * 0x9E3779B97F4A7C15ULL) >> 54) & (BloomBits - 1);
+	}
+
+	inline bool InBloom(ADDRINT addr) const {
+		const uint32_t i = BloomIndex(addr >> PageBits);
+		return (bloom[i / 64] & (1ULL << (i % 64))) != 0;
+	}
+
+	// true if [addr, addr+size) overlaps a watched range
+	inline bool IsWatched(ADDRINT addr, uint32_t size) const {
+		if(watch_all) return true;
+		const ADDRINT last = addr + (size > 0 ? size - 1 : 0);
+		if(!InBloom(addr) && ((last >> PageBits) == (addr >> PageBits) || !InBloom(last))) return false;
+		// the first range ending after addr
+		uint32_t lo = 0, hi = num_ranges;
+		while(lo < hi) {
+			const uint32_t mid = (lo + hi) / 2;
+			if(ranges[mid].end <= addr) lo = mid + 1; else hi = mid;
+		}
+		return lo < num_ranges && ranges[lo].begin <= last;
+	}
+};
+
+struct PinWatchTable {
+	PinWatchSnapshot* volatile current;
+
+	inline bool IsWatched(ADDRINT addr, uint32_t size) const {
+		return __atomic_load_n(&current, __ATOMIC_ACQUIRE)->IsWatched(addr, size);
+	}
 };
 
 /***********************************************************************/
@@ -70,7 +138,16 @@ const EventKind
 	TestShutdown	= 14U,
 	// events exchanged internally
 	ThreadEndIntern = 15U,
-	AddressOfSymbol = 16U;
+	AddressOfSymbol = 16U,
+	// synchronization operations, from interposed pthread functions
+	SyncLock		= 17U,
+	SyncUnlock		= 18U,
+	SyncWait		= 19U,
+	SyncSignal		= 20U,
+	// atomic read-modify-write instructions and fences, replaces MemAccessBefore for them
+	AtomicAccess	= 21U,
+	// sleeps on the virtual clock, from interposed sleep functions
+	Sleep			= 22U;
 
 /***********************************************************************/
 
@@ -94,6 +171,12 @@ inline const char* EventKindToString(EventKind& kind) {
 	EventKindToStringMacro(TestShutdown)
 	EventKindToStringMacro(ThreadEndIntern)
 	EventKindToStringMacro(AddressOfSymbol)
+	EventKindToStringMacro(SyncLock)
+	EventKindToStringMacro(SyncUnlock)
+	EventKindToStringMacro(SyncWait)
+	EventKindToStringMacro(SyncSignal)
+	EventKindToStringMacro(AtomicAccess)
+	EventKindToStringMacro(Sleep)
 	default:
 		safe_fail("Unknown event kind %d\n", kind);
 		break;
@@ -119,6 +202,9 @@ public:
 	SourceLocation* loc_src;
 	SourceLocation* loc_target;
 	char str[64];
+	// set by concurrit for the pin tool, see PinGuardTable
+	uint32_t skip_kinds;
+	uint32_t skip_epoch;
 
 	EventBuffer() { Clear(); }
 
@@ -137,6 +223,8 @@ public:
 		loc_target = (NULL);
 		memset(str, 0, 64 * sizeof(char));
 		str[0] = '\0';
+		skip_kinds = (0);
+		skip_epoch = (0);
 	}
 
 	bool Check() {
@@ -151,6 +239,7 @@ public:
 			switch(e.type) {
 			case MemRead:
 			case MemWrite:
+			case AtomicAccess:
 				addr = e.addr;
 				size = e.size;
 				break;
@@ -34,6 +34,10 @@
 #include "common.h"
 
 #include <atomic>
+#include <semaphore.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 
 namespace concurrit {
 
@@ -59,6 +63,59 @@ public:
 	static void (* volatile _pthread_exit) (void *);
 	static int (* volatile _pthread_cancel) (pthread_t);
 
+	// synchronization functions, resolved on first use, because they are called before initialize()
+	static int pthread_mutex_lock(pthread_mutex_t* mutex);
+	static int pthread_mutex_trylock(pthread_mutex_t* mutex);
+	static int pthread_mutex_unlock(pthread_mutex_t* mutex);
+
+	static int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex);
+	static int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime);
+	static int pthread_cond_signal(pthread_cond_t* cond);
+	static int pthread_cond_broadcast(pthread_cond_t* cond);
+
+	static int pthread_rwlock_rdlock(pthread_rwlock_t* rwlock);
+	static int pthread_rwlock_wrlock(pthread_rwlock_t* rwlock);
+	static int pthread_rwlock_tryrdlock(pthread_rwlock_t* rwlock);
+	static int pthread_rwlock_trywrlock(pthread_rwlock_t* rwlock);
+	static int pthread_rwlock_unlock(pthread_rwlock_t* rwlock);
+
+	static int pthread_barrier_wait(pthread_barrier_t* barrier);
+
+	static int sem_wait(sem_t* sem);
+	static int sem_trywait(sem_t* sem);
+	static int sem_post(sem_t* sem);
+	static int sem_timedwait(sem_t* sem, const struct timespec* abstime);
+
+	// sleep and clock functions
+	static unsigned int sleep(unsigned int seconds);
+	static int usleep(useconds_t usecs);
+	static int nanosleep(const struct timespec* req, struct timespec* rem);
+	static int gettimeofday(struct timeval* tv, void* tz);
+	static int clock_gettime(clockid_t clk, struct timespec* tp);
+
+	static int (* volatile _pthread_mutex_lock) (pthread_mutex_t*);
+	static int (* volatile _pthread_mutex_trylock) (pthread_mutex_t*);
+	static int (* volatile _pthread_mutex_unlock) (pthread_mutex_t*);
+	static int (* volatile _pthread_cond_wait) (pthread_cond_t*, pthread_mutex_t*);
+	static int (* volatile _pthread_cond_timedwait) (pthread_cond_t*, pthread_mutex_t*, const struct timespec*);
+	static int (* volatile _pthread_cond_signal) (pthread_cond_t*);
+	static int (* volatile _pthread_cond_broadcast) (pthread_cond_t*);
+	static int (* volatile _pthread_rwlock_rdlock) (pthread_rwlock_t*);
+	static int (* volatile _pthread_rwlock_wrlock) (pthread_rwlock_t*);
+	static int (* volatile _pthread_rwlock_tryrdlock) (pthread_rwlock_t*);
+	static int (* volatile _pthread_rwlock_trywrlock) (pthread_rwlock_t*);
+	static int (* volatile _pthread_rwlock_unlock) (pthread_rwlock_t*);
+	static int (* volatile _pthread_barrier_wait) (pthread_barrier_t*);
+	static int (* volatile _sem_wait) (sem_t*);
+	static int (* volatile _sem_trywait) (sem_t*);
+	static int (* volatile _sem_post) (sem_t*);
+	static int (* volatile _sem_timedwait) (sem_t*, const struct timespec*);
+	static unsigned int (* volatile _sleep) (unsigned int);
+	static int (* volatile _usleep) (useconds_t);
+	static int (* volatile _nanosleep) (const struct timespec*, struct timespec*);
+	static int (* volatile _gettimeofday) (struct timeval*, void*);
+	static int (* volatile _clock_gettime) (clockid_t, struct timespec*);
+
 	static volatile bool _initialized;
 };
 
@@ -69,6 +126,78 @@ extern "C" int pthread_join(pthread_t thread, void ** value_ptr);
 extern "C" void pthread_exit(void * value_ptr);
 extern "C" int pthread_cancel(pthread_t thread);
 
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex);
+extern "C" int pthread_mutex_trylock(pthread_mutex_t* mutex);
+extern "C" int pthread_mutex_unlock(pthread_mutex_t* mutex);
+extern "C" int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex);
+extern "C" int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime);
+extern "C" int pthread_cond_signal(pthread_cond_t* cond);
+extern "C" int pthread_cond_broadcast(pthread_cond_t* cond);
+extern "C" int pthread_rwlock_rdlock(pthread_rwlock_t* rwlock);
+extern "C" int pthread_rwlock_wrlock(pthread_rwlock_t* rwlock);
+extern "C" int pthread_rwlock_unlock(pthread_rwlock_t* rwlock);
+extern "C" int pthread_barrier_wait(pthread_barrier_t* barrier);
+extern "C" int sem_wait(sem_t* sem);
+extern "C" int sem_post(sem_t* sem);
+extern "C" int sem_timedwait(sem_t* sem, const struct timespec* abstime);
+
+extern "C" unsigned int sleep(unsigned int seconds);
+extern "C" int usleep(useconds_t usecs);
+extern "C" int nanosleep(const struct timespec* req, struct timespec* rem);
+extern "C" int gettimeofday(struct timeval* tv, void* tz);
+extern "C" int clock_gettime(clockid_t clk, struct timespec* tp);
+
+/********************************************************************************/
+
+// deterministic clock of controlled threads, in nanoseconds.
+// it restarts from the same time in each execution, advances to the end of each sleep,
+// and by a tick at each read, so that threads polling the clock make progress
+class VirtualClock {
+public:
+	static const uint64_t NSecsPerSec = 1000000000ULL;
+	static const uint64_t TickNSecs = 1000ULL;
+	// bound on the real time a timed wait blocks before it checks the virtual clock again
+	static const uint64_t MaxRealWaitNSecs = 1000000ULL;
+	// fixed start time, so that each execution and each run reads the same times
+	static const uint64_t EpochSecs = 1000000000ULL;
+
+	static void Init();
+
+	// called at the start of each execution
+	static inline void Reset() { now_ = start_; }
+
+	static inline uint64_t Now() { return now_; }
+
+	// returns the time after one tick
+	static inline uint64_t Tick() { return (now_ += TickNSecs); }
+
+	// a sleep of nsecs that started at time start (0 for the start of the execution) ends at start + nsecs,
+	// and the clock moves there unless it has passed it. so the sleeps of several threads overlap, as in real time,
+	// instead of adding up. returns the end of the sleep
+	static inline uint64_t Advance(uint64_t start, uint64_t nsecs) {
+		uint64_t end = (start < start_ ? start_ : start) + nsecs;
+		AdvanceTo(end);
+		return end;
+	}
+
+	static void AdvanceTo(uint64_t nsecs);
+
+	// real CLOCK_REALTIME deadline for waiting until the virtual time abstime, returns false if abstime has passed
+	static bool ToRealDeadline(const struct timespec* abstime, struct timespec* deadline);
+
+	static inline uint64_t FromTimespec(const struct timespec* ts) {
+		return static_cast<uint64_t>(ts->tv_sec) * NSecsPerSec + static_cast<uint64_t>(ts->tv_nsec);
+	}
+	static inline void ToTimespec(uint64_t nsecs, struct timespec* ts) {
+		ts->tv_sec = static_cast<time_t>(nsecs / NSecsPerSec);
+		ts->tv_nsec = static_cast<long>(nsecs % NSecsPerSec);
+	}
+
+private:
+	static std::atomic<uint64_t> now_;
+	static uint64_t start_;
+};
+
 /********************************************************************************/
 
 // default implementation calls original functions
@@ -84,6 +213,31 @@ public:
 
 	virtual int pthread_cancel(pthread_t thread);
 
+	virtual int pthread_mutex_lock(pthread_mutex_t* mutex);
+	virtual int pthread_mutex_trylock(pthread_mutex_t* mutex);
+	virtual int pthread_mutex_unlock(pthread_mutex_t* mutex);
+
+	virtual int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex);
+	virtual int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime);
+	virtual int pthread_cond_signal(pthread_cond_t* cond);
+	virtual int pthread_cond_broadcast(pthread_cond_t* cond);
+
+	virtual int pthread_rwlock_rdlock(pthread_rwlock_t* rwlock);
+	virtual int pthread_rwlock_wrlock(pthread_rwlock_t* rwlock);
+	virtual int pthread_rwlock_unlock(pthread_rwlock_t* rwlock);
+
+	virtual int pthread_barrier_wait(pthread_barrier_t* barrier);
+
+	virtual int sem_wait(sem_t* sem);
+	virtual int sem_post(sem_t* sem);
+	virtual int sem_timedwait(sem_t* sem, const struct timespec* abstime);
+
+	virtual unsigned int sleep(unsigned int seconds);
+	virtual int usleep(useconds_t usecs);
+	virtual int nanosleep(const struct timespec* req, struct timespec* rem);
+	virtual int gettimeofday(struct timeval* tv, void* tz);
+	virtual int clock_gettime(clockid_t clk, struct timespec* tp);
+
 	PthreadHandler() {}
 	virtual ~PthreadHandler() {}
 
@@ -104,6 +258,56 @@ public:
 	void pthread_exit(void * param0);
 
 	int pthread_cancel(pthread_t thread);
+
+	// each synchronization operation of a thread running the SUT is an event of kind
+	// SyncLock, SyncUnlock, SyncWait or SyncSignal before the operation,
+	// except for trylock, whose SyncLock comes after it succeeds and not at all when it fails.
+	// while the operation blocks, the thread is not enabled
+	int pthread_mutex_lock(pthread_mutex_t* mutex);
+	int pthread_mutex_trylock(pthread_mutex_t* mutex);
+	int pthread_mutex_unlock(pthread_mutex_t* mutex);
+
+	int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex);
+	int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime);
+	int pthread_cond_signal(pthread_cond_t* cond);
+	int pthread_cond_broadcast(pthread_cond_t* cond);
+
+	int pthread_rwlock_rdlock(pthread_rwlock_t* rwlock);
+	int pthread_rwlock_wrlock(pthread_rwlock_t* rwlock);
+	int pthread_rwlock_unlock(pthread_rwlock_t* rwlock);
+
+	int pthread_barrier_wait(pthread_barrier_t* barrier);
+
+	int sem_wait(sem_t* sem);
+	int sem_post(sem_t* sem);
+
+	// with virtual time (-g), sleeps of threads running the SUT are events of kind Sleep
+	// that advance the virtual clock without blocking, clocks return the virtual time,
+	// and timed waits time out when their deadline passes in virtual time
+	int sem_timedwait(sem_t* sem, const struct timespec* abstime);
+
+	unsigned int sleep(unsigned int seconds);
+	int usleep(useconds_t usecs);
+	int nanosleep(const struct timespec* req, struct timespec* rem);
+	int gettimeofday(struct timeval* tv, void* tz);
+	int clock_gettime(clockid_t clk, struct timespec* tp);
+
+private:
+	// returns the current coroutine if its synchronization operations are tracked, otherwise NULL
+	static Coroutine* TrackedThread();
+
+	// runs the event of the operation on the synchronization object at addr
+	static void OnSyncEvent(Coroutine* current, EventKind kind, void* addr);
+
+	// returns the current coroutine if it runs on the virtual clock, otherwise NULL
+	static Coroutine* VirtualTimeThread();
+
+	// advances the virtual clock, and runs the event of the sleep
+	static void OnSleep(Coroutine* current, uint64_t nsecs);
+
+	// called when the bounded real wait of a timed wait on the virtual clock expires;
+	// advances the clock to the earliest deadline once no controlled thread runs for two expiries in a row
+	static void OnRealWaitExpired(Coroutine* current, bool* idle, unsigned* progress);
 };
 
 
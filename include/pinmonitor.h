@@ -39,8 +39,6 @@
 #include "interface.h"
 #include "sharedaccess.h"
 
-#define MAX_THREADS 2048
-
 namespace concurrit {
 
 class Coroutine;
@@ -89,17 +87,99 @@ public:
 
 	static void AtPc(Coroutine* current, Scenario* scenario, int pc, SourceLocation* loc = NULL);
 
+	// addr is 0 for fences
+	static void AtomicAccess(Coroutine* current, Scenario* scenario, ADDRINT addr, uint32_t size, SourceLocation* loc = NULL);
+
+	static void Sleep(Coroutine* current, Scenario* scenario, uint64_t nsecs);
+
+	// kind is one of SyncLock, SyncUnlock, SyncWait and SyncSignal, addr is the address of the synchronization object
+	static void SyncOp(Coroutine* current, Scenario* scenario, EventKind kind, ADDRINT addr);
+
 	/******************************************************************************************/
 
 	static ADDRINT GetAddressOfSymbol(const std::string& symbol, ADDRINT addr = ADDRINT(0));
 
 	/******************************************************************************************/
 
+	// invalidates the kinds of events the pin tool drops for each thread
+	static inline void InvalidateGuards() { __sync_fetch_and_add(&guards_.epoch, 1); }
+	static inline uint32_t GuardEpoch() { return guards_.epoch; }
+
+	// kinds of events the thread can drop until the guard epoch changes:
+	// while the thread would take its last taken node again, the events that
+	// do not change the auxiliary variables the node depends on cannot change its evaluation,
+	// and do not leave state behind (unlike FuncEnter and FuncReturn)
+	static uint32_t SkippableKinds(Coroutine* current, Scenario* scenario);
+	// the same for a node whose predicates have the given dependencies
+	static uint32_t SkippableKinds(unsigned dependencies);
+
+	// kinds of events the pin tool must instrument: the scheduling points,
+	// and the events that update auxiliary variables in dependencies.
+	// all kinds if ScopedInstrumentation is off, or every event is observed (stress mode, traces)
+	static uint32_t InstrumentedKinds(unsigned dependencies);
+
+	// fences only set the FenceKey of Atomics, and are scheduling points only with ScheduleFences,
+	// so they are instrumented only then, or if a predicate may depend on Atomics (or traces are saved)
+	static bool InstrumentsFences(unsigned dependencies);
+
+	// called with the dependencies of each compiled predicate; if they widen the instrumented kinds or add fences,
+	// the pin tool drops its code cache and re-instruments the code for the new kinds
+	static void OnPredicateCompiled(unsigned dependencies);
+
+	// adds [addr, addr+size) to the ranges whose reads and writes are recorded, with WatchAccesses
+	static void WatchAccesses(ADDRINT addr, size_t size);
+	// records the reads and writes of all addresses, for predicates over any address
+	static void WatchAllAccesses();
+	// frees the watch snapshots replaced during the execution, called when no thread of the test runs
+	static void EndExecution();
+	static inline bool IsWatchedAccess(ADDRINT addr, uint32_t size) { return watches_.IsWatched(addr, size); }
+
+	static inline bool IsSchedulingPoint(EventKind kind) { return (Config::SchedulingPoints & (1U << kind)) != 0; }
+
+	// synchronization operations are events only if one of their kinds is a scheduling point,
+	// or may become one in run-ahead mode
+	static inline bool IsSyncTracked() {
+		return Config::RunAhead || (Config::SchedulingPoints & ((1U << SyncLock) | (1U << SyncUnlock) | (1U << SyncWait) | (1U << SyncSignal))) != 0;
+	}
+
+	// runs a controlled transition if kind is a scheduling point, or in run-ahead mode if a compiled predicate depends on the event,
+	// otherwise the thread continues natively, dropping the aux state of the event
+	static void OnSchedulingPoint(Coroutine* current, Scenario* scenario, EventKind kind);
+	// is_point overrides whether kind is a scheduling point
+	static void OnSchedulingPoint(Coroutine* current, Scenario* scenario, EventKind kind, bool is_point);
+
+	// auxiliary variables (AuxDependency bits) an event of the kind updates
+	static unsigned AuxChangesOf(EventKind kind);
+
+	// the same, without the reads and writes of an access, which its MemRead and MemWrite events report
+	// only if they are recorded. these are the changes the scheduling point of the event passes on
+	static unsigned AuxUpdatesOf(EventKind kind);
+
+	static void InjectDelay(Coroutine* current);
+
+	/******************************************************************************************/
+
 private:
 //	static Coroutine* tid_to_coroutine_[MAX_THREADS];
 	static volatile bool enabled_;
 	static volatile bool down_;
 	static PinToolOptions options_;
+	static PinGuardTable guards_;
+	static volatile unsigned predicate_dependencies_; // union of the dependencies of the compiled predicates
+	static volatile unsigned runahead_dependencies_; // AUXDEP_UNKNOWN until the first execution ends, so it runs fully controlled
+	// the dependencies the instrumented kinds are derived from
+	static unsigned InstrumentedDependencies();
+	// re-instruments the code if the instrumented kinds or fences changed, called with options_mutex_ held
+	static void UpdateInstrumentation();
+	static Mutex options_mutex_;
+	static PinWatchTable watches_;
+	static PinWatchSnapshot watch_all_snapshot_;
+	static std::vector<PinWatchRange> watch_ranges_; // guarded by options_mutex_
+	static std::vector<PinWatchSnapshot*> retired_watches_; // guarded by options_mutex_
+	static bool watch_all_;
+	// above this many (merged) ranges, all accesses are watched instead
+	static const size_t MaxWatchRanges = 1024;
+	static void PublishWatches();
 	static SymbolToAddressMap symbol_to_address_;
 };
 
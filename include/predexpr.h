@@ -0,0 +1,278 @@
+/**
+ * Copyright (c) 2010-2011,
+ * Tayfun Elmas    <elmas@cs.berkeley.edu>
+ * All rights reserved.
+ * <p/>
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * <p/>
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * <p/>
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * <p/>
+ * 3. The names of the contributors may not be used to endorse or promote
+ * products derived from this software without specific prior written
+ * permission.
+ * <p/>
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef PREDEXPR_H_
+#define PREDEXPR_H_
+
+#include "common.h"
+#include "coroutine.h"
+#include "threadvar.h"
+#include "transpred.h"
+
+namespace concurrit {
+
+/********************************************************************************/
+
+// predicate given by a functor evaluated on the current thread.
+// each functor type gets its own evaluator, which the compiled program calls directly.
+// dependency tells which auxiliary variables the functor reads (see AuxDependency)
+template<typename F>
+class FunctionTransitionPredicate : public TransitionPredicate {
+public:
+	explicit FunctionTransitionPredicate(const F& f, unsigned dependency = AUXDEP_UNKNOWN)
+	: TransitionPredicate(), f_(f), dependency_(dependency) {}
+	~FunctionTransitionPredicate() {}
+
+	bool EvalState(Coroutine* t = NULL) {
+		return f_(safe_notnull(t));
+	}
+
+	void Compile(PredicateProgram* program) {
+		program->EmitFunction(&FunctionTransitionPredicate<F>::Eval, &f_, dependency_);
+	}
+
+	static bool Eval(void* f, Coroutine* t) {
+		return (*static_cast<F*>(f))(t);
+	}
+
+private:
+	F f_;
+	unsigned dependency_;
+};
+
+template<typename F>
+inline TransitionPredicatePtr MakeFunctionPredicate(const F& f, unsigned dependency = AUXDEP_UNKNOWN) {
+	TransitionPredicatePtr p(new FunctionTransitionPredicate<F>(f, dependency));
+	return p;
+}
+
+/********************************************************************************/
+
+// expression templates: a predicate expression is a value whose type is the whole expression,
+// so evaluating it inlines all of its operands. it converts to a TransitionPredicatePtr,
+// so it can be passed to the DSL macros and combined with other predicates.
+// each expression also emits its auxiliary loads into a compiled program (Emit),
+// so the program does not call the whole expression through a function pointer
+
+// predicate holding an expression; the tree walk evaluates the inlined expression,
+// the compiled program runs the instructions the expression emits
+template<typename E>
+class ExprTransitionPredicate : public TransitionPredicate {
+public:
+	explicit ExprTransitionPredicate(const E& e) : TransitionPredicate(), e_(e) {}
+	~ExprTransitionPredicate() {}
+
+	bool EvalState(Coroutine* t = NULL) {
+		return e_(safe_notnull(t));
+	}
+
+	// the instructions refer to e_, which lives as long as this predicate
+	void Compile(PredicateProgram* program) {
+		e_.Emit(program);
+	}
+
+private:
+	E e_;
+};
+
+template<typename E>
+struct PredExpr {
+	inline const E& self() const { return static_cast<const E&>(*this); }
+
+	operator TransitionPredicatePtr() const {
+		TransitionPredicatePtr p(new ExprTransitionPredicate<E>(self()));
+		return p;
+	}
+};
+
+/********************************************************************************/
+
+// thread whose auxiliary state is tested; the current thread if tvar is NULL
+inline THREADID PredExprTid(ThreadVar* tvar, Coroutine* t) {
+	return (tvar == NULL) ? t->tid() : safe_notnull(tvar->thread())->tid();
+}
+
+template<typename V>
+struct AuxIsSetExpr : public PredExpr<AuxIsSetExpr<V>> {
+	AuxIsSetExpr(V* var, ThreadVar* tvar) : var_(var), tvar_(tvar) {}
+
+	inline bool operator()(Coroutine* t) const {
+		return var_->V::isset(PredExprTid(tvar_, t));
+	}
+
+	inline unsigned dependency() const { return AuxDependencyOn(var_->dependency(), tvar_); }
+
+	void Emit(PredicateProgram* program) const {
+		program->EmitAux(&AuxIsSetExpr<V>::IsSet, var_, tvar_, var_->dependency());
+	}
+
+	static bool IsSet(void* var, THREADID tid) {
+		return static_cast<V*>(var)->V::isset(tid);
+	}
+
+	V* var_;
+	ThreadVar* tvar_;
+};
+
+struct InFuncExpr : public PredExpr<InFuncExpr> {
+	InFuncExpr(ADDRINT addr, ThreadVar* tvar) : addr_(addr), tvar_(tvar) {}
+
+	inline bool operator()(Coroutine* t) const {
+		return AuxState::InFunc->get(addr_, PredExprTid(tvar_, t)) > 0;
+	}
+
+	inline unsigned dependency() const { return AuxDependencyOn(AUXDEP_INFUNC, tvar_); }
+
+	void Emit(PredicateProgram* program) const {
+		program->EmitAux(&InFuncExpr::IsInFunc, const_cast<InFuncExpr*>(this), tvar_, AUXDEP_INFUNC);
+	}
+
+	static bool IsInFunc(void* expr, THREADID tid) {
+		return AuxState::InFunc->get(static_cast<InFuncExpr*>(expr)->addr_, tid) > 0;
+	}
+
+	ADDRINT addr_;
+	ThreadVar* tvar_;
+};
+
+// the current thread is the one bound to tvar (or tvar is unbound)
+struct ByExpr : public PredExpr<ByExpr> {
+	ByExpr(ThreadVar* tvar, bool negate) : tvar_(tvar), negate_(negate) {}
+
+	inline bool operator()(Coroutine* t) const {
+		Coroutine* co = tvar_->thread();
+		return co == NULL || ((co->tid() == t->tid()) != negate_);
+	}
+
+	inline unsigned dependency() const { return AUXDEP_THREADS; }
+
+	void Emit(PredicateProgram* program) const {
+		program->EmitThreadVarsEqual(AuxState::Tid.get(), tvar_, negate_);
+	}
+
+	ThreadVar* tvar_;
+	bool negate_;
+};
+
+template<typename F>
+struct LambdaExpr : public PredExpr<LambdaExpr<F>> {
+	explicit LambdaExpr(const F& f) : f_(f) {}
+
+	inline bool operator()(Coroutine* t) const {
+		return f_(t);
+	}
+
+	inline unsigned dependency() const { return AUXDEP_UNKNOWN; }
+
+	// the condition is opaque, so the program calls it
+	void Emit(PredicateProgram* program) const {
+		program->EmitFunction(&LambdaExpr<F>::Eval, const_cast<LambdaExpr<F>*>(this), AUXDEP_UNKNOWN);
+	}
+
+	static bool Eval(void* expr, Coroutine* t) {
+		return static_cast<LambdaExpr<F>*>(expr)->f_(t);
+	}
+
+	F f_;
+};
+
+template<typename F>
+inline LambdaExpr<F> MakeLambdaExpr(const F& f) {
+	return LambdaExpr<F>(f);
+}
+
+/********************************************************************************/
+
+template<typename A, typename B>
+struct AndExpr : public PredExpr<AndExpr<A,B>> {
+	AndExpr(const A& a, const B& b) : a_(a), b_(b) {}
+	inline bool operator()(Coroutine* t) const { return a_(t) && b_(t); }
+	inline unsigned dependency() const { return a_.dependency() | b_.dependency(); }
+	void Emit(PredicateProgram* program) const {
+		std::vector<PredicateProgram> operands(2);
+		a_.Emit(&operands[0]);
+		b_.Emit(&operands[1]);
+		program->EmitNAry(NAryAND, &operands);
+	}
+	A a_;
+	B b_;
+};
+
+template<typename A, typename B>
+struct OrExpr : public PredExpr<OrExpr<A,B>> {
+	OrExpr(const A& a, const B& b) : a_(a), b_(b) {}
+	inline bool operator()(Coroutine* t) const { return a_(t) || b_(t); }
+	inline unsigned dependency() const { return a_.dependency() | b_.dependency(); }
+	void Emit(PredicateProgram* program) const {
+		std::vector<PredicateProgram> operands(2);
+		a_.Emit(&operands[0]);
+		b_.Emit(&operands[1]);
+		program->EmitNAry(NAryOR, &operands);
+	}
+	A a_;
+	B b_;
+};
+
+template<typename A>
+struct NotExpr : public PredExpr<NotExpr<A>> {
+	explicit NotExpr(const A& a) : a_(a) {}
+	inline bool operator()(Coroutine* t) const { return !a_(t); }
+	inline unsigned dependency() const { return a_.dependency(); }
+	void Emit(PredicateProgram* program) const {
+		a_.Emit(program);
+		program->EmitNot();
+	}
+	A a_;
+};
+
+template<typename A, typename B>
+inline AndExpr<A,B> operator && (const PredExpr<A>& a, const PredExpr<B>& b) {
+	return AndExpr<A,B>(a.self(), b.self());
+}
+
+template<typename A, typename B>
+inline OrExpr<A,B> operator || (const PredExpr<A>& a, const PredExpr<B>& b) {
+	return OrExpr<A,B>(a.self(), b.self());
+}
+
+template<typename A>
+inline NotExpr<A> operator ! (const PredExpr<A>& a) {
+	return NotExpr<A>(a.self());
+}
+
+/********************************************************************************/
+
+} // end namespace
+
+#endif /* PREDEXPR_H_ */
@@ -110,6 +110,11 @@ public:
 
 	void SaveSearchInfo();
 
+	// stress mode: records that current takes the transition of a scheduling point
+	void OnStressTransition(Coroutine* current);
+	// saves the seed of the current stress execution, and its taken schedule if it failed
+	void SaveStressExecution(bool failed);
+
 	/*
 	 * Methods to be used in testcases to control the test scenario
 	 */
@@ -153,7 +158,11 @@ public:
 	// run before and after each controlled transition
 //	void BeforeControlledTransition(Coroutine* current);
 //	void AfterControlledTransition(Coroutine* current);
-	void OnControlledTransition(Coroutine* current);
+	// changes are the auxiliary variables (AuxDependency bits) updated by the event
+	void OnControlledTransition(Coroutine* current, unsigned changes = AUXDEP_UNKNOWN);
+	bool CanSkipControlledTransition(Coroutine* current, unsigned changes);
+	// same, without recording new changes
+	bool CanSkipControlledTransition(Coroutine* current);
 //	void OnControlledTransition(Coroutine* current) {
 //		BeforeControlledTransition(current);
 //		AfterControlledTransition(current);
@@ -169,6 +178,9 @@ public:
 	void DSLRunThrough(StaticDSLInfo* static_info, const TransitionPredicatePtr& pred, const ThreadVarPtr& var, const char* message = NULL);
 	void DSLRunThrough(StaticDSLInfo* static_info, const TransitionPredicatePtr& pred, const char* message = NULL);
 
+	void DSLRunThroughN(StaticDSLInfo* static_info, const TransitionPredicatePtr& pred, int num_steps, const ThreadVarPtr& var, const char* message = NULL);
+	void DSLRunThroughN(StaticDSLInfo* static_info, const TransitionPredicatePtr& pred, int num_steps, const char* message = NULL);
+
 	void DSLRunUntil(StaticDSLInfo* static_info, const TransitionPredicatePtr& pred, const ThreadVarPtr& var, const char* message = NULL);
 	void DSLRunUntil(StaticDSLInfo* static_info, const TransitionPredicatePtr& pred, const char* message = NULL);
 
@@ -184,6 +196,9 @@ public:
 	void EvalTransition(Coroutine* current, TransitionNode* node, int& child_index, bool& take);
 	void UpdateAlternateLocations(Coroutine* current);
 
+	// run when a constraint or an assertion is installed or removed
+	void UpdateTransitionConjunctions();
+
 	/******************************************************************/
 	// shortcuts to statistics
 	Timer& timer(const std::string& name) {
@@ -204,6 +219,9 @@ protected:
 	// runs the threads uncontrolled way, until they all got into ended state
 	void RunUncontrolled();
 
+	// runs the threads in the order of the schedule in StressReplayFile, in place of the test case
+	void ReplayStressSchedule();
+
 	virtual ConcurritException* RunOnce() throw();
 	void RunTestCase() throw();
 	void RunSetUp() throw();
@@ -245,9 +263,18 @@ private:
 
 	DECL_FIELD(TransitionConstraintsPtr, trans_constraints)
 	DECL_FIELD(TransitionAssertionsPtr, trans_assertions)
+	DECL_FIELD_REF(TransitionConjunction, constraints) // compiled trans_constraints
+	DECL_FIELD_REF(TransitionConjunction, assertions) // compiled trans_assertions
+	DECL_FIELD(unsigned, trans_dependencies) // auxiliary variables read by the constraints and the assertions
 
 	DECL_FIELD(Statistics, statistics)
 
+	// seed of the delays injected in the current execution in the stress mode
+	DECL_FIELD(unsigned int, stress_seed)
+	// threads in the order they took their scheduling points in the current stress execution
+	DECL_FIELD_REF(PersistentSchedule, stress_schedule)
+	DECL_FIELD_REF(Mutex, stress_mutex)
+
 	DECL_FIELD_GET_REF(ExecutionTreeManager, exec_tree)
 
 	DECL_STATIC_FIELD(FILE*, trace_file)
@@ -82,6 +82,7 @@ public:
 	static Thread* Current();
 
 	static void SetCancellable();
+	static void SetAffinity(THREADID tid);
 
 	static void CleanupHandler(void* arg);
 	static void* ThreadEntry(void* arg);
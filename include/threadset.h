@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2010-2011,
+ * Tayfun Elmas    <elmas@cs.berkeley.edu>
+ * All rights reserved.
+ * <p/>
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * <p/>
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * <p/>
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * <p/>
+ * 3. The names of the contributors may not be used to endorse or promote
+ * products derived from this software without specific prior written
+ * permission.
+ * <p/>
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef THREADSET_H_
+#define THREADSET_H_
+
+#include "common.h"
+#include <algorithm>
+
+namespace concurrit {
+
+/********************************************************************************/
+
+// dense set of thread ids, one bit for each tid.
+// membership tests are O(1), and restricting a set by another is a word-wise mask
+class ThreadSet {
+	static const int WordBits = 64;
+public:
+	ThreadSet() : size_(0) {}
+	~ThreadSet() {}
+
+	inline bool contains(THREADID tid) const {
+		const size_t w = static_cast<size_t>(tid) / WordBits;
+		return tid >= 0 && w < words_.size() && (words_[w] & bit(tid)) != 0;
+	}
+
+	inline void insert(THREADID tid) {
+		safe_assert(tid >= 0);
+		const size_t w = static_cast<size_t>(tid) / WordBits;
+		if(w >= words_.size()) {
+			words_.resize(w + 1, 0);
+		}
+		if((words_[w] & bit(tid)) == 0) {
+			words_[w] |= bit(tid);
+			++size_;
+		}
+	}
+
+	inline void erase(THREADID tid) {
+		if(contains(tid)) {
+			words_[static_cast<size_t>(tid) / WordBits] &= ~bit(tid);
+			--size_;
+		}
+	}
+
+	inline void clear() {
+		words_.clear();
+		size_ = 0;
+	}
+
+	inline bool empty() const { return size_ == 0; }
+	inline size_t size() const { return size_; }
+
+	// adds the tids in other
+	void insert_all(const ThreadSet& other) {
+		if(other.words_.size() > words_.size()) {
+			words_.resize(other.words_.size(), 0);
+		}
+		for(size_t w = 0; w < other.words_.size(); ++w) {
+			words_[w] |= other.words_[w];
+		}
+		recount();
+	}
+
+	// removes the tids not in other
+	void retain_all(const ThreadSet& other) {
+		for(size_t w = 0; w < words_.size(); ++w) {
+			words_[w] &= (w < other.words_.size()) ? other.words_[w] : 0;
+		}
+		recount();
+	}
+
+	// removes the tids in other
+	void erase_all(const ThreadSet& other) {
+		const size_t n = std::min(words_.size(), other.words_.size());
+		for(size_t w = 0; w < n; ++w) {
+			words_[w] &= ~other.words_[w];
+		}
+		recount();
+	}
+
+	// the smallest tid in the set greater than or equal to tid, or -1
+	THREADID next(THREADID tid = 0) const {
+		if(tid < 0) tid = 0;
+		size_t w = static_cast<size_t>(tid) / WordBits;
+		if(w >= words_.size()) return -1;
+		uint64_t word = words_[w] & (~0ULL << (tid % WordBits));
+		while(word == 0) {
+			if(++w >= words_.size()) return -1;
+			word = words_[w];
+		}
+		return static_cast<THREADID>(w * WordBits + __builtin_ctzll(word));
+	}
+
+	bool operator == (const ThreadSet& other) const {
+		const size_t n = std::max(words_.size(), other.words_.size());
+		for(size_t w = 0; w < n; ++w) {
+			uint64_t a = w < words_.size() ? words_[w] : 0;
+			uint64_t b = w < other.words_.size() ? other.words_[w] : 0;
+			if(a != b) return false;
+		}
+		return true;
+	}
+
+private:
+	static inline uint64_t bit(THREADID tid) {
+		return 1ULL << (static_cast<unsigned>(tid) % WordBits);
+	}
+
+	void recount() {
+		size_ = 0;
+		for(size_t w = 0; w < words_.size(); ++w) {
+			size_ += __builtin_popcountll(words_[w]);
+		}
+	}
+
+	std::vector<uint64_t> words_;
+	size_t size_;
+};
+
+/********************************************************************************/
+
+} // end namespace
+
+#endif /* THREADSET_H_ */
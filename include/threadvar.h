@@ -36,12 +36,14 @@
 #define THREADVAR_H_
 
 #include "common.h"
-#include <boost/shared_ptr.hpp>
+#include "threadset.h"
+#include "refcount.h"
 
 
 namespace concurrit {
 
 class Coroutine;
+class ThreadVarPtrSet;
 
 /********************************************************************************/
 
@@ -63,7 +65,7 @@ private:
 
 /********************************************************************************/
 
-class ThreadVar {
+class ThreadVar : public RefCounted<ThreadVar> {
 public:
 	explicit ThreadVar(Coroutine* thread = NULL, const std::string& name = "<unknown>")
 	: name_(name), thread_(thread) {
@@ -73,17 +75,26 @@ public:
 
 	std::string ToString();
 
-	inline void clear_thread() { thread_ = NULL; }
+	// sets index their members by thread, so rebinding a member invalidates the indices of its sets
+	inline void set_thread(Coroutine* thread);
+
+	inline void clear_thread() { set_thread(NULL); }
 	inline bool is_empty() { return thread_ == NULL; }
 
 	THREADID tid();
 
+	// called by the sets when the variable is inserted or removed
+	void AddSet(ThreadVarPtrSet* set) { sets_.push_back(set); }
+	void RemoveSet(ThreadVarPtrSet* set);
+
 //protected:
 //	static int get_id();
 //
 private:
 	DECL_FIELD(std::string, name)
-	DECL_FIELD(Coroutine*, thread)
+	DECL_FIELD_GET(Coroutine*, thread)
+
+	std::vector<ThreadVarPtrSet*> sets_; // ThreadVarPtrSets containing this variable
 //	DECL_FIELD_CONST(int, id)
 //	DECL_STATIC_FIELD(int, next_id)
 };
@@ -104,7 +115,7 @@ public:
 //bool operator!=(const ThreadVar& tx, const ThreadVar& ty);
 //bool operator<(const ThreadVar& a, const ThreadVar& b);
 
-typedef boost::shared_ptr<ThreadVar> ThreadVarPtr;
+typedef boost::intrusive_ptr<ThreadVar> ThreadVarPtr;
 
 // thread variable assignment. do not use the standard assignment =
 ThreadVarPtr& operator << (ThreadVarPtr& to, const ThreadVarPtr& from);
@@ -116,19 +127,74 @@ struct ThreadVarPtr_compare {
     bool operator()(const ThreadVarPtr& tx, const ThreadVarPtr& ty) const;
 };
 
+// the set keeps an index from tids to its members, so finding the member bound to a thread is O(1).
+// the index is rebuilt lazily after the set changes, or one of its members is bound to another thread.
+// insert, erase and clear hide the ones of std::set to keep the index and the members' set lists up to date
+
 class ThreadVarPtrSet : public std::set<ThreadVarPtr, ThreadVarPtr_compare> {
+	typedef std::set<ThreadVarPtr, ThreadVarPtr_compare> Base;
 public:
-	ThreadVarPtrSet() : std::set<ThreadVarPtr, ThreadVarPtr_compare>() {}
-	~ThreadVarPtrSet() {}
-
-	ThreadVarPtr FindByThread(Coroutine* thread) {
+	ThreadVarPtrSet() : Base(), stale_(true) {}
+	ThreadVarPtrSet(const ThreadVarPtrSet& other) : Base(other), stale_(true) {
 		for(iterator itr = begin(); itr != end(); ++itr) {
-			ThreadVarPtr t = (*itr);
-			if(t->thread() == thread) {
-				return t;
+			(*itr)->AddSet(this);
+		}
+	}
+	~ThreadVarPtrSet() {
+		for(iterator itr = begin(); itr != end(); ++itr) {
+			(*itr)->RemoveSet(this);
+		}
+	}
+
+	ThreadVarPtrSet& operator = (const ThreadVarPtrSet& other) {
+		if(this != &other) {
+			clear();
+			for(const_iterator itr = other.begin(); itr != other.end(); ++itr) {
+				insert(*itr);
 			}
 		}
-		return ThreadVarPtr();
+		return *this;
+	}
+
+	std::pair<iterator, bool> insert(const ThreadVarPtr& t) {
+		std::pair<iterator, bool> res = Base::insert(t);
+		if(res.second) {
+			t->AddSet(this);
+			stale_ = true;
+		}
+		return res;
+	}
+
+	size_type erase(const ThreadVarPtr& t) {
+		iterator itr = find(t);
+		if(itr == end()) return 0;
+		(*itr)->RemoveSet(this);
+		Base::erase(itr);
+		stale_ = true;
+		return 1;
+	}
+
+	void clear() {
+		for(iterator itr = begin(); itr != end(); ++itr) {
+			(*itr)->RemoveSet(this);
+		}
+		Base::clear();
+		stale_ = true;
+	}
+
+	// called when a member is bound to another thread
+	inline void Invalidate() { stale_ = true; }
+
+	// returns the member bound to thread, or None.
+	// the result is borrowed from the set, so it is valid until the member is removed
+	const ThreadVarPtr& FindByThread(Coroutine* thread);
+
+	static const ThreadVarPtr None;
+
+	// tids of the bound members
+	const ThreadSet& Tids() {
+		Reindex();
+		return tids_;
 	}
 
 	void Add(const ThreadVarPtr& t) {
@@ -142,6 +208,62 @@ public:
 		safe_assert(this->find(t) != this->end());
 		this->erase(t);
 	}
+
+private:
+	void Reindex();
+
+	std::vector<const ThreadVarPtr*> by_tid_; // members are nodes of the set, so their addresses are stable
+	ThreadSet tids_;
+	bool stale_;
+};
+
+inline void ThreadVar::set_thread(Coroutine* thread) {
+	if(thread_ == thread) return;
+	thread_ = thread;
+	for(std::vector<ThreadVarPtrSet*>::iterator itr = sets_.begin(), end = sets_.end(); itr != end; ++itr) {
+		(*itr)->Invalidate();
+	}
+}
+
+/********************************************************************************/
+
+// the sets of the WITH and WITHOUT blocks enclosing a DSL statement, see WithThreads and WithoutThreads in api.h.
+// the sets hold variables, not threads, and are looked up when a thread is checked,
+// so a variable bound after its block is entered restricts the selection as well
+
+class ThreadRestriction {
+public:
+	ThreadRestriction() {}
+	~ThreadRestriction() {}
+
+	bool empty() const { return with_.empty() && without_.empty(); }
+
+	// false if thread is bound to a member of a WITHOUT set, or to no member of some WITH set
+	bool Allows(Coroutine* thread) const;
+
+	// the same for a member of a scope, an unbound member is judged by the variable itself
+	bool Allows(const ThreadVarPtr& t) const;
+
+	void Push(ThreadVarPtrSet* set, bool with) {
+		safe_assert(set != NULL);
+		(with ? with_ : without_).push_back(set);
+	}
+
+	void Pop(ThreadVarPtrSet* set, bool with) {
+		std::vector<ThreadVarPtrSet*>& sets = (with ? with_ : without_);
+		safe_assert(!sets.empty() && sets.back() == set);
+		sets.pop_back();
+	}
+
+	// the blocks the test thread is in
+	static ThreadRestriction* Current() { return &current_; }
+
+private:
+	// the sets are static infos of the blocks, so they outlive the nodes keeping copies of the restriction
+	std::vector<ThreadVarPtrSet*> with_;
+	std::vector<ThreadVarPtrSet*> without_;
+
+	static ThreadRestriction current_;
 };
 
 /********************************************************************************/
@@ -175,7 +297,7 @@ public:
 
 	ThreadVarPtr FindByThread(Coroutine* thread) {
 		for(iterator itr = begin(); itr != end(); ++itr) {
-			ThreadVarPtr t = (*itr);
+			const ThreadVarPtr& t = (*itr);
 			if(t->thread() == thread) {
 				return t;
 			}
@@ -37,7 +37,8 @@
 #include "common.h"
 #include "threadvar.h"
 #include "thread.h"
-#include <boost/shared_ptr.hpp>
+#include "auxtable.h"
+#include "refcount.h"
 
 namespace concurrit {
 
@@ -50,11 +51,13 @@ namespace concurrit {
 
 /********************************************************************************/
 class TransitionPredicate;
-typedef boost::shared_ptr<TransitionPredicate> TransitionPredicatePtr;
+typedef boost::intrusive_ptr<TransitionPredicate> TransitionPredicatePtr;
 
-class TransitionPredicate {
+class PredicateProgram;
+
+class TransitionPredicate : public RefCounted<TransitionPredicate> {
 public:
-	TransitionPredicate() {}
+	TransitionPredicate() : interned_(false) {}
 	virtual ~TransitionPredicate() {}
 
 	virtual bool EvalState(Coroutine* t = NULL) = 0;
@@ -63,8 +66,12 @@ public:
 		return EvalState(var->thread());
 	}
 
-	static TransitionPredicatePtr True();
-	static TransitionPredicatePtr False();
+	static const TransitionPredicatePtr& True();
+	static const TransitionPredicatePtr& False();
+
+	// emits the flat form of this predicate to the empty program.
+	// by default, the program calls EvalState, which stateful predicates must keep
+	virtual void Compile(PredicateProgram* program);
 
 	virtual std::string ToString() {
 		return ""; // TODO(elmas): implement
@@ -78,8 +85,365 @@ public:
 	bool operator () (const ThreadVarPtr& t) {
 		return EvalState(t == NULL ? NULL : t->thread());
 	}
+
+	static inline bool IsInterned(const TransitionPredicatePtr& p) {
+		return p != NULL && p->interned_;
+	}
+
+private:
+	// set when the predicate is shared through PredicateTable
+	DECL_FIELD(bool, interned)
+};
+
+/********************************************************************************/
+
+enum NAryOp { NAryAND = 1, NAryOR = 2 };
+
+// the auxiliary variables a predicate reads, one bit for each variable of AuxState.
+// AUXDEP_UNKNOWN marks inputs that are not tracked (other threads' state, user variables and code),
+// so the predicate must be evaluated at every transition
+
+enum AuxDependency {
+	AUXDEP_NONE			= 0U,
+	AUXDEP_ENDS			= 1U << 0,
+	AUXDEP_READS		= 1U << 1,
+	AUXDEP_WRITES		= 1U << 2,
+	AUXDEP_CALLSFROM	= 1U << 3,
+	AUXDEP_CALLSTO		= 1U << 4,
+	AUXDEP_ENTERS		= 1U << 5,
+	AUXDEP_RETURNS		= 1U << 6,
+	AUXDEP_INFUNC		= 1U << 7,
+	AUXDEP_NUMINFUNC	= 1U << 8,
+	AUXDEP_ARG0			= 1U << 9,
+	AUXDEP_ARG1			= 1U << 10,
+	AUXDEP_RETVAL		= 1U << 11,
+	AUXDEP_PC			= 1U << 12,
+	AUXDEP_ATPC			= 1U << 13,
+	AUXDEP_LOCKS		= 1U << 14,
+	AUXDEP_UNLOCKS		= 1U << 15,
+	AUXDEP_WAITS		= 1U << 16,
+	AUXDEP_SIGNALS		= 1U << 17,
+	AUXDEP_ATOMICS		= 1U << 18,
+	AUXDEP_SLEEPS		= 1U << 19,
+	AUXDEP_THREADS		= 1U << 30,	// bindings of thread variables, which change only with the execution tree
+	AUXDEP_UNKNOWN		= 1U << 31
+};
+
+// only the state of the current thread is tracked (defined after AuxState)
+inline unsigned AuxDependencyOn(unsigned dependency, ThreadVar* tvar);
+
+// whether a value reading the variables in dependencies may change after the variables in changes are updated
+inline bool AuxDependsOn(unsigned dependencies, unsigned changes) {
+	return (dependencies & changes) != 0 || ((dependencies | changes) & AUXDEP_UNKNOWN) != 0;
+}
+
+// flat form of a predicate tree, evaluated in a loop without walking the tree.
+// the result of each instruction is kept in an accumulator, and the n-ary
+// operators become jumps over the rest of their operands. before the program
+// runs, the jumps and negations are folded into the successors of the other
+// instructions, so the loop dispatches only the instructions that compute a value.
+
+enum PredicateOpcode {
+	PREDOP_CALL = 1,		// acc = pred->EvalState(t)
+	PREDOP_AUX = 2,			// acc = aux_fn(aux_arg, tid of tvar1, or of t if tvar1 is NULL)
+	PREDOP_TVARS_EQ = 3,	// acc = tvar1 (or t if tvar1 is NULL) and tvar2 are bound to the same thread (or one is unbound)
+	PREDOP_TVARS_NEQ = 4,	// acc = tvar1 and tvar2 are bound to different threads (or one is unbound)
+	PREDOP_NOT = 5,			// acc = !acc
+	PREDOP_JUMP_FALSE = 6,	// if !acc, jump by offset
+	PREDOP_JUMP_TRUE = 7,	// if acc, jump by offset
+	PREDOP_FUNCTION = 8		// acc = fn(fn_arg, t)
+};
+
+// evaluates a stateless predicate over the auxiliary state of thread tid
+typedef bool (*AuxPredicateFunction)(void* arg, THREADID tid);
+
+// evaluates a predicate given as a functor over the current thread
+typedef bool (*PredicateFunction)(void* arg, Coroutine* t);
+
+// successors past the end of the program, which give its value
+enum { PREDPC_END_TRUE = -1, PREDPC_END_FALSE = -2, PREDPC_UNLINKED = -3 };
+
+struct PredicateInstr {
+	PredicateOpcode op;
+	int offset;
+	int next_true;	// next instruction if acc is true, set by PredicateProgram::Link
+	int next_false;	// next instruction if acc is false
+	TransitionPredicate* pred;
+	AuxPredicateFunction aux_fn;
+	void* aux_arg;
+	PredicateFunction fn;
+	void* fn_arg;
+	ThreadVar* tvar1;
+	ThreadVar* tvar2;
+
+	explicit PredicateInstr(PredicateOpcode _op)
+	: op(_op), offset(0), next_true(PREDPC_UNLINKED), next_false(PREDPC_UNLINKED), pred(NULL), aux_fn(NULL), aux_arg(NULL), fn(NULL), fn_arg(NULL), tvar1(NULL), tvar2(NULL) {}
+};
+
+class AdaptiveNAry;
+
+class PredicateProgram {
+public:
+	static const int CalibrationSamples = 64;
+
+	PredicateProgram() : value_(true), dependencies_(AUXDEP_NONE), pure_(true), root_(NULL), tree_(NULL), epoch_(0), entry_(PREDPC_UNLINKED) {
+		calibration_.left = 0;
+	}
+	~PredicateProgram() {}
+
+	// the program refers to the nodes of pred, so pred must outlive it
+	void Compile(const TransitionPredicatePtr& pred);
+
+	// a lone call, or a program that is not faster than the tree, is evaluated by walking the tree.
+	// the common path only reads the sample clock, a per-program countdown costs as much as the loop saves
+	inline bool Eval(Coroutine* t) {
+		if(tree_ != NULL) {
+			return tree_->EvalState(t);
+		}
+		if(epoch_ == sample_epoch_) {
+			return RunLoop(t);
+		}
+		return EvalCode(t);
+	}
+
+	// called once per evaluated transition, advances the sample clock about every Config::AdaptiveSampleRate-th call.
+	// each program is calibrated or sampled by its first evaluation in a new epoch
+	static inline void TickSampleClock() {
+		if(--until_tick_ <= 0) {
+			AdvanceSampleClock();
+		}
+	}
+
+	// folds the jumps and negations into the successors of the other instructions, done by Compile
+	void Link();
+
+	// runs code_ as linked, without calibrating or sampling it
+	bool RunLoop(Coroutine* t);
+
+	inline bool is_constant() { return code_.empty(); }
+
+	// the value of the program can change only if one of the variables in dependencies_ changes
+	inline bool DependsOn(unsigned changes) { return AuxDependsOn(dependencies_, changes); }
+
+	//================================================
+	// used by TransitionPredicate::Compile
+
+	void EmitConstant(bool value);
+	void EmitCall(TransitionPredicate* pred);
+	void EmitAux(AuxPredicateFunction fn, void* arg, ThreadVar* tvar, unsigned dependency);
+	void EmitFunction(PredicateFunction fn, void* arg, unsigned dependency = AUXDEP_UNKNOWN);
+	void EmitThreadVarsEqual(ThreadVar* tvar1, ThreadVar* tvar2, bool negate = false);
+	void EmitNot();
+	void EmitNAry(NAryOp op, std::vector<TransitionPredicatePtr>* preds);
+	void EmitNAry(NAryOp op, std::vector<PredicateProgram>* operands);
+
+	std::string ToString();
+
+private:
+	static void AdvanceSampleClock();
+	static uint32_t NextJitter();
+	bool EvalCode(Coroutine* t);
+	bool SampleCode(Coroutine* t);
+	bool Calibrate(Coroutine* t);
+
+	// the first evaluations of a program compiled from root_ time the code or the tree, drawn at random
+	struct Calibration {
+		int left;
+		uint64_t cycles[2]; // by the code, and by the tree
+		unsigned samples[2];
+	};
+
+	// the program is constant value_ if code_ is empty
+	DECL_FIELD(bool, value)
+	DECL_FIELD(std::vector<PredicateInstr>, code)
+	DECL_FIELD(unsigned, dependencies)
+	// no instruction has side effects, so the operands of the program can be evaluated in any order
+	DECL_FIELD(bool, pure)
+	// if not NULL, the program is a pure n-ary predicate whose operands adaptive_ reorders in code_
+	DECL_FIELD(boost::intrusive_ptr<AdaptiveNAry>, adaptive)
+	// the predicate the program was compiled from, NULL for the operands of n-ary programs
+	DECL_FIELD(TransitionPredicate*, root)
+	// if not NULL, the program is evaluated by walking tree_ (which is root_)
+	DECL_FIELD(TransitionPredicate*, tree)
+	Calibration calibration_;
+	// the epoch of the sample clock when the program was last sampled, it is calibrated
+	// or sampled at its next evaluation if the clock moved on
+	unsigned long epoch_;
+	// first instruction that computes a value
+	int entry_;
+
+	// the sample clock, only advanced by the thread evaluating a transition
+	static unsigned long sample_epoch_;
+	static long until_tick_;
+	static uint32_t jitter_;
+};
+
+/********************************************************************************/
+
+// evaluation order of the operands of a pure n-ary predicate, adapted at runtime.
+// once every Config::AdaptiveSampleRate transitions, an evaluation measures the cost and the value of all operands,
+// and after SamplesPerReorder samples the operands are sorted by their cost per decisive value
+// (false for and, true for or), so cheap operands that often decide the result run first.
+// the program is rewritten in the new order, so other evaluations run the flat code as is.
+
+class AdaptiveNAry : public LocalRefCounted<AdaptiveNAry> {
+public:
+	static const int MaxOperands = 16;
+	static const unsigned SamplesPerReorder = 32;
+
+	AdaptiveNAry(NAryOp op, const std::vector<PredicateProgram>& operands);
+	~AdaptiveNAry() {}
+
+	// evaluates all operands if no other thread is sampling, and after SamplesPerReorder samples
+	// rewrites the program in the new order. returns false if the operands were not evaluated
+	bool Sample(Coroutine* t, PredicateProgram* program, bool* value);
+
+	// totals over all predicates, in cycles spent by the sampled evaluations
+	static inline uint64_t sampled_declared_cycles() { return __atomic_load_n(&sampled_declared_cycles_, __ATOMIC_RELAXED); }
+	static inline uint64_t sampled_adaptive_cycles() { return __atomic_load_n(&sampled_adaptive_cycles_, __ATOMIC_RELAXED); }
+	static inline unsigned long num_reorders() { return __atomic_load_n(&num_reorders_, __ATOMIC_RELAXED); }
+
+private:
+	void Reorder(PredicateProgram* program);
+
+	NAryOp op_;
+	std::vector<PredicateProgram> operands_;
+	uint64_t order_; // 4 bits for each position, holding the index of the operand evaluated there
+	bool sampling_; // set by the thread taking the sample
+	unsigned samples_;
+	double cost_[MaxOperands];
+	double decisive_[MaxOperands];
+
+	static uint64_t sampled_declared_cycles_; // cost of the samples if the operands ran in declaration order
+	static uint64_t sampled_adaptive_cycles_; // cost of the samples in the adaptive order
+	static unsigned long num_reorders_;
+
+	DISALLOW_COPY_AND_ASSIGN(AdaptiveNAry)
+};
+
+/********************************************************************************/
+
+// hash-consing of the stateless predicates built by the DSL: the factories look up
+// a predicate by its kind and the identities (or values) of its operands, and build it
+// only once, so DSL loops do not allocate predicates after their first iteration.
+// interned predicates keep their operands alive, so operand addresses are never reused.
+// predicates keyed by values (addresses, keys) or by per-execution thread variables are not
+// reused by later executions, so entries not looked up during an execution are evicted at its end.
+
+enum PredicateKind {
+	PKIND_NOT = 1, PKIND_AND, PKIND_OR,
+	PKIND_AUX0, PKIND_AUX0_VALUE,
+	PKIND_AUX1, PKIND_AUX1_KEY, PKIND_AUX1_KEY_VALUE, PKIND_AUX1_KEY_VAR, PKIND_AUX1_VARS,
+	PKIND_IN_FUNC, PKIND_TVARS_EQ, PKIND_TVARS_NEQ, PKIND_ACCESS_RANGE,
+	PKIND_ANY_THREAD, PKIND_BY, PKIND_NOT_BY, PKIND_PLUS_THREAD, PKIND_MINUS_THREAD
+};
+
+struct PredicateKey {
+	int kind_;
+	uint64_t args_[4];
+
+	explicit PredicateKey(int kind, uint64_t a = 0, uint64_t b = 0, uint64_t c = 0, uint64_t d = 0) : kind_(kind) {
+		args_[0] = a; args_[1] = b; args_[2] = c; args_[3] = d;
+	}
+
+	bool operator < (const PredicateKey& other) const {
+		if(kind_ != other.kind_) return kind_ < other.kind_;
+		for(int i = 0; i < 4; ++i) {
+			if(args_[i] != other.args_[i]) return args_[i] < other.args_[i];
+		}
+		return false;
+	}
+
+	bool operator == (const PredicateKey& other) const {
+		return kind_ == other.kind_ && args_[0] == other.args_[0] && args_[1] == other.args_[1]
+				&& args_[2] == other.args_[2] && args_[3] == other.args_[3];
+	}
+};
+
+#define PKEY_PTR(p)		static_cast<uint64_t>(PTR2ADDRINT((p).get()))
+
+class PredicateTable {
+public:
+	// returns the interned predicate, or NULL
+	static TransitionPredicatePtr Find(const PredicateKey& key);
+
+	// interns pred under key and returns it
+	static TransitionPredicatePtr Insert(const PredicateKey& key, const TransitionPredicatePtr& pred);
+
+	static size_t Size();
+
+	// evicts the entries not found or inserted since the previous call, called at the end of each execution
+	static void EndExecution();
+
+private:
+	struct Entry {
+		TransitionPredicatePtr pred;
+		unsigned long epoch; // execution in which the entry was last used
+	};
+	typedef std::map<PredicateKey, Entry> Table;
+	static Table table_;
+	static unsigned long epoch_;
+	static Mutex mutex_;
 };
 
+/********************************************************************************/
+
+// the predicates a DSL statement interned while building its arguments, in the order it built them.
+// a statement builds the same predicates in each execution, so PredicateTable finds them here by comparing
+// the key of each build with the next entry, without locking or searching the table.
+// the entries keep their predicates, and so the objects their keys point to, alive
+class PredicateBuildCache {
+public:
+	PredicateBuildCache() : next_(0) {}
+	~PredicateBuildCache() {}
+
+	// returns the predicate of the next entry if it has key, otherwise drops the entries from there on
+	inline TransitionPredicatePtr Find(const PredicateKey& key) {
+		if(next_ < entries_.size()) {
+			if(entries_[next_].first == key) {
+				return entries_[next_++].second;
+			}
+			entries_.erase(entries_.begin() + next_, entries_.end());
+		}
+		return TransitionPredicatePtr();
+	}
+
+	// records pred as the next entry
+	inline void Add(const PredicateKey& key, const TransitionPredicatePtr& pred) {
+		entries_.erase(entries_.begin() + next_, entries_.end());
+		entries_.push_back(std::make_pair(key, pred));
+		++next_;
+	}
+
+	// the build cache of the statement the current thread builds predicates for, or NULL
+	static inline PredicateBuildCache* Current() { return current_; }
+
+private:
+	std::vector<std::pair<PredicateKey, TransitionPredicatePtr> > entries_;
+	size_t next_;
+
+	static __thread PredicateBuildCache* current_;
+
+	friend class PredicateBuildScope;
+};
+
+// makes cache the build cache of the current thread while the scope lives, used by the DSL macros as
+// the left operand of a comma, so that the scope spans the evaluation of the statement
+class PredicateBuildScope {
+public:
+	explicit PredicateBuildScope(PredicateBuildCache* cache) : previous_(PredicateBuildCache::current_) {
+		cache->next_ = 0;
+		PredicateBuildCache::current_ = cache;
+	}
+	~PredicateBuildScope() {
+		PredicateBuildCache::current_ = previous_;
+	}
+private:
+	PredicateBuildCache* previous_;
+};
+
+/********************************************************************************/
+
 TransitionPredicatePtr operator ! (const TransitionPredicatePtr& pred);
 TransitionPredicatePtr operator && (const TransitionPredicatePtr& pred1, const TransitionPredicatePtr& pred2);
 TransitionPredicatePtr operator || (const TransitionPredicatePtr& pred1, const TransitionPredicatePtr& pred2);
@@ -91,16 +455,18 @@ TransitionPredicatePtr operator || (const TransitionPredicatePtr& pred1, const T
 
 class TrueTransitionPredicate : public TransitionPredicate {
 public:
-	TrueTransitionPredicate() : TransitionPredicate() {}
+	TrueTransitionPredicate() : TransitionPredicate() { set_interned(true); } // singleton
 	~TrueTransitionPredicate() {}
 	bool EvalState(Coroutine* t = NULL) { return true; }
+	void Compile(PredicateProgram* program) { program->EmitConstant(true); }
 };
 
 class FalseTransitionPredicate : public TransitionPredicate {
 public:
-	FalseTransitionPredicate() : TransitionPredicate() {}
+	FalseTransitionPredicate() : TransitionPredicate() { set_interned(true); } // singleton
 	~FalseTransitionPredicate() {}
 	bool EvalState(Coroutine* t = NULL) { return false; }
+	void Compile(PredicateProgram* program) { program->EmitConstant(false); }
 };
 
 /********************************************************************************/
@@ -111,14 +477,16 @@ public:
 	NotTransitionPredicate(TransitionPredicate* pred) : TransitionPredicate(), pred_(TransitionPredicatePtr(pred)) {}
 	~NotTransitionPredicate() {}
 	bool EvalState(Coroutine* t = NULL) { return !(pred_->EvalState(t)); }
+	void Compile(PredicateProgram* program) {
+		pred_->Compile(program);
+		program->EmitNot();
+	}
 private:
 	DECL_FIELD(TransitionPredicatePtr, pred)
 };
 
 /********************************************************************************/
 
-enum NAryOp { NAryAND = 1, NAryOR = 2 };
-
 template<NAryOp op_>
 class NAryTransitionPredicate : public TransitionPredicate, public std::vector<TransitionPredicatePtr> {
 public:
@@ -141,7 +509,7 @@ public:
 		bool v = (op_ == NAryAND) ? true : false;
 		for(NAryTransitionPredicate<op_>::iterator itr = begin(); itr != end(); ++itr) {
 			// update current
-			TransitionPredicatePtr current = (*itr);
+			const TransitionPredicatePtr& current = (*itr);
 			// update v
 			v = (op_ == NAryAND) ? (v && current->EvalState(t)) : (v || current->EvalState(t));
 			if((op_ == NAryAND && v == false) || (op_ == NAryOR && v == true)) {
@@ -151,11 +519,15 @@ public:
 		return v;
 	}
 
-	boost::shared_ptr<NAryTransitionPredicate<op_>> Clone() {
+	void Compile(PredicateProgram* program) {
+		program->EmitNAry(op_, this);
+	}
+
+	boost::intrusive_ptr<NAryTransitionPredicate<op_>> Clone() {
 		if(empty()) {
-			return boost::shared_ptr<NAryTransitionPredicate<op_>>();
+			return boost::intrusive_ptr<NAryTransitionPredicate<op_>>();
 		}
-		boost::shared_ptr<NAryTransitionPredicate<op_>> p(new NAryTransitionPredicate<op_>());
+		boost::intrusive_ptr<NAryTransitionPredicate<op_>> p(new NAryTransitionPredicate<op_>());
 		for(iterator itr = begin(); itr != end(); ++itr) {
 			p->push_back(*itr);
 		}
@@ -165,8 +537,59 @@ public:
 
 typedef NAryTransitionPredicate<NAryAND> TransitionConstraints;
 typedef NAryTransitionPredicate<NAryAND> TransitionAssertions;
-typedef boost::shared_ptr<TransitionConstraints> TransitionConstraintsPtr;
-typedef boost::shared_ptr<TransitionAssertions> TransitionAssertionsPtr;
+typedef boost::intrusive_ptr<TransitionConstraints> TransitionConstraintsPtr;
+typedef boost::intrusive_ptr<TransitionAssertions> TransitionAssertionsPtr;
+
+/********************************************************************************/
+
+// the installed constraints (or assertions) evaluated as a conjunction.
+// each thread caches the value of each conjunct, and evaluates a conjunct again only when
+// the auxiliary variables it reads change, or, if it refers to thread variables, when the execution tree changes
+
+class TransitionConjunction {
+	// only Update copies and releases the handles, so the count need not be atomic
+	struct Conjuncts : public LocalRefCounted<Conjuncts> {
+		unsigned int version;
+		std::vector<TransitionPredicatePtr> preds; // keeps the nodes the programs refer to alive
+		std::vector<PredicateProgram> programs;
+	};
+	typedef boost::intrusive_ptr<Conjuncts> ConjunctsPtr;
+
+	enum { CONJUNCT_FALSE = 0, CONJUNCT_TRUE = 1, CONJUNCT_UNKNOWN = 2 };
+
+	struct Slot {
+		unsigned int version;		// version of the conjuncts the values belong to
+		unsigned int tree_version;	// version of the execution tree when the values were computed
+		unsigned int changes;		// auxiliary variables changed since then
+		unsigned int last_changes;	// the changes before the values were computed, which were reset since
+		unsigned int size;
+		char* values;
+	};
+
+public:
+	TransitionConjunction() : version_(0), dependencies_(AUXDEP_NONE) {}
+	~TransitionConjunction();
+
+	// recompiles the conjuncts, run after installing or removing one
+	void Update(const TransitionConstraintsPtr& preds);
+
+	// records the auxiliary variables changed by the thread since its last evaluation
+	void AddChanges(THREADID tid, unsigned changes);
+
+	// num_evals is incremented by the number of conjuncts evaluated (not taken from the cache)
+	bool Eval(Coroutine* t, unsigned tree_version, int* num_evals);
+
+	inline unsigned size() {
+		Conjuncts* conjuncts = conjuncts_.get();
+		return conjuncts == NULL ? 0 : conjuncts->programs.size();
+	}
+
+private:
+	ConjunctsPtr conjuncts_;
+	AuxSlotTable<Slot> slots_;
+	unsigned int version_;
+	DECL_FIELD(unsigned, dependencies) // union of the dependencies of the conjuncts
+};
 
 /********************************************************************************/
 /********************************************************************************/
@@ -211,6 +634,10 @@ public:
 		return pred_->EvalState(t);
 	}
 
+	void Compile(PredicateProgram* program) {
+		pred_->Compile(program);
+	}
+
 private:
 	DECL_FIELD(TransitionPredicatePtr, pred)
 };
@@ -245,9 +672,9 @@ private:
 
 // base class for auxiliary variables
 
-class AuxVar {
+class AuxVar : public RefCounted<AuxVar> {
 public:
-	explicit AuxVar(const std::string& name) : name_(name) {}
+	explicit AuxVar(const std::string& name, unsigned dependency = AUXDEP_UNKNOWN) : name_(name), dependency_(dependency) {}
 	virtual ~AuxVar(){
 		if(name_ != "const") {
 			fprintf(stderr, "Deleting non-constant auxiliary variable: %s!\n", name_.c_str());
@@ -258,22 +685,30 @@ public:
 	virtual bool isset(THREADID t = -1) = 0;
 	virtual void clear() = 0;
 
+	// static variables live as long as Concurrit, so predicates over them can be interned
+	virtual bool is_static() { return false; }
+
+	static inline bool IsStatic(AuxVar* var) {
+		return var == NULL || var->is_static();
+	}
+
 private:
 	DECL_FIELD(std::string, name)
-	DECL_FIELD_REF(RWLock, rwlock)
+	DECL_FIELD(unsigned, dependency)
 };
 
-#define RLOCK() ScopeRLock __sm__(&rwlock_)
-#define WLOCK() ScopeWLock __sm__(&rwlock_)
-
 /********************************************************************************/
 
 template<typename T, T undef_value_>
 class AuxVar0 : public AuxVar {
-	typedef std::map<THREADID, T> M;
-	typedef boost::shared_ptr<AuxVar0<T,undef_value_>> AuxVar0Ptr;
+	// value is set for the thread only if epoch is the current epoch of the variable
+	struct Slot {
+		unsigned int epoch;
+		T value;
+	};
+	typedef boost::intrusive_ptr<AuxVar0<T,undef_value_>> AuxVar0Ptr;
 public:
-	explicit AuxVar0(const char* name = "") : AuxVar(name) {}
+	explicit AuxVar0(const char* name = "", unsigned dependency = AUXDEP_UNKNOWN) : AuxVar(name, dependency), epoch_(1) {}
 	virtual ~AuxVar0(){}
 
 	TransitionPredicatePtr TP0(const AuxVar0Ptr& var1, const ThreadVarPtr& tvar);
@@ -288,38 +723,31 @@ public:
 		return get(t) != undef_value_;
 	}
 
+	// unsets the values of all threads
 	virtual void clear() {
-		WLOCK();
-
-		map_.clear();
+		__atomic_store_n(&epoch_, NextAuxEpoch(epoch_), __ATOMIC_RELEASE);
 	}
 
 	//================================================
 	virtual T get(THREADID t = -1) {
-		RLOCK();
-
-		typename M::iterator itr = map_.find(t);
-		if(itr == map_.end()) {
+		Slot* s = slots_.find(t);
+		if(s == NULL || __atomic_load_n(&s->epoch, __ATOMIC_ACQUIRE) != __atomic_load_n(&epoch_, __ATOMIC_ACQUIRE)) {
 			return undef_value_;
 		}
-		T value = itr->second;
-		safe_assert(value != undef_value_);
-		return value;
+		return AuxLoad(&s->value);
 	}
 
+	// a predicate binding a variable sets it for the thread it tests, which may not be
+	// the evaluating thread, so the stores are atomic
 	virtual void set(const T& value, THREADID t = -1) {
-		WLOCK();
-
-		if(value == undef_value_) {
-			typename M::iterator itr = map_.find(t);
-			if(itr != map_.end()) map_.erase(itr);
-		} else {
-			map_[t] = value;
-		}
+		Slot* s = slots_.get(t);
+		AuxStore(&s->value, value);
+		__atomic_store_n(&s->epoch, __atomic_load_n(&epoch_, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
 	}
 
 private:
-	DECL_FIELD(M, map)
+	AuxSlotTable<Slot> slots_;
+	unsigned int epoch_;
 };
 
 /********************************************************************************/
@@ -327,12 +755,14 @@ private:
 template<typename T, T undef_value_>
 class StaticAuxVar0 : public AuxVar0<T, undef_value_> {
 public:
-	explicit StaticAuxVar0(const char* name = "") : AuxVar0<T, undef_value_>(name) {}
+	explicit StaticAuxVar0(const char* name = "", unsigned dependency = AUXDEP_UNKNOWN) : AuxVar0<T, undef_value_>(name, dependency) {}
 	~StaticAuxVar0() {
 		if(Concurrit::IsInitialized()) {
 			safe_fail("StaticAuxVar0 %s should not be deleted while Concurrit is active!", AuxVar::name().c_str());
 		}
 	}
+
+	bool is_static() { return true; }
 };
 
 /********************************************************************************/
@@ -374,10 +804,11 @@ private:
 template<typename T, T undef_value_>
 class AuxVar0Pre : public TransitionPredicate {
 	typedef AuxVar0<T,undef_value_> AuxVar0Type;
-	typedef boost::shared_ptr<AuxVar0Type> AuxVar0Ptr;
+	typedef boost::intrusive_ptr<AuxVar0Type> AuxVar0Ptr;
 	typedef StaticAuxVar0<T,undef_value_> StaticAuxVar0Type;
+	typedef AuxConst0<T,undef_value_> AuxConst0Type;
 public:
-	AuxVar0Pre(const AuxVar0Ptr& var1, const AuxVar0Ptr& var2, const ThreadVarPtr& tvar) : TransitionPredicate(), var1_(var1), var2_(var2), tvar_(tvar) {}
+	AuxVar0Pre(const AuxVar0Ptr& var1, const AuxVar0Ptr& var2, const ThreadVarPtr& tvar) : TransitionPredicate(), var1_(var1), var2_(var2), tvar_(tvar), const_value_(undef_value_) {}
 	~AuxVar0Pre(){}
 
 	static TransitionPredicatePtr create (const AuxVar0Ptr& var1, const AuxVar0Ptr& var2, const ThreadVarPtr& tvar) {
@@ -393,31 +824,53 @@ public:
 		safe_assert(var1_ != NULL);
 		safe_assert(INSTANCEOF(var1_.get(), StaticAuxVar0Type*));
 
-		{ ScopeRLock lock_var1(var1_->rwlock());
-
-			if(var2_ == NULL) {
-				return var1_->isset(tid);
-			} else
-			if(!var2_->isset(tid)) {
-				// if var1 is set for tid, assign this value to var2
-				if(var1_->isset(tid)) {
-					var2_->set(var1_->get(tid), tid);
-					return true;
-				} else {
-					return false;
-				}
-			}
+		if(var2_ == NULL) {
+			return var1_->isset(tid);
+		} else
+		if(!var2_->isset(tid)) {
+			// if var1 is set for tid, assign this value to var2
 			if(var1_->isset(tid)) {
-				return var1_->get(tid) == var2_->get(tid);
+				var2_->set(var1_->get(tid), tid);
+				return true;
+			} else {
+				return false;
 			}
-			return false;
+		}
+		if(var1_->isset(tid)) {
+			return var1_->get(tid) == var2_->get(tid);
+		}
+		return false;
+	}
+
+	// the tests for being set and for being equal to a constant (e.g., ENDS) are stateless
+	void Compile(PredicateProgram* program) {
+		safe_assert(INSTANCEOF(var1_.get(), StaticAuxVar0Type*));
+		if(var2_ == NULL) {
+			program->EmitAux(&AuxVar0Pre<T,undef_value_>::IsSet, static_cast<AuxVar0Type*>(var1_.get()), tvar_.get(), var1_->dependency());
+		} else
+		if(INSTANCEOF(var2_.get(), AuxConst0Type*) && var2_->isset()) {
+			const_value_ = static_cast<AuxConst0Type*>(var2_.get())->value();
+			program->EmitAux(&AuxVar0Pre<T,undef_value_>::IsValue, this, tvar_.get(), var1_->dependency());
+		} else {
+			TransitionPredicate::Compile(program);
 		}
 	}
 
+	static bool IsSet(void* var, THREADID tid) {
+		return static_cast<AuxVar0Type*>(var)->AuxVar0Type::get(tid) != undef_value_;
+	}
+
+	static bool IsValue(void* pred, THREADID tid) {
+		AuxVar0Pre<T,undef_value_>* p = static_cast<AuxVar0Pre<T,undef_value_>*>(pred);
+		return p->var1_->AuxVar0Type::get(tid) == p->const_value_;
+	}
+
 private:
 	DECL_FIELD(AuxVar0Ptr, var1)
 	DECL_FIELD(AuxVar0Ptr, var2)
 	DECL_FIELD(ThreadVarPtr, tvar)
+	// value of the constant var2_, copied by Compile
+	T const_value_;
 };
 
 template<typename T, T undef_value_>
@@ -427,13 +880,27 @@ TransitionPredicatePtr AuxVar0<T,undef_value_>::TP0(const AuxVar0Ptr& var1, cons
 
 template<typename T, T undef_value_>
 TransitionPredicatePtr AuxVar0<T,undef_value_>::TP1(const AuxVar0Ptr& var1, const T& value, const ThreadVarPtr& tvar) {
-	AuxVar0Ptr p(new AuxConst0<T,undef_value_>(value));
-	return this->TP2(var1, p, tvar);
+	PredicateKey key(PKIND_AUX0_VALUE, PKEY_PTR(var1), static_cast<uint64_t>(value), PKEY_PTR(tvar));
+	TransitionPredicatePtr p = PredicateTable::Find(key);
+	if(p == NULL) {
+		AuxVar0Ptr q(new AuxConst0<T,undef_value_>(value));
+		p = PredicateTable::Insert(key, AuxVar0Pre<T,undef_value_>::create(var1, q, tvar));
+	}
+	return p;
 }
 
 template<typename T, T undef_value_>
 TransitionPredicatePtr AuxVar0<T,undef_value_>::TP2(const AuxVar0Ptr& var1, const AuxVar0Ptr& var2, const ThreadVarPtr& tvar) {
-	return AuxVar0Pre<T,undef_value_>::create(var1, var2, tvar);
+	if(!AuxVar::IsStatic(var1.get()) || !AuxVar::IsStatic(var2.get())) {
+		// binds a value into a local variable
+		return AuxVar0Pre<T,undef_value_>::create(var1, var2, tvar);
+	}
+	PredicateKey key(PKIND_AUX0, PKEY_PTR(var1), PKEY_PTR(var2), PKEY_PTR(tvar));
+	TransitionPredicatePtr p = PredicateTable::Find(key);
+	if(p == NULL) {
+		p = PredicateTable::Insert(key, AuxVar0Pre<T,undef_value_>::create(var1, var2, tvar));
+	}
+	return p;
 }
 
 /********************************************************************************/
@@ -441,22 +908,42 @@ TransitionPredicatePtr AuxVar0<T,undef_value_>::TP2(const AuxVar0Ptr& var1, cons
 template<typename K, typename T, K undef_key_, T undef_value_>
 class AuxVar1 : public AuxVar {
 protected:
-	typedef std::map<K, T> MM;
-	typedef std::map<THREADID, MM> M;
+	typedef AuxHashEntry<K,T> Entry;
+	typedef AuxHashTable<K,T> Table;
+	// the keys of the thread are valid only if clear_epoch is the current epoch of the variable,
+	// and the entries of table are valid only if their epoch is epoch.
+	// only the owning thread writes the slot, the fields other threads read are accessed atomically
+	struct Slot {
+		unsigned int clear_epoch;
+		unsigned int epoch;
+		int size; // number of keys set
+		int used; // number of valid entries, including the ones of unset keys
+		Table* table;
+	};
 	typedef AuxVar1<K,T,undef_key_,undef_value_> AuxVarType;
-	typedef boost::shared_ptr<AuxVarType> AuxVarPtr;
+	typedef boost::intrusive_ptr<AuxVarType> AuxVarPtr;
 	typedef AuxVar0<K,undef_key_> AuxKeyType;
-	typedef boost::shared_ptr<AuxKeyType> AuxKeyPtr;
+	typedef boost::intrusive_ptr<AuxKeyType> AuxKeyPtr;
 	typedef AuxVar0<T,undef_value_> AuxValueType;
-	typedef boost::shared_ptr<AuxValueType> AuxValuePtr;
+	typedef boost::intrusive_ptr<AuxValueType> AuxValuePtr;
 	typedef AuxConst0<K,undef_key_> AuxKeyConstType;
-	typedef boost::shared_ptr<AuxKeyConstType> AuxKeyConstPtr;
+	typedef boost::intrusive_ptr<AuxKeyConstType> AuxKeyConstPtr;
 	typedef AuxConst0<T,undef_value_> AuxValueConstType;
-	typedef boost::shared_ptr<AuxValueConstType> AuxValueConstPtr;
+	typedef boost::intrusive_ptr<AuxValueConstType> AuxValueConstPtr;
 public:
 
-	explicit AuxVar1(const char* name = "") : AuxVar(name) {}
-	virtual ~AuxVar1(){}
+	explicit AuxVar1(const char* name = "", unsigned dependency = AUXDEP_UNKNOWN) : AuxVar(name, dependency), epoch_(1) {}
+	virtual ~AuxVar1(){
+		for(int i = 0; i < AuxSlotTable<Slot>::MaxSlots; ++i) {
+			Slot* s = slots_.at(i);
+			if(s == NULL) {
+				i += AuxSlotTable<Slot>::ChunkSize - 1;
+				continue;
+			}
+			if(s->table != NULL) delete s->table;
+		}
+		free_retired();
+	}
 
 	TransitionPredicatePtr TP0(const AuxVarPtr& var, const ThreadVarPtr& tvar);
 	TransitionPredicatePtr TP1(const AuxVarPtr& var, const K& key, const ThreadVarPtr& tvar);
@@ -469,114 +956,210 @@ public:
 
 	// get first key
 	K get_first_key(THREADID t = -1) {
-		RLOCK();
-
-		typename M::iterator itr = map_.find(t);
-		if(itr != map_.end()) {
-			if(itr->second.empty()) {
-				return undef_key_;
-			}
-			K key = itr->second.begin()->first;
-			safe_assert(key != undef_key_);
-			return key;
-		}
-		unreachable(); // call isset(t) first!
-		return undef_key_;
+		Entry* e = first_entry(t);
+		return e == NULL ? undef_key_ : AuxLoad(&e->key);
 	}
 
 	// get first value
 	T get_first_value(THREADID t = -1) {
-		RLOCK();
-
-		typename M::iterator itr = map_.find(t);
-		if(itr != map_.end()) {
-			if(itr->second.empty()) {
-				return undef_key_;
-			}
-			T value = itr->second.begin()->second;
-			safe_assert(value != undef_value_);
-			return value;
-		}
-		unreachable(); // call isset(t) first!
-		return undef_value_;
+		Entry* e = first_entry(t);
+		return e == NULL ? undef_value_ : AuxLoad(&e->value);
 	}
 
 	T get(const K& key, THREADID t = -1) {
-		RLOCK();
-
 		safe_assert(key != undef_key_);
-		typename M::iterator itr = map_.find(t);
-		if(itr == map_.end()) {
+		Slot* s = live_slot(t);
+		if(s == NULL) {
 			return undef_value_;
 		}
-		typename MM::iterator itr2 = itr->second.find(key);
-		if(itr2 == itr->second.end()) {
-			return undef_value_;
-		}
-		T value = itr2->second;
-		safe_assert(value != undef_value_);
-		return value;
+		Entry* e = find_entry(s, key);
+		return e == NULL ? undef_value_ : AuxLoad(&e->value);
 	}
 
+	// only the thread t sets its own keys
 	void set(const K& key, const T& value, THREADID t = -1) {
-		WLOCK();
-
 		safe_assert(key != undef_key_);
-		typename M::iterator itr = map_.find(t);
-		if(itr == map_.end()) {
-			map_[t] = MM();
+		Slot* s = own_slot(t);
+		if(s->table == NULL || (s->used + 1) * 4 > s->table->capacity_ * 3) {
+			grow(s);
 		}
 
-		MM& mm = map_[t];
-		if(value == undef_value_) {
-			typename MM::iterator itr2 = mm.find(key);
-			if(itr2 != mm.end()) mm.erase(itr2);
+		Entry* e = s->table->probe(key, s->epoch);
+		safe_assert(e != NULL);
+		if(e->epoch != s->epoch) {
+			// a new key
+			if(value == undef_value_) return;
+			AuxStore(&e->key, key);
+			AuxStore(&e->value, value);
+			__atomic_store_n(&e->epoch, s->epoch, __ATOMIC_RELEASE);
+			s->table->on_taken(e);
+			++s->used;
+			__atomic_store_n(&s->size, s->size + 1, __ATOMIC_RELEASE);
 		} else {
-			mm[key] = value;
+			if(e->value == undef_value_ && value != undef_value_) __atomic_store_n(&s->size, s->size + 1, __ATOMIC_RELEASE);
+			if(e->value != undef_value_ && value == undef_value_) __atomic_store_n(&s->size, s->size - 1, __ATOMIC_RELEASE);
+			AuxStore(&e->value, value);
 		}
 	}
 
 	bool isset(const K& key, THREADID t = -1) {
-		RLOCK();
+		return get(key, t) != undef_value_;
+	}
 
-		safe_assert(key != undef_key_);
-		typename M::iterator itr = map_.find(t);
-		if(itr == map_.end()) {
-			return false;
+	bool isset(THREADID t = -1) {
+		Slot* s = live_slot(t);
+		return s != NULL && __atomic_load_n(&s->size, __ATOMIC_ACQUIRE) > 0;
+	}
+
+	// true if f(key, value) holds for a key set for the thread t
+	template<typename F>
+	bool any_entry(const F& f, THREADID t = -1) {
+		Slot* s = live_slot(t);
+		if(s == NULL) return false;
+		Table* table = __atomic_load_n(&s->table, __ATOMIC_ACQUIRE);
+		if(table == NULL) return false;
+		const unsigned int epoch = slot_epoch(s);
+		const int n = table->num_taken();
+		for(int i = 0; i < n; ++i) {
+			Entry* e = table->taken(i);
+			if(__atomic_load_n(&e->epoch, __ATOMIC_ACQUIRE) != epoch) continue;
+			const T value = AuxLoad(&e->value);
+			if(value != undef_value_ && f(AuxLoad(&e->key), value)) {
+				return true;
+			}
 		}
-		typename MM::iterator itr2 = itr->second.find(key);
+		return false;
+	}
 
-		bool ret = itr2 != itr->second.end();
-		safe_assert(!ret || (itr2->second != undef_value_));
-		return ret;
+	// unsets all keys of the thread t by moving its slot to the next epoch
+	void reset(THREADID t = -1) {
+		Slot* s = live_slot(t);
+		if(s != NULL) {
+			next_epoch(s);
+		}
 	}
 
-	bool isset(THREADID t = -1) {
-		RLOCK();
+	// unsets all keys of all threads; the threads move their slots to the next epoch on their next set
+	void clear() {
+		__atomic_store_n(&epoch_, NextAuxEpoch(epoch_), __ATOMIC_RELEASE);
+		free_retired();
+	}
 
-		typename M::iterator itr = map_.find(t);
-		if(itr == map_.end()) {
-			return false;
+private:
+
+	inline unsigned int slot_epoch(Slot* s) {
+		return __atomic_load_n(&s->epoch, __ATOMIC_ACQUIRE);
+	}
+
+	inline Slot* live_slot(THREADID t) {
+		Slot* s = slots_.find(t);
+		if(s == NULL || __atomic_load_n(&s->clear_epoch, __ATOMIC_ACQUIRE) != __atomic_load_n(&epoch_, __ATOMIC_ACQUIRE)) {
+			return NULL;
 		}
-		return !itr->second.empty();
+		return s;
 	}
 
-	void reset(THREADID t = -1) {
-		WLOCK();
+	inline Slot* own_slot(THREADID t) {
+		Slot* s = slots_.get(t);
+		const unsigned int epoch = __atomic_load_n(&epoch_, __ATOMIC_ACQUIRE);
+		if(s->clear_epoch != epoch) {
+			next_epoch(s);
+			__atomic_store_n(&s->clear_epoch, epoch, __ATOMIC_RELEASE);
+		}
+		return s;
+	}
 
-		typename M::iterator itr = map_.find(t);
-		if(itr != map_.end()) {
-			itr->second.clear();
+	inline Entry* find_entry(Slot* s, const K& key) {
+		Table* table = __atomic_load_n(&s->table, __ATOMIC_ACQUIRE);
+		if(table == NULL) return NULL;
+		const unsigned int epoch = slot_epoch(s);
+		Entry* e = table->probe(key, epoch);
+		if(e == NULL || __atomic_load_n(&e->epoch, __ATOMIC_ACQUIRE) != epoch || AuxLoad(&e->value) == undef_value_) {
+			return NULL;
 		}
+		return e;
 	}
 
-	void clear() {
-		WLOCK();
+	// the entry with the smallest key, as in the first entry of an ordered map
+	Entry* first_entry(THREADID t) {
+		Slot* s = live_slot(t);
+		if(s == NULL) {
+			unreachable(); // call isset(t) first!
+			return NULL;
+		}
+		Table* table = __atomic_load_n(&s->table, __ATOMIC_ACQUIRE);
+		if(table == NULL) return NULL;
+		const unsigned int epoch = slot_epoch(s);
+		Entry* first = NULL;
+		const int n = table->num_taken();
+		for(int i = 0; i < n; ++i) {
+			Entry* e = table->taken(i);
+			if(__atomic_load_n(&e->epoch, __ATOMIC_ACQUIRE) == epoch && AuxLoad(&e->value) != undef_value_
+					&& (first == NULL || AuxLoad(&e->key) < AuxLoad(&first->key))) {
+				first = e;
+			}
+		}
+		return first;
+	}
 
-		map_.clear();
+	// called only by the owning thread (reset by FinishControlledTransition, or its next set after a clear)
+	void next_epoch(Slot* s) {
+		const unsigned int epoch = NextAuxEpoch(s->epoch);
+		if(s->table != NULL) {
+			s->table->clear_taken();
+			if(epoch == 1) {
+				// wrapped around, so old entries may look current
+				memset(s->table->entries_, 0, s->table->capacity_ * sizeof(Entry));
+			}
+		}
+		__atomic_store_n(&s->size, 0, __ATOMIC_RELAXED);
+		s->used = 0;
+		__atomic_store_n(&s->epoch, epoch, __ATOMIC_RELEASE);
 	}
-private:
-	DECL_FIELD(M, map)
+
+	// rehashes the set keys into a new table, doubling its capacity if more than half is set.
+	// the old table may still be read by other threads, so it is freed on the next clear
+	void grow(Slot* s) {
+		Table* old_table = s->table;
+		int capacity = Table::InitialCapacity;
+		if(old_table != NULL) {
+			capacity = old_table->capacity_;
+			if(s->size * 2 >= capacity) capacity *= 2;
+		}
+
+		Table* table = new Table(capacity);
+		s->used = 0;
+		if(old_table != NULL) {
+			const int n = old_table->num_taken();
+			for(int i = 0; i < n; ++i) {
+				Entry* e = old_table->taken(i);
+				if(e->epoch == s->epoch && e->value != undef_value_) {
+					Entry* f = table->probe(e->key, s->epoch);
+					safe_assert(f != NULL && f->epoch != s->epoch);
+					*f = *e;
+					table->on_taken(f);
+					++s->used;
+				}
+			}
+			safe_assert(s->used == s->size);
+			ScopeMutex m(&retired_mutex_);
+			retired_.push_back(old_table);
+		}
+		__atomic_store_n(&s->table, table, __ATOMIC_RELEASE);
+	}
+
+	void free_retired() {
+		ScopeMutex m(&retired_mutex_);
+		for(typename std::vector<Table*>::iterator itr = retired_.begin(); itr != retired_.end(); ++itr) {
+			delete (*itr);
+		}
+		retired_.clear();
+	}
+
+	AuxSlotTable<Slot> slots_;
+	unsigned int epoch_;
+	std::vector<Table*> retired_;
+	Mutex retired_mutex_;
 };
 
 /********************************************************************************/
@@ -584,12 +1167,14 @@ private:
 template<typename K, typename T, K undef_key_, T undef_value_>
 class StaticAuxVar1 : public AuxVar1<K, T, undef_key_, undef_value_> {
 public:
-	explicit StaticAuxVar1(const char* name = "") : AuxVar1<K, T, undef_key_, undef_value_>(name) {}
+	explicit StaticAuxVar1(const char* name = "", unsigned dependency = AUXDEP_UNKNOWN) : AuxVar1<K, T, undef_key_, undef_value_>(name, dependency) {}
 	~StaticAuxVar1() {
 		if(Concurrit::IsInitialized()) {
 			safe_fail("StaticAuxVar1 %s should not be deleted while Concurrit is active!", AuxVar::name().c_str());
 		}
 	}
+
+	bool is_static() { return true; }
 };
 
 /********************************************************************************/
@@ -598,18 +1183,18 @@ template<typename K, typename T,  K undef_key_, T undef_value_>
 class AuxVar1Pre : public TransitionPredicate {
 	typedef AuxVar1<K,T,undef_key_,undef_value_> AuxVarType;
 	typedef StaticAuxVar1<K,T,undef_key_,undef_value_> StaticAuxVarType;
-	typedef boost::shared_ptr<AuxVarType> AuxVarPtr;
+	typedef boost::intrusive_ptr<AuxVarType> AuxVarPtr;
 	typedef AuxVar0<K,undef_key_> AuxKeyType;
-	typedef boost::shared_ptr<AuxKeyType> AuxKeyPtr;
+	typedef boost::intrusive_ptr<AuxKeyType> AuxKeyPtr;
 	typedef AuxVar0<T,undef_value_> AuxValueType;
-	typedef boost::shared_ptr<AuxValueType> AuxValuePtr;
+	typedef boost::intrusive_ptr<AuxValueType> AuxValuePtr;
 	typedef AuxConst0<K,undef_key_> AuxKeyConstType;
-	typedef boost::shared_ptr<AuxKeyConstType> AuxKeyConstPtr;
+	typedef boost::intrusive_ptr<AuxKeyConstType> AuxKeyConstPtr;
 	typedef AuxConst0<T,undef_value_> AuxValueConstType;
-	typedef boost::shared_ptr<AuxValueConstType> AuxValueConstPtr;
+	typedef boost::intrusive_ptr<AuxValueConstType> AuxValueConstPtr;
 public:
 	AuxVar1Pre(const AuxVarPtr& var, const AuxKeyPtr& key, const AuxValuePtr& value, const ThreadVarPtr& tvar)
-	: TransitionPredicate(), var_(var), key_(key), value_(value), tvar_(tvar) {}
+	: TransitionPredicate(), var_(var), key_(key), value_(value), tvar_(tvar), const_key_(undef_key_), const_value_(undef_value_) {}
 	~AuxVar1Pre(){}
 
 	static TransitionPredicatePtr create (const AuxVarPtr& var, const AuxKeyPtr& key, const AuxValuePtr& value, const ThreadVarPtr& tvar) {
@@ -625,62 +1210,110 @@ public:
 		safe_assert(var_ != NULL);
 		safe_assert(INSTANCEOF(var_.get(), StaticAuxVarType*));
 
-		{ ScopeRLock lock_var(var_->rwlock());
-
-			if(key_ == NULL) {
-				safe_assert(value_ == NULL);
-				return var_->isset(tid);
-			} else if(value_ == NULL) {
-				if(!key_->isset(tid)) {
-					// if var is set for tid, assign this value to key
-					if(var_->isset(tid)) {
-						// set first key
-						key_->set(var_->get_first_key(tid), tid);
-						return true;
-					} else {
-						return false;
-					}
-				}
-				return var_->isset(key_->get(tid), tid);
-			} else {
-				safe_assert(key_->isset(tid));
-				if(!value_->isset(tid)) {
-					// if var is set for tid, assign this value to value
-					if(var_->isset(key_->get(tid), tid)) {
-						// set first value
-						value_->set(var_->get(key_->get(tid), tid), tid);
-						return true;
-					} else {
-						return false;
-					}
+		if(key_ == NULL) {
+			safe_assert(value_ == NULL);
+			return var_->isset(tid);
+		} else if(value_ == NULL) {
+			if(!key_->isset(tid)) {
+				// if var is set for tid, assign this value to key
+				if(var_->isset(tid)) {
+					// set first key
+					key_->set(var_->get_first_key(tid), tid);
+					return true;
+				} else {
+					return false;
 				}
+			}
+			return var_->isset(key_->get(tid), tid);
+		} else {
+			safe_assert(key_->isset(tid));
+			if(!value_->isset(tid)) {
+				// if var is set for tid, assign this value to value
 				if(var_->isset(key_->get(tid), tid)) {
-					return var_->get(key_->get(tid), tid) == value_->get(tid);
+					// set first value
+					value_->set(var_->get(key_->get(tid), tid), tid);
+					return true;
 				} else {
 					return false;
 				}
 			}
+			if(var_->isset(key_->get(tid), tid)) {
+				return var_->get(key_->get(tid), tid) == value_->get(tid);
+			} else {
+				return false;
+			}
 		}
 	}
 
+	// the tests for being set, and for constant keys and values (e.g., READS(x)) are stateless
+	void Compile(PredicateProgram* program) {
+		safe_assert(INSTANCEOF(var_.get(), StaticAuxVarType*));
+		if(key_ == NULL) {
+			safe_assert(value_ == NULL);
+			program->EmitAux(&AuxVar1Pre<K,T,undef_key_,undef_value_>::IsSet, static_cast<AuxVarType*>(var_.get()), tvar_.get(), var_->dependency());
+		} else
+		if(INSTANCEOF(key_.get(), AuxKeyConstType*) && key_->isset()) {
+			const_key_ = static_cast<AuxKeyConstType*>(key_.get())->value();
+			if(value_ == NULL) {
+				program->EmitAux(&AuxVar1Pre<K,T,undef_key_,undef_value_>::IsKeySet, this, tvar_.get(), var_->dependency());
+			} else
+			if(INSTANCEOF(value_.get(), AuxValueConstType*) && value_->isset()) {
+				const_value_ = static_cast<AuxValueConstType*>(value_.get())->value();
+				program->EmitAux(&AuxVar1Pre<K,T,undef_key_,undef_value_>::IsKeyValue, this, tvar_.get(), var_->dependency());
+			} else {
+				TransitionPredicate::Compile(program);
+			}
+		} else {
+			TransitionPredicate::Compile(program);
+		}
+	}
+
+	static bool IsSet(void* var, THREADID tid) {
+		return static_cast<AuxVarType*>(var)->AuxVarType::isset(tid);
+	}
+
+	static bool IsKeySet(void* pred, THREADID tid) {
+		AuxVar1Pre<K,T,undef_key_,undef_value_>* p = static_cast<AuxVar1Pre<K,T,undef_key_,undef_value_>*>(pred);
+		return p->var_->AuxVarType::isset(p->const_key_, tid);
+	}
+
+	static bool IsKeyValue(void* pred, THREADID tid) {
+		AuxVar1Pre<K,T,undef_key_,undef_value_>* p = static_cast<AuxVar1Pre<K,T,undef_key_,undef_value_>*>(pred);
+		AuxVarType* var = p->var_.get();
+		return var->AuxVarType::isset(p->const_key_, tid) && var->AuxVarType::get(p->const_key_, tid) == p->const_value_;
+	}
+
 private:
 	DECL_FIELD(AuxVarPtr, var)
 	DECL_FIELD(AuxKeyPtr, key)
 	DECL_FIELD(AuxValuePtr, value)
 	DECL_FIELD(ThreadVarPtr, tvar)
+	// values of the constant key_ and value_, copied by Compile
+	K const_key_;
+	T const_value_;
 };
 
 /********************************************************************************/
 
 template<typename K, typename T, K undef_key_, T undef_value_>
 TransitionPredicatePtr AuxVar1<K,T,undef_key_,undef_value_>::TP0(const AuxVarPtr& var, const ThreadVarPtr& tvar) {
-	return this->TP4(var, AuxKeyConstPtr(), AuxValueConstPtr(), tvar);
+	PredicateKey pkey(PKIND_AUX1, PKEY_PTR(var), PKEY_PTR(tvar));
+	TransitionPredicatePtr p = PredicateTable::Find(pkey);
+	if(p == NULL) {
+		p = PredicateTable::Insert(pkey, AuxVar1Pre<K,T,undef_key_,undef_value_>::create(var, AuxKeyConstPtr(), AuxValueConstPtr(), tvar));
+	}
+	return p;
 }
 
 template<typename K, typename T, K undef_key_, T undef_value_>
 TransitionPredicatePtr AuxVar1<K,T,undef_key_,undef_value_>::TP1(const AuxVarPtr& var, const K& key, const ThreadVarPtr& tvar) {
-	AuxKeyConstPtr p(new AuxKeyConstType(key));
-	return this->TP4(var, p, AuxValueConstPtr(), tvar);
+	PredicateKey pkey(PKIND_AUX1_KEY, PKEY_PTR(var), static_cast<uint64_t>(key), PKEY_PTR(tvar));
+	TransitionPredicatePtr p = PredicateTable::Find(pkey);
+	if(p == NULL) {
+		AuxKeyConstPtr k(new AuxKeyConstType(key));
+		p = PredicateTable::Insert(pkey, AuxVar1Pre<K,T,undef_key_,undef_value_>::create(var, k, AuxValueConstPtr(), tvar));
+	}
+	return p;
 }
 
 template<typename K, typename T, K undef_key_, T undef_value_>
@@ -690,24 +1323,98 @@ TransitionPredicatePtr AuxVar1<K,T,undef_key_,undef_value_>::TP2(const AuxVarPtr
 
 template<typename K, typename T, K undef_key_, T undef_value_>
 TransitionPredicatePtr AuxVar1<K,T,undef_key_,undef_value_>::TP3(const AuxVarPtr& var, const K& key, const T& value, const ThreadVarPtr& tvar) {
-	AuxKeyConstPtr p(new AuxKeyConstType(key));
-	AuxValueConstPtr q(new AuxValueConstType(value));
-	return this->TP4(var, p, q, tvar);
+	PredicateKey pkey(PKIND_AUX1_KEY_VALUE, PKEY_PTR(var), static_cast<uint64_t>(key), static_cast<uint64_t>(value), PKEY_PTR(tvar));
+	TransitionPredicatePtr p = PredicateTable::Find(pkey);
+	if(p == NULL) {
+		AuxKeyConstPtr k(new AuxKeyConstType(key));
+		AuxValueConstPtr v(new AuxValueConstType(value));
+		p = PredicateTable::Insert(pkey, AuxVar1Pre<K,T,undef_key_,undef_value_>::create(var, k, v, tvar));
+	}
+	return p;
 }
 
 template<typename K, typename T, K undef_key_, T undef_value_>
 TransitionPredicatePtr AuxVar1<K,T,undef_key_,undef_value_>::TP5(const AuxVarPtr& var, const K& key, const AuxValuePtr& value, const ThreadVarPtr& tvar) {
-	AuxKeyConstPtr p(new AuxKeyConstType(key));
-	return this->TP4(var, p, value, tvar);
+	if(!AuxVar::IsStatic(value.get())) {
+		// binds a value into a local variable
+		AuxKeyConstPtr k(new AuxKeyConstType(key));
+		return AuxVar1Pre<K,T,undef_key_,undef_value_>::create(var, k, value, tvar);
+	}
+	PredicateKey pkey(PKIND_AUX1_KEY_VAR, PKEY_PTR(var), static_cast<uint64_t>(key), PKEY_PTR(value), PKEY_PTR(tvar));
+	TransitionPredicatePtr p = PredicateTable::Find(pkey);
+	if(p == NULL) {
+		AuxKeyConstPtr k(new AuxKeyConstType(key));
+		p = PredicateTable::Insert(pkey, AuxVar1Pre<K,T,undef_key_,undef_value_>::create(var, k, value, tvar));
+	}
+	return p;
 }
 
 template<typename K, typename T, K undef_key_, T undef_value_>
 TransitionPredicatePtr AuxVar1<K,T,undef_key_,undef_value_>::TP4(const AuxVarPtr& var, const AuxKeyPtr& key, const AuxValuePtr& value, const ThreadVarPtr& tvar) {
-	return AuxVar1Pre<K,T,undef_key_,undef_value_>::create(var, key, value, tvar);
+	if(!AuxVar::IsStatic(key.get()) || !AuxVar::IsStatic(value.get())) {
+		// binds a value into a local variable
+		return AuxVar1Pre<K,T,undef_key_,undef_value_>::create(var, key, value, tvar);
+	}
+	PredicateKey pkey(PKIND_AUX1_VARS, PKEY_PTR(var), PKEY_PTR(key), PKEY_PTR(value), PKEY_PTR(tvar));
+	TransitionPredicatePtr p = PredicateTable::Find(pkey);
+	if(p == NULL) {
+		p = PredicateTable::Insert(pkey, AuxVar1Pre<K,T,undef_key_,undef_value_>::create(var, key, value, tvar));
+	}
+	return p;
 }
 
 /********************************************************************************/
 
+// true if the thread accessed a byte of [begin, begin+size), for predicates over whole objects.
+// var is Reads or Writes, whose keys are the accessed addresses and values the sizes of the accesses
+class TPAccessRange : public TransitionPredicate {
+	typedef AuxVar1<ADDRINT, uint32_t, 0, 0> AccessVarType;
+	typedef boost::intrusive_ptr<AccessVarType> AccessVarPtr;
+public:
+	TPAccessRange(const AccessVarPtr& var, ADDRINT begin, size_t size, const ThreadVarPtr& tvar)
+	: TransitionPredicate(), var_(var), begin_(begin), end_(begin + size), tvar_(tvar) {}
+	~TPAccessRange() {}
+
+	static TransitionPredicatePtr create(const AccessVarPtr& var, ADDRINT begin, size_t size, const ThreadVarPtr& tvar) {
+		PredicateKey pkey(PKIND_ACCESS_RANGE, PKEY_PTR(var), static_cast<uint64_t>(begin), static_cast<uint64_t>(size), PKEY_PTR(tvar));
+		TransitionPredicatePtr p = PredicateTable::Find(pkey);
+		if(p == NULL) {
+			p = PredicateTable::Insert(pkey, TransitionPredicatePtr(new TPAccessRange(var, begin, size, tvar)));
+		}
+		return p;
+	}
+
+	bool EvalState(Coroutine* t = NULL) {
+		safe_assert(t != NULL);
+		THREADID tid = tvar_ == NULL ? t->tid() : safe_notnull(tvar_->thread())->tid();
+		return IsSet(this, tid);
+	}
+
+	void Compile(PredicateProgram* program) {
+		program->EmitAux(&TPAccessRange::IsSet, this, tvar_.get(), var_->dependency());
+	}
+
+	static bool IsSet(void* pred, THREADID tid) {
+		TPAccessRange* p = static_cast<TPAccessRange*>(pred);
+		return p->var_->any_entry(Overlaps(p->begin_, p->end_), tid);
+	}
+
+private:
+	struct Overlaps {
+		Overlaps(ADDRINT begin, ADDRINT end) : begin(begin), end(end) {}
+		bool operator()(ADDRINT addr, uint32_t size) const { return addr < end && addr + size > begin; }
+		ADDRINT begin;
+		ADDRINT end;
+	};
+
+	DECL_FIELD(AccessVarPtr, var)
+	DECL_FIELD(ADDRINT, begin)
+	DECL_FIELD(ADDRINT, end)
+	DECL_FIELD(ThreadVarPtr, tvar)
+};
+
+/********************************************************************************/
+
 class AuxState {
 private:
 	AuxState(){}
@@ -721,32 +1428,50 @@ public:
 	static void Clear();
 
 	// auxiliary variables
-	static boost::shared_ptr<AuxVar0<bool, false>> Ends;
+	static boost::intrusive_ptr<AuxVar0<bool, false>> Ends;
+
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, uint32_t, 0, 0>> Reads;
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, uint32_t, 0, 0>> Writes;
 
-	static boost::shared_ptr<AuxVar1<ADDRINT, uint32_t, 0, 0>> Reads;
-	static boost::shared_ptr<AuxVar1<ADDRINT, uint32_t, 0, 0>> Writes;
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> CallsFrom;
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> CallsTo;
 
-	static boost::shared_ptr<AuxVar1<ADDRINT, bool, 0, false>> CallsFrom;
-	static boost::shared_ptr<AuxVar1<ADDRINT, bool, 0, false>> CallsTo;
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> Enters;
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> Returns;
 
-	static boost::shared_ptr<AuxVar1<ADDRINT, bool, 0, false>> Enters;
-	static boost::shared_ptr<AuxVar1<ADDRINT, bool, 0, false>> Returns;
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, int, 0, 0>> InFunc;
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, int, 0, 0>> NumInFunc;
 
-	static boost::shared_ptr<AuxVar1<ADDRINT, int, 0, 0>> InFunc;
-	static boost::shared_ptr<AuxVar1<ADDRINT, int, 0, 0>> NumInFunc;
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> Arg0;
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> Arg1;
 
-	static boost::shared_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> Arg0;
-	static boost::shared_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> Arg1;
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> RetVal;
 
-	static boost::shared_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> RetVal;
+	static boost::intrusive_ptr<AuxVar0<int, -1>> Pc;
+	static boost::intrusive_ptr<AuxVar0<bool, false>> AtPc;
 
-	static boost::shared_ptr<AuxVar0<int, -1>> Pc;
-	static boost::shared_ptr<AuxVar0<bool, false>> AtPc;
+	// keyed by the address of the mutex, condition variable, rwlock, barrier or semaphore
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> Locks;
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> Unlocks;
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> Waits;
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> Signals;
+
+	// keyed by the address an atomic instruction updates, or by FenceKey for fences
+	static boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> Atomics;
+	static const ADDRINT FenceKey = ~ADDRINT(0);
+
+	// set when the thread sleeps on the virtual clock
+	static boost::intrusive_ptr<AuxVar0<bool, false>> Sleeps;
 
 	// current thread variable updated at each transition
 	static ThreadVarPtr Tid;
 };
 
+// TID is bound to the thread a predicate is evaluated for, so a predicate over TID reads the current thread's state
+inline unsigned AuxDependencyOn(unsigned dependency, ThreadVar* tvar) {
+	return (tvar == NULL || tvar == AuxState::Tid.get()) ? dependency : (dependency | AUXDEP_UNKNOWN);
+}
+
 /********************************************************************************/
 
 class TPInFunc : public TransitionPredicate {
@@ -756,6 +1481,10 @@ public:
 
 	bool EvalState(Coroutine* t = NULL);
 
+	void Compile(PredicateProgram* program);
+
+	static bool IsInFunc(void* pred, THREADID tid);
+
 	static TransitionPredicatePtr create(const ADDRINT& addr, const ThreadVarPtr& tvar = ThreadVarPtr());
 
 private:
@@ -779,9 +1508,11 @@ public:
 
 	virtual bool EvalState(Coroutine* t = NULL) = 0;
 
+	// evaluates TID == var (or TID != var if negate) without building the predicate
+	static bool TidEquals(ThreadVar* var, bool negate = false);
 };
 
-typedef boost::shared_ptr<ThreadExpr> ThreadExprPtr;
+typedef boost::intrusive_ptr<ThreadExpr> ThreadExprPtr;
 
 /********************************************************************************/
 
@@ -792,10 +1523,9 @@ public:
 
 	bool EvalState(Coroutine* t = NULL) { return true; }
 
-	static ThreadExprPtr create() {
-		ThreadExprPtr p(new AnyThreadExpr());
-		return p;
-	}
+	void Compile(PredicateProgram* program) { program->EmitConstant(true); }
+
+	static ThreadExprPtr create();
 };
 
 /********************************************************************************/
@@ -806,14 +1536,14 @@ public:
 	~ThreadVarExpr() {}
 
 	bool EvalState(Coroutine* t = NULL) {
-		TransitionPredicatePtr p = (AuxState::Tid == var_);
-		return p->EvalState(t);
+		return TidEquals(var_.get());
 	}
 
-	static ThreadExprPtr create(const ThreadVarPtr& t) {
-		ThreadExprPtr p(new ThreadVarExpr(t));
-		return p;
+	void Compile(PredicateProgram* program) {
+		program->EmitThreadVarsEqual(AuxState::Tid.get(), var_.get());
 	}
+
+	static ThreadExprPtr create(const ThreadVarPtr& t);
 private:
 	DECL_FIELD(ThreadVarPtr, var)
 };
@@ -826,14 +1556,14 @@ public:
 	~NegThreadVarExpr() {}
 
 	bool EvalState(Coroutine* t = NULL) {
-		TransitionPredicatePtr p = (AuxState::Tid != var_);
-		return p->EvalState(t);
+		return TidEquals(var_.get(), true);
 	}
 
-	static ThreadExprPtr create(const ThreadVarPtr& t) {
-		ThreadExprPtr p(new NegThreadVarExpr(t));
-		return p;
+	void Compile(PredicateProgram* program) {
+		program->EmitThreadVarsEqual(AuxState::Tid.get(), var_.get(), true);
 	}
+
+	static ThreadExprPtr create(const ThreadVarPtr& t);
 private:
 	DECL_FIELD(ThreadVarPtr, var)
 };
@@ -850,14 +1580,17 @@ public:
 			return true;
 		}
 
-		TransitionPredicatePtr p = ThreadVarExpr::create(var_);
-		return p->EvalState(t);
+		return TidEquals(var_.get());
 	}
 
-	static ThreadExprPtr create(const ThreadExprPtr& e, const ThreadVarPtr& t) {
-		ThreadExprPtr p(new PlusThreadExpr(e, t));
-		return p;
+	void Compile(PredicateProgram* program) {
+		std::vector<PredicateProgram> operands(2);
+		expr_->Compile(&operands[0]);
+		operands[1].EmitThreadVarsEqual(AuxState::Tid.get(), var_.get());
+		program->EmitNAry(NAryOR, &operands);
 	}
+
+	static ThreadExprPtr create(const ThreadExprPtr& e, const ThreadVarPtr& t);
 private:
 	DECL_FIELD(ThreadExprPtr, expr)
 	DECL_FIELD(ThreadVarPtr, var)
@@ -875,14 +1608,17 @@ public:
 			return false;
 		}
 
-		TransitionPredicatePtr p = NegThreadVarExpr::create(var_);
-		return p->EvalState(t);
+		return TidEquals(var_.get(), true);
 	}
 
-	static ThreadExprPtr create(const ThreadExprPtr& e, const ThreadVarPtr& t) {
-		ThreadExprPtr p(new MinusThreadExpr(e, t));
-		return p;
+	void Compile(PredicateProgram* program) {
+		std::vector<PredicateProgram> operands(2);
+		expr_->Compile(&operands[0]);
+		operands[1].EmitThreadVarsEqual(AuxState::Tid.get(), var_.get(), true);
+		program->EmitNAry(NAryAND, &operands);
 	}
+
+	static ThreadExprPtr create(const ThreadExprPtr& e, const ThreadVarPtr& t);
 private:
 	DECL_FIELD(ThreadExprPtr, expr)
 	DECL_FIELD(ThreadVarPtr, var)
@@ -73,6 +73,15 @@ KNOB<BOOL> KnobInstrumentTopLevel(KNOB_MODE_WRITEONCE, "pintool",
 KNOB<BOOL> KnobTrackFuncCalls(KNOB_MODE_WRITEONCE, "pintool",
     "track_func_calls", "0", "Track function calls.");
 
+KNOB<string> KnobSharedInsFile(KNOB_MODE_WRITEONCE, "pintool", "shared_ins_file",
+		"", "Instrument only the memory accesses of the instructions listed in this file (written by -profile_shared)");
+
+KNOB<BOOL> KnobProfileShared(KNOB_MODE_WRITEONCE, "pintool",
+    "profile_shared", "0", "Record the instructions accessing memory shared by threads to shared_ins_file at exit.");
+
+KNOB<BOOL> KnobRemoveWhenDisabled(KNOB_MODE_WRITEONCE, "pintool",
+    "remove_when_disabled", "0", "Re-jit traces without instrumentation while concurrit disables the tool.");
+
 /* ===================================================================== */
 
 INT32 Usage() {
@@ -108,7 +117,13 @@ std::string CONCURRIT_HOME;
 LOCALVAR concurrit::PinToolOptions OPTIONS = {
 		FALSE, // TrackFuncCalls;
 		FALSE, // InstrTopLevelFuncs
-		FALSE  // InstrAfterMemoryAccess;
+		FALSE, // InstrAfterMemoryAccess;
+		0,     // GuardTable
+		~0U,   // InstrumentedKinds, all until concurrit initializes the tool
+		FALSE, // FilterUnsharedAccesses
+		0,     // WatchTable
+		FALSE, // ResolveSourceLocations
+		TRUE   // InstrumentFences, until concurrit initializes the tool
 };
 
 //LOCALVAR BOOL INST_TOP_LEVEL = FALSE;
@@ -172,8 +187,268 @@ typedef std::vector<ADDRINT> CallStackType;
 
 /* ===================================================================== */
 
-LOCALVAR bool ThreadLocalState_inst_enabled[PIN_MAX_THREADS];
-LOCALVAR CallStackType* ThreadLocalState_call_stack[PIN_MAX_THREADS];
+// per-thread table that allocates its entries in chunks as thread ids are started,
+// so its memory follows the number of threads rather than PIN_MAX_THREADS.
+// chunks are never moved or freed, so a thread reads its own entry without locking.
+template<typename T>
+class ThreadLocalTable {
+public:
+	static const UINT32 ChunkSize = 256;
+
+	ThreadLocalTable() {
+		memset(const_cast<volatile UINT32**>(chunks_), 0, sizeof(chunks_));
+		InitLock(&lock_);
+	}
+
+	// called by the thread itself in ThreadStart, before any other access to its entry
+	VOID Ensure(THREADID tid) {
+		safe_assert(BETWEEN(0, tid, PIN_MAX_THREADS - 1));
+		UINT32 c = tid / ChunkSize;
+		if(chunks_[c] == NULL) {
+			GetLock(&lock_, tid + 1);
+			if(chunks_[c] == NULL) {
+				chunks_[c] = new T[ChunkSize]();
+			}
+			ReleaseLock(&lock_);
+		}
+	}
+
+	INLINE T& operator[](THREADID tid) {
+		safe_assert(chunks_[tid / ChunkSize] != NULL);
+		return chunks_[tid / ChunkSize][tid % ChunkSize];
+	}
+
+private:
+	T* chunks_[(PIN_MAX_THREADS + ChunkSize - 1) / ChunkSize];
+	PIN_LOCK lock_;
+};
+
+LOCALVAR ThreadLocalTable<bool> ThreadLocalState_inst_enabled;
+LOCALVAR ThreadLocalTable<CallStackType*> ThreadLocalState_call_stack;
+
+/* ===================================================================== */
+
+// kinds of events the thread drops without calling concurrit, valid while the epoch of
+// concurrit's guard table (concurrit::PinGuardTable) equals the epoch concurrit returned them with
+struct EventGuard {
+	UINT32 skip_kinds;
+	UINT32 epoch;
+};
+
+LOCALVAR ThreadLocalTable<EventGuard> ThreadLocalState_guard;
+LOCALVAR const concurrit::PinGuardTable* GuardTable = NULL;
+LOCALVAR const concurrit::PinWatchTable* WatchTable = NULL; // addresses whose reads and writes concurrit records
+
+LOCALFUN INLINE
+BOOL IsGuardedOut(THREADID tid, UINT32 kind) {
+	const EventGuard& guard = ThreadLocalState_guard[tid];
+	return (guard.skip_kinds & (1U << kind)) != 0 && GuardTable != NULL && guard.epoch == GuardTable->epoch;
+}
+
+/* ===================================================================== */
+
+// first-owner thread of each memory page, used to drop the accesses to pages that only one thread touched so far.
+// an entry goes from free to owned by the first thread that touches the page, then to shared when another thread
+// touches it, and never back within an execution. so a dropped access cannot interleave with an access of another
+// thread to its page. entries are tagged with the execution epoch, and entries of earlier executions are free,
+// so that each execution (and each replay of a prefix) starts with no owners.
+// chunks of entries are allocated as pages are touched, and are never freed.
+class PageOwnerTable {
+public:
+	static const UINT32 PageBits = 12;
+	static const UINT32 ChunkBits = 18; // pages per chunk, 2^18 entries of 4 bytes
+	static const UINT32 NumChunks = 1U << (48 - PageBits - ChunkBits); // user-space addresses have 48 bits
+	static const UINT32 OwnerMask = 0xFFFF; // an entry is (epoch << 16) | owner
+	static const UINT32 Shared = 0xFFFF;
+	static const THREADID MaxOwnerTid = Shared - 1; // owners are tid + 1, below Shared
+
+	PageOwnerTable() : epoch_(1) {
+		memset(const_cast<volatile UINT32**>(chunks_), 0, sizeof(chunks_));
+	}
+
+	// true if only tid touched the page of addr in this execution, makes tid the owner of the page if it is free
+	INLINE BOOL IsPrivateTo(ADDRINT addr, THREADID tid) {
+		// a thread whose owner id would collide with Shared never owns a page
+		if(tid >= MaxOwnerTid) return FALSE;
+		const ADDRINT page = addr >> PageBits;
+		const ADDRINT c = page >> ChunkBits;
+		if(c >= NumChunks) return FALSE;
+		volatile UINT32* chunk = chunks_[c];
+		if(chunk == NULL) {
+			chunk = NewChunk(c);
+		}
+		volatile UINT32& entry = chunk[page & ((ADDRINT(1) << ChunkBits) - 1)];
+		const UINT32 epoch = static_cast<UINT32>(epoch_) << 16;
+		const UINT32 self = epoch | static_cast<UINT32>(tid + 1);
+		UINT32 e = entry;
+		if((e & ~OwnerMask) != epoch) {
+			// free, or owned in an earlier execution
+			const UINT32 prev = __sync_val_compare_and_swap(&entry, e, self);
+			if(prev == e) return TRUE;
+			e = prev;
+		}
+		if(e == self) return TRUE;
+		if(e != (epoch | Shared)) {
+			entry = epoch | Shared; // only Shared is stored over an owner
+		}
+		return FALSE;
+	}
+
+	// called at the start of each execution, while no thread of the test runs
+	VOID Reset() {
+		if(++epoch_ == 0) {
+			// the epoch wrapped around, so clear the entries of old executions that could match again
+			for(UINT32 c = 0; c < NumChunks; ++c) {
+				if(chunks_[c] != NULL) {
+					memset(const_cast<UINT32*>(chunks_[c]), 0, (ADDRINT(1) << ChunkBits) * sizeof(UINT32));
+				}
+			}
+			epoch_ = 1;
+		}
+	}
+
+private:
+	volatile UINT32* NewChunk(ADDRINT c) {
+		volatile UINT32* chunk = static_cast<volatile UINT32*>(calloc(ADDRINT(1) << ChunkBits, sizeof(UINT32)));
+		safe_assert(chunk != NULL);
+		volatile UINT32* prev = __sync_val_compare_and_swap(&chunks_[c], static_cast<volatile UINT32*>(NULL), chunk);
+		if(prev != NULL) {
+			free(const_cast<UINT32*>(chunk));
+			return prev;
+		}
+		return chunk;
+	}
+
+	volatile UINT16 epoch_; // never 0, which is the epoch of calloc'd entries
+	volatile UINT32* volatile chunks_[NumChunks];
+};
+
+LOCALVAR PageOwnerTable PageOwners;
+
+/* ===================================================================== */
+
+// shared-variable discovery, in two phases over the same file of instructions.
+// phase 1 (-profile_shared 1, in an uncontrolled run) logs each memory access, and records an instruction
+// when its access and the previous access of another thread to the same 8-byte location conflict (at least one writes).
+// locations keep only their last access and last write, so instructions that accessed a location before them are missed.
+// locations live in a fixed-size shadow table hashed by location, where a location evicts the one in its slot,
+// so conflicts over locations that collide between their accesses are missed too.
+// phase 1 does not depend on concurrit enabling the tool, so accesses are profiled while the tool is disabled as well.
+// phase 2 (-shared_ins_file only) instruments the non-atomic memory accesses of the recorded instructions only.
+// instructions are saved as image name and offset, so the list survives address space randomization.
+class SharedInstructions {
+public:
+	static const UINT32 NumStripes = 64;
+	static const UINT32 ShadowBits = 20; // slots of the shadow table, 2^20 entries of 32 bytes
+
+	SharedInstructions() : loaded_(FALSE), shadow_(NULL) {
+		for(UINT32 i = 0; i < NumStripes; ++i) {
+			InitLock(&locks_[i]);
+		}
+	}
+
+	// phase 1
+
+	VOID InitProfile() {
+		shadow_ = static_cast<Location*>(calloc(ADDRINT(1) << ShadowBits, sizeof(Location)));
+		safe_assert(shadow_ != NULL);
+	}
+
+	VOID OnAccess(THREADID tid, ADDRINT ins_addr, ADDRINT addr, BOOL is_write) {
+		const ADDRINT granule = addr >> 3;
+		const UINT32 slot = static_cast<UINT32>((static_cast<UINT64>(granule) * 0x9E3779B97F4A7C15ULL) >> (64 - ShadowBits));
+		const UINT32 stripe = slot % NumStripes;
+		ADDRINT conflicts[2] = { 0, 0 };
+
+		GetLock(&locks_[stripe], tid + 1);
+		Location& loc = shadow_[slot];
+		if(loc.granule != granule) {
+			// evict the location in the slot
+			loc.granule = granule;
+			loc.ins_addr = 0;
+			loc.last_write_ins = 0;
+		}
+		if(loc.ins_addr != 0 && loc.tid != tid && (is_write || loc.last_write_ins != 0)) {
+			conflicts[0] = loc.ins_addr;
+			conflicts[1] = loc.last_write_ins;
+		}
+		loc.tid = tid;
+		loc.ins_addr = ins_addr;
+		if(is_write) loc.last_write_ins = ins_addr;
+		ReleaseLock(&locks_[stripe]);
+
+		if(conflicts[0] != 0) {
+			Record(ins_addr);
+			Record(conflicts[0]);
+			if(conflicts[1] != 0) Record(conflicts[1]);
+		}
+	}
+
+	VOID Save(const std::string& filename) {
+		std::ofstream out(filename.c_str());
+		PIN_LockClient();
+		for(AddrSet::iterator itr = recorded_.begin(); itr != recorded_.end(); ++itr) {
+			IMG img = IMG_FindByAddress(itr->first);
+			if(IMG_Valid(img)) {
+				out << IMG_Name(img) << " " << (itr->first - IMG_LowAddress(img)) << std::endl;
+			}
+		}
+		PIN_UnlockClient();
+		out.close();
+		log_file << "Saved " << recorded_.size() << " shared instructions to " << filename << std::endl;
+	}
+
+	// phase 2
+
+	VOID Load(const std::string& filename) {
+		std::vector<std::string> lines;
+		concurrit::ReadLinesFromFile(filename.c_str(), &lines, false, '#');
+		for(std::vector<std::string>::iterator itr = lines.begin(); itr < lines.end(); ++itr) {
+			size_t sep = itr->rfind(' ');
+			safe_check(sep != std::string::npos);
+			offsets_.insert(std::make_pair(itr->substr(0, sep), static_cast<ADDRINT>(strtoull(itr->c_str() + sep + 1, NULL, 10))));
+		}
+		loaded_ = TRUE;
+		log_file << "Loaded " << offsets_.size() << " shared instructions from " << filename << std::endl;
+	}
+
+	VOID OnImageLoad(IMG img) {
+		const std::string& name = IMG_Name(img);
+		for(OffsetMap::iterator itr = offsets_.lower_bound(name); itr != offsets_.end() && itr->first == name; ++itr) {
+			recorded_.insert(IMG_LowAddress(img) + itr->second, TRUE);
+		}
+	}
+
+	// true if the memory accesses of the instruction are to be instrumented
+	INLINE BOOL IsInstrumented(ADDRINT ins_addr) {
+		return !loaded_ || recorded_.contains(ins_addr);
+	}
+
+private:
+	// zero-initialized by calloc
+	struct Location {
+		ADDRINT granule; // 8-byte location in the slot
+		THREADID tid;
+		ADDRINT ins_addr; // of the last access
+		ADDRINT last_write_ins;
+	};
+	typedef concurrit::ConcurrentMap<ADDRINT, BOOL> AddrSet;
+	typedef std::multimap<std::string, ADDRINT> OffsetMap;
+
+	VOID Record(ADDRINT ins_addr) {
+		if(!recorded_.contains(ins_addr)) {
+			recorded_.insert(ins_addr, TRUE);
+		}
+	}
+
+	PIN_LOCK locks_[NumStripes];
+	AddrSet recorded_; // conflicting instructions in phase 1, allowed instructions in phase 2
+	OffsetMap offsets_;
+	BOOL loaded_;
+	Location* shadow_;
+};
+
+LOCALVAR SharedInstructions SharedIns;
 
 /* ===================================================================== */
 
@@ -220,36 +495,54 @@ public:
 		addrToLoc_.clear();
 	}
 
+	// only the addresses are recorded at instrumentation time, file, function and line are resolved by Resolve
 	PinSourceLocation(RTN rtn, ADDRINT address)
-	: SourceLocation("<unknown>", "<unknown>", -1, -1, "<unknown>")
+	: SourceLocation("", "", -1, -1, ""), resolved_(false)
 	{
 		address_ = address;
+		rtn_address_ = RTN_Valid(rtn) ? RTN_Address(rtn) : ADDRINT(0);
+		img_id_ = RTN_Valid(rtn) ? IMG_Id(SEC_Img(RTN_Sec(rtn))) : 0;
+	}
 
+	// resolves the source location of loc when concurrit is to show it, once per location
+	static inline void Resolve(concurrit::SourceLocation* loc) {
+		if(loc != NULL && !static_cast<PinSourceLocation*>(loc)->resolved_) {
+			static_cast<PinSourceLocation*>(loc)->ResolveLocked();
+		}
+	}
+
+	VOID* pointer() {
+		return reinterpret_cast<VOID*>(address_);
+	}
+
+	private:
+	void ResolveLocked() {
 		PIN_LockClient();
 
-		PIN_GetSourceLocation(address_, &column_, &line_, &filename_);
+		if(!resolved_) {
+			PIN_GetSourceLocation(address_, &column_, &line_, &filename_);
 
-		if(filename_ == "") {
-			filename_ = "<unknown>";
-		}
+			if(filename_ == "") {
+				filename_ = "<unknown>";
+			}
 
-		if (RTN_Valid(rtn)) {
-			IMG img = SEC_Img(RTN_Sec(rtn));
+			IMG img = IMG_FindImgById(img_id_);
 			if(IMG_Valid(img)) {
 				imgname_ = IMG_Name(img);
 			}
-			funcname_ = RTN_Name(rtn);
+			RTN rtn = RTN_FindByAddress(rtn_address_);
+			funcname_ = RTN_Valid(rtn) ? RTN_Name(rtn) : "<unknown>";
+
+			resolved_ = true;
 		}
 
 		PIN_UnlockClient();
 	}
 
-	VOID* pointer() {
-		return reinterpret_cast<VOID*>(address_);
-	}
-
-	private:
 	DECL_FIELD(ADDRINT, address)
+	DECL_FIELD(ADDRINT, rtn_address)
+	DECL_FIELD(UINT32, img_id)
+	volatile bool resolved_;
 
 	static AddrToLocMap addrToLoc_;
 };
@@ -266,10 +559,19 @@ LOCALFUN INLINE
 VOID CallNativePinMonitor(const CONTEXT * ctxt, THREADID tid, concurrit::EventBuffer* info) {
 	if(NativePinMonitorFunPtr != NULL) {
 
+		if(OPTIONS.ResolveSourceLocations) {
+			PinSourceLocation::Resolve(info->loc_src);
+			PinSourceLocation::Resolve(info->loc_target);
+		}
+
 //		reinterpret_cast<NativePinMonitorFunType>(NativePinMonitorFunPtr)(info);
 		PIN_CallApplicationFunction(ctxt, tid,
 			CALLINGSTD_DEFAULT, AFUNPTR(NativePinMonitorFunPtr),
 			PIN_PARG(void), PIN_PARG(concurrit::EventBuffer*), (info), PIN_PARG_END());
+
+		EventGuard& guard = ThreadLocalState_guard[tid];
+		guard.skip_kinds = info->skip_kinds;
+		guard.epoch = info->skip_epoch;
 	}
 }
 
@@ -426,6 +728,7 @@ public:
 		safe_assert(call_stack != NULL);
 		call_stack->clear(); // tls->call_stack()->clear();
 		ThreadLocalState_inst_enabled[threadid] = enable; // tls->set_inst_enabled(enable);
+		ThreadLocalState_guard[threadid].skip_kinds = 0;
 	}
 
 	static RTNNamesToInstrumentType RTNNamesToInstrument;
@@ -446,14 +749,39 @@ volatile bool InstParams::pin_enabled = true;
 
 /* ===================================================================== */
 
+// with KnobRemoveWhenDisabled, traces are jitted clean (without instrumentation) while the tool is disabled,
+// and instrumented while it is enabled. toggling drops the code cache, so each phase re-jits its traces
+LOCALVAR volatile BOOL InstrumentTraces = TRUE;
+LOCALVAR UINT64 NumTraceToggles = 0;
+LOCALVAR double TraceToggleUSecs = 0;
+LOCALVAR UINT64 NumTracesInstrumented = 0;
+
+LOCALFUN
+VOID ToggleTraceInstrumentation(BOOL instrument) {
+	if(!KnobRemoveWhenDisabled.Value() || InstrumentTraces == instrument) return;
+
+	concurrit::Timer toggle_timer;
+	toggle_timer.start();
+	InstrumentTraces = instrument;
+	PIN_RemoveInstrumentation();
+	toggle_timer.stop();
+
+	++NumTraceToggles;
+	TraceToggleUSecs += toggle_timer.getElapsedTimeInMicroSec();
+}
+
+// concurrit enables the tool at the start of each execution, before the threads of the test start
 VOID PIN_FAST_ANALYSIS_CALL
 PinEnable() {
+	PageOwners.Reset();
 	InstParams::pin_enabled = true;
+	ToggleTraceInstrumentation(TRUE);
 }
 
 VOID PIN_FAST_ANALYSIS_CALL
 PinDisable() {
 	InstParams::pin_enabled = false;
+	ToggleTraceInstrumentation(FALSE);
 }
 
 VOID PIN_FAST_ANALYSIS_CALL
@@ -483,11 +811,30 @@ PinToolShutdown() {
 VOID PIN_FAST_ANALYSIS_CALL
 PinToolInit(ADDRINT options_addrint) {
 	concurrit::PinToolOptions* options_ptr = static_cast<concurrit::PinToolOptions*>(concurrit::ADDRINT2PTR(options_addrint));
+	UINT32 instrumented_kinds = OPTIONS.InstrumentedKinds;
+	UINT32 filter_unshared = OPTIONS.FilterUnsharedAccesses;
+	UINT32 instrument_fences = OPTIONS.InstrumentFences;
 	PIN_SafeCopy(&OPTIONS, options_ptr, sizeof(concurrit::PinToolOptions));
 
 	log_file << "[PinToolInit] Pin Option TrackFuncCalls: " << OPTIONS.TrackFuncCalls << std::endl;
 	log_file << "[PinToolInit] Pin Option InstrTopLevelFuncs: " << OPTIONS.InstrTopLevelFuncs << std::endl;
 	log_file << "[PinToolInit] Pin Option InstrAfterMemoryAccess: " << OPTIONS.InstrAfterMemoryAccess << std::endl;
+	log_file << "[PinToolInit] Pin Option InstrumentedKinds: " << OPTIONS.InstrumentedKinds << std::endl;
+	log_file << "[PinToolInit] Pin Option FilterUnsharedAccesses: " << OPTIONS.FilterUnsharedAccesses << std::endl;
+	log_file << "[PinToolInit] Pin Option ResolveSourceLocations: " << OPTIONS.ResolveSourceLocations << std::endl;
+	log_file << "[PinToolInit] Pin Option InstrumentFences: " << OPTIONS.InstrumentFences << std::endl;
+
+	// read in place, concurrit updates it
+	GuardTable = static_cast<const concurrit::PinGuardTable*>(concurrit::ADDRINT2PTR(OPTIONS.GuardTable));
+	WatchTable = static_cast<const concurrit::PinWatchTable*>(concurrit::ADDRINT2PTR(OPTIONS.WatchTable));
+
+	// concurrit calls again when its predicates need other kinds of events,
+	// so drop the code cache to re-jit the code with the instrumentation of the new kinds
+	if(instrumented_kinds != OPTIONS.InstrumentedKinds || filter_unshared != OPTIONS.FilterUnsharedAccesses
+			|| instrument_fences != OPTIONS.InstrumentFences) {
+		log_file << "[PinToolInit] Removing instrumentation" << std::endl;
+		PIN_RemoveInstrumentation();
+	}
 }
 
 /* ===================================================================== */
@@ -509,6 +856,31 @@ If_OnInstruction(THREADID threadid) {
 	return BOOL2ADDRINT(InstParams::OnInstruction(threadid));
 }
 
+// as If_OnInstruction, but false if concurrit does not need events of the kind from the thread
+ADDRINT PIN_FAST_ANALYSIS_CALL
+If_OnEvent(THREADID threadid, UINT32 kind) {
+	return BOOL2ADDRINT(InstParams::OnInstruction(threadid) && !IsGuardedOut(threadid, kind));
+}
+
+// as If_OnEvent, for a memory access to addr (and addr2 for instructions with two memory operands).
+// the access is dropped if the pages it touches were touched only by the thread so far.
+// ownership is recorded before the guard is checked, since a guarded out access still makes its page shared
+ADDRINT PIN_FAST_ANALYSIS_CALL
+If_OnAccess(THREADID threadid, UINT32 kind, ADDRINT addr, ADDRINT addr2) {
+	if(!InstParams::OnInstruction(threadid)) return BOOL2ADDRINT(FALSE);
+	// evaluate both, to record the owners of both pages
+	const BOOL is_private = PageOwners.IsPrivateTo(addr, threadid);
+	const BOOL is_private2 = (addr2 == addr) || PageOwners.IsPrivateTo(addr2, threadid);
+	return BOOL2ADDRINT(!(is_private && is_private2) && !IsGuardedOut(threadid, kind));
+}
+
+/* ===================================================================== */
+
+VOID PIN_FAST_ANALYSIS_CALL
+ProfileAccess(THREADID threadid, ADDRINT ins_addr, ADDRINT addr, BOOL is_write) {
+	SharedIns.OnAccess(threadid, ins_addr, addr, is_write);
+}
+
 /* ===================================================================== */
 
 VOID PIN_FAST_ANALYSIS_CALL
@@ -518,6 +890,7 @@ FuncCall(const CONTEXT * ctxt, THREADID threadid, BOOL direct, PinSourceLocation
 //	if(!InstParams::OnInstruction(threadid)) {
 //		return;
 //	}
+	if(IsGuardedOut(threadid, concurrit::FuncCall)) return;
 	//===============================================================
 
 	PinSourceLocation* loc_target = PinSourceLocation::get(target);
@@ -668,6 +1041,8 @@ MemWrite(const CONTEXT * ctxt, THREADID threadid, VOID * addr, UINT32 size, PinS
 
 //	CaptureAddrSize(threadid, addr, size);
 
+	if(WatchTable != NULL && !WatchTable->IsWatched(concurrit::PTR2ADDRINT(addr), size)) return;
+
 	concurrit::EventBuffer info;
 	info.type = concurrit::MemWrite;
 	info.threadid = threadid;
@@ -688,6 +1063,8 @@ MemRead(const CONTEXT * ctxt, THREADID threadid, VOID * addr, UINT32 size, PinSo
 
 //	CaptureAddrSize(threadid, addr, size);
 
+	if(WatchTable != NULL && !WatchTable->IsWatched(concurrit::PTR2ADDRINT(addr), size)) return;
+
 	concurrit::EventBuffer info;
 	info.type = concurrit::MemRead;
 	info.threadid = threadid;
@@ -700,6 +1077,22 @@ MemRead(const CONTEXT * ctxt, THREADID threadid, VOID * addr, UINT32 size, PinSo
 
 /* ===================================================================== */
 
+// addr is NULL for fences
+VOID PIN_FAST_ANALYSIS_CALL
+AtomicAccess(const CONTEXT * ctxt, THREADID threadid, VOID * addr, UINT32 size, PinSourceLocation* loc) {
+
+	concurrit::EventBuffer info;
+	info.type = concurrit::AtomicAccess;
+	info.threadid = threadid;
+	info.addr = concurrit::PTR2ADDRINT(addr);
+	info.size = size;
+	info.loc_src = loc;
+
+	CallNativePinMonitor(ctxt, threadid, &info);
+}
+
+/* ===================================================================== */
+
 LOCALVAR std::vector<string> FilteredImages;
 typedef concurrit::ConcurrentMap<UINT32,BOOL> FilteredImageIdsType;
 LOCALVAR FilteredImageIdsType FilteredImageIds;
@@ -866,16 +1259,23 @@ BOOL IsRoutineFiltered(RTN rtn, ADDRINT rtn_addr) {
 
 /* ===================================================================== */
 
+LOCALFUN INLINE
+BOOL IsInstrumented(UINT32 kind) {
+	return (OPTIONS.InstrumentedKinds & (1U << kind)) != 0;
+}
+
+/* ===================================================================== */
+
 LOCALFUN INLINE
 VOID CallTrace(INS ins, RTN rtn, ADDRINT rtn_addr) {
 
-	if (OPTIONS.TrackFuncCalls && INS_IsCall(ins) && INS_IsProcedureCall(ins) && !INS_IsSyscall(ins)) {
+	if (OPTIONS.TrackFuncCalls && IsInstrumented(concurrit::FuncCall) && INS_IsCall(ins) && INS_IsProcedureCall(ins) && !INS_IsSyscall(ins)) {
 		if (!INS_IsDirectBranchOrCall(ins)) {
 			// Indirect call
 			PinSourceLocation* loc = PinSourceLocation::get(rtn, INS_Address(ins));
 
-			INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(If_OnInstruction), IARG_FAST_ANALYSIS_CALL,
-							IARG_THREAD_ID, IARG_END);
+			INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(If_OnEvent), IARG_FAST_ANALYSIS_CALL,
+							IARG_THREAD_ID, IARG_UINT32, concurrit::FuncCall, IARG_END);
 
 			INS_InsertThenPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(FuncCall), IARG_FAST_ANALYSIS_CALL,
 					IARG_CONTEXT,
@@ -921,12 +1321,31 @@ VOID CallTrace(INS ins, RTN rtn, ADDRINT rtn_addr) {
 
 /* ===================================================================== */
 
+LOCALFUN INLINE
+BOOL IsFence(INS ins) {
+	OPCODE op = INS_Opcode(ins);
+	return op == XED_ICLASS_MFENCE || op == XED_ICLASS_LFENCE || op == XED_ICLASS_SFENCE;
+}
+
+// lock-prefixed instructions and xchg with a memory operand, which are implicitly locked
+LOCALFUN INLINE
+BOOL IsAtomicUpdate(INS ins) {
+	return INS_IsAtomicUpdate(ins) && (INS_IsMemoryRead(ins) || INS_IsMemoryWrite(ins));
+}
+
+/* ===================================================================== */
+
 LOCALFUN INLINE
 VOID MemoryTrace(INS ins, RTN rtn) {
 	if (INS_IsStackRead(ins) || INS_IsStackWrite(ins)) return;
 
+	// fences are reported only when concurrit schedules them or a predicate depends on them
+	bool is_fence = OPTIONS.InstrumentFences && IsFence(ins);
+	bool is_atomic = is_fence || IsAtomicUpdate(ins);
 	bool is_access = INS_IsMemoryWrite(ins) || INS_HasMemoryRead2(ins) || (INS_IsMemoryRead(ins) && !INS_IsPrefetch(ins));
-	if(!is_access) return;
+	if(!is_access && !is_fence) return;
+	// phase 2 of the shared-variable discovery, atomic instructions and reported fences are always instrumented
+	if(!is_atomic && !SharedIns.IsInstrumented(INS_Address(ins))) return;
 	bool has_fallthrough = false;
 	bool is_branchorcall = false;
 	if(OPTIONS.InstrAfterMemoryAccess) {
@@ -939,9 +1358,14 @@ VOID MemoryTrace(INS ins, RTN rtn) {
 
 	/* ==================== */
 
-	if (INS_IsMemoryWrite(ins)) {
-		INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(If_OnInstruction), IARG_FAST_ANALYSIS_CALL,
-				IARG_THREAD_ID, IARG_END);
+	if (INS_IsMemoryWrite(ins) && IsInstrumented(concurrit::MemWrite)) {
+		if (OPTIONS.FilterUnsharedAccesses) {
+			INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(If_OnAccess), IARG_FAST_ANALYSIS_CALL,
+					IARG_THREAD_ID, IARG_UINT32, concurrit::MemWrite, IARG_MEMORYWRITE_EA, IARG_MEMORYWRITE_EA, IARG_END);
+		} else {
+			INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(If_OnEvent), IARG_FAST_ANALYSIS_CALL,
+					IARG_THREAD_ID, IARG_UINT32, concurrit::MemWrite, IARG_END);
+		}
 
 		INS_InsertThenPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(MemWrite), IARG_FAST_ANALYSIS_CALL,
 				IARG_CONTEXT,
@@ -950,9 +1374,14 @@ VOID MemoryTrace(INS ins, RTN rtn) {
 
 	/* ==================== */
 
-	if (INS_HasMemoryRead2(ins)) {
-		INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(If_OnInstruction), IARG_FAST_ANALYSIS_CALL,
-				IARG_THREAD_ID, IARG_END);
+	if (INS_HasMemoryRead2(ins) && IsInstrumented(concurrit::MemRead)) {
+		if (OPTIONS.FilterUnsharedAccesses) {
+			INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(If_OnAccess), IARG_FAST_ANALYSIS_CALL,
+					IARG_THREAD_ID, IARG_UINT32, concurrit::MemRead, IARG_MEMORYREAD2_EA, IARG_MEMORYREAD2_EA, IARG_END);
+		} else {
+			INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(If_OnEvent), IARG_FAST_ANALYSIS_CALL,
+					IARG_THREAD_ID, IARG_UINT32, concurrit::MemRead, IARG_END);
+		}
 
 		INS_InsertThenPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(MemRead), IARG_FAST_ANALYSIS_CALL,
 				IARG_CONTEXT,
@@ -961,9 +1390,14 @@ VOID MemoryTrace(INS ins, RTN rtn) {
 
 	/* ==================== */
 
-	if (INS_IsMemoryRead(ins) && !INS_IsPrefetch(ins)) {
-		INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(If_OnInstruction), IARG_FAST_ANALYSIS_CALL,
-				IARG_THREAD_ID, IARG_END);
+	if (INS_IsMemoryRead(ins) && !INS_IsPrefetch(ins) && IsInstrumented(concurrit::MemRead)) {
+		if (OPTIONS.FilterUnsharedAccesses) {
+			INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(If_OnAccess), IARG_FAST_ANALYSIS_CALL,
+					IARG_THREAD_ID, IARG_UINT32, concurrit::MemRead, IARG_MEMORYREAD_EA, IARG_MEMORYREAD_EA, IARG_END);
+		} else {
+			INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(If_OnEvent), IARG_FAST_ANALYSIS_CALL,
+					IARG_THREAD_ID, IARG_UINT32, concurrit::MemRead, IARG_END);
+		}
 
 		INS_InsertThenPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(MemRead), IARG_FAST_ANALYSIS_CALL,
 				IARG_CONTEXT,
@@ -972,12 +1406,37 @@ VOID MemoryTrace(INS ins, RTN rtn) {
 
 	/* ======================================== */
 
-	INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(If_OnInstruction), IARG_FAST_ANALYSIS_CALL,
-			IARG_THREAD_ID, IARG_END);
+	// atomic instructions and fences are scheduling points of their own kind
+	const UINT32 kind = is_atomic ? concurrit::AtomicAccess : concurrit::MemAccessBefore;
+	if (IsInstrumented(kind)) {
+		if (OPTIONS.FilterUnsharedAccesses && !is_atomic) {
+			// the first two memory operands, which cover the accesses of all but string and gather instructions
+			const UINT32 op2 = INS_MemoryOperandCount(ins) > 1 ? 1 : 0;
+			INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(If_OnAccess), IARG_FAST_ANALYSIS_CALL,
+					IARG_THREAD_ID, IARG_UINT32, kind, IARG_MEMORYOP_EA, 0, IARG_MEMORYOP_EA, op2, IARG_END);
+		} else {
+			INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(If_OnEvent), IARG_FAST_ANALYSIS_CALL,
+					IARG_THREAD_ID, IARG_UINT32, kind, IARG_END);
+		}
 
-	INS_InsertThenPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(MemAccessBefore), IARG_FAST_ANALYSIS_CALL,
-			IARG_CONTEXT,
-			IARG_THREAD_ID, IARG_PTR, loc, IARG_END);
+		if (is_fence) {
+			INS_InsertThenPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(AtomicAccess), IARG_FAST_ANALYSIS_CALL,
+					IARG_CONTEXT,
+					IARG_THREAD_ID, IARG_PTR, NULL, IARG_UINT32, 0, IARG_PTR, loc, IARG_END);
+		} else if (is_atomic && INS_IsMemoryWrite(ins)) {
+			INS_InsertThenPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(AtomicAccess), IARG_FAST_ANALYSIS_CALL,
+					IARG_CONTEXT,
+					IARG_THREAD_ID, IARG_MEMORYWRITE_EA, IARG_MEMORYWRITE_SIZE, IARG_PTR, loc, IARG_END);
+		} else if (is_atomic) {
+			INS_InsertThenPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(AtomicAccess), IARG_FAST_ANALYSIS_CALL,
+					IARG_CONTEXT,
+					IARG_THREAD_ID, IARG_MEMORYREAD_EA, IARG_MEMORYREAD_SIZE, IARG_PTR, loc, IARG_END);
+		} else {
+			INS_InsertThenPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(MemAccessBefore), IARG_FAST_ANALYSIS_CALL,
+					IARG_CONTEXT,
+					IARG_THREAD_ID, IARG_PTR, loc, IARG_END);
+		}
+	}
 
 	/* ==================== */
 
@@ -1003,10 +1462,38 @@ VOID MemoryTrace(INS ins, RTN rtn) {
 
 /* ===================================================================== */
 
+// phase 1 of the shared-variable discovery
+LOCALFUN INLINE
+VOID ProfileTrace(INS ins) {
+	if (INS_IsStackRead(ins) || INS_IsStackWrite(ins)) return;
+
+	if (INS_IsMemoryWrite(ins)) {
+		INS_InsertPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(ProfileAccess), IARG_FAST_ANALYSIS_CALL,
+				IARG_THREAD_ID, IARG_INST_PTR, IARG_MEMORYWRITE_EA, IARG_BOOL, TRUE, IARG_END);
+	}
+	if (INS_HasMemoryRead2(ins)) {
+		INS_InsertPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(ProfileAccess), IARG_FAST_ANALYSIS_CALL,
+				IARG_THREAD_ID, IARG_INST_PTR, IARG_MEMORYREAD2_EA, IARG_BOOL, FALSE, IARG_END);
+	}
+	if (INS_IsMemoryRead(ins) && !INS_IsPrefetch(ins)) {
+		INS_InsertPredicatedCall(ins, IPOINT_BEFORE, AFUNPTR(ProfileAccess), IARG_FAST_ANALYSIS_CALL,
+				IARG_THREAD_ID, IARG_INST_PTR, IARG_MEMORYREAD_EA, IARG_BOOL, FALSE, IARG_END);
+	}
+}
+
+/* ===================================================================== */
+
 LOCALFUN INLINE
 VOID Instruction(INS ins, RTN rtn, ADDRINT rtn_addr) {
 	if (INS_IsOriginal(ins)) {
 
+		if (KnobProfileShared.Value()) {
+			ProfileTrace(ins);
+		}
+
+		// only profiled while the tool is disabled
+		if (!InstrumentTraces) return;
+
 		MemoryTrace(ins, rtn);
 
 		CallTrace(ins, rtn, rtn_addr);
@@ -1098,6 +1585,8 @@ VOID ImageLoad(IMG img, VOID *) {
 	// also updates filtered image ids
 	if(IsImageFiltered(img)) return;
 
+	SharedIns.OnImageLoad(img);
+
 //	for (SEC sec = IMG_SecHead(img); SEC_Valid(sec); sec = SEC_Next(sec))
 //	{
 //		for (RTN rtn = SEC_RtnHead(sec); RTN_Valid(rtn); rtn = RTN_Next(rtn))
@@ -1139,12 +1628,17 @@ VOID Trace(TRACE trace, VOID *v) {
 
 	if (!filter.SelectTrace(trace)) return;
 
+	// clean trace, the tool is disabled (but still profiled)
+	if (!InstrumentTraces && !KnobProfileShared.Value()) return;
+
 	RTN rtn = TRACE_Rtn(trace);
 	if(!RTN_Valid(rtn)) return;
 
 	ADDRINT rtn_addr = RTN_Address(rtn);
 	if (IsRoutineFiltered(rtn, rtn_addr)) return;
 
+	++NumTracesInstrumented; // instrumentation callbacks are serialized by Pin
+
 	for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl))
 	{
 		for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins))
@@ -1162,6 +1656,16 @@ VOID Fini(INT32 code, VOID *v) {
 
 	log_file << std::endl << "PIN-TIME for program: " << timer.ElapsedTimeToString() << std::endl;
 
+	if(KnobProfileShared.Value() && !KnobSharedInsFile.Value().empty()) {
+		SharedIns.Save(KnobSharedInsFile.Value());
+	}
+
+	log_file << "Instrumented traces: " << NumTracesInstrumented << std::endl;
+	if(NumTraceToggles > 0) {
+		log_file << "Trace instrumentation toggles: " << NumTraceToggles
+				<< ", average latency: " << (TraceToggleUSecs / NumTraceToggles) << " usecs" << std::endl;
+	}
+
 	PIN_DeleteThreadDataKey(tls_key);
 
 	log_file.close();
@@ -1235,9 +1739,12 @@ LOCALFUN VOID ThreadStart(THREADID threadid, CONTEXT *ctxt, INT32 flags,
 //	PIN_SetThreadData(tls_key, new ThreadLocalState(threadid), threadid);
 //	GLB_UNLOCK();
 
-	safe_assert(BETWEEN(0, threadid, PIN_MAX_THREADS));
+	ThreadLocalState_inst_enabled.Ensure(threadid);
+	ThreadLocalState_call_stack.Ensure(threadid);
+	ThreadLocalState_guard.Ensure(threadid);
 	ThreadLocalState_inst_enabled[threadid] = false;
 	ThreadLocalState_call_stack[threadid] = new CallStackType();
+	ThreadLocalState_guard[threadid].skip_kinds = 0;
 }
 
 // This routine is executed every time a thread is destroyed.
@@ -1247,10 +1754,10 @@ LOCALFUN VOID ThreadFini(THREADID threadid, const CONTEXT *ctxt, INT32 code,
 
 	log_file << "Thread "<< threadid << " ending..." << endl;
 
-	safe_assert(BETWEEN(0, threadid, PIN_MAX_THREADS));
 	CallStackType* call_stack = ThreadLocalState_call_stack[threadid];
 	safe_assert(call_stack != NULL);
 	delete call_stack;
+	ThreadLocalState_call_stack[threadid] = NULL;
 }
 
 //LOCALFUN VOID ThreadLocalDestruct(VOID* ptr) {
@@ -1281,6 +1788,12 @@ int main(int argc, CHAR *argv[]) {
 
 	InitFilteredImages(KnobFilteredImagesFile.Value().c_str());
 
+	if(KnobProfileShared.Value()) {
+		SharedIns.InitProfile();
+	} else if(!KnobSharedInsFile.Value().empty()) {
+		SharedIns.Load(KnobSharedInsFile.Value());
+	}
+
 	OPTIONS.InstrTopLevelFuncs = KnobInstrumentTopLevel.Value();
 	OPTIONS.TrackFuncCalls = KnobTrackFuncCalls.Value();
 
@@ -9,6 +9,11 @@ PINTOOL_ARGS="$PINTOOL_ARGS -log_file $CONCURRIT_HOME/work/pinlogfile.txt"
 PINTOOL_ARGS="$PINTOOL_ARGS -filtered_images_file $CONCURRIT_HOME/work/filtered_images.txt"
 PINTOOL_ARGS="$PINTOOL_ARGS -track_func_calls 0"
 PINTOOL_ARGS="$PINTOOL_ARGS -inst_top_level 0"
+PINTOOL_ARGS="$PINTOOL_ARGS -remove_when_disabled 0"
+
+# shared-variable discovery: profile an uncontrolled run (-u), then instrument only the recorded instructions
+#PINTOOL_ARGS="$PINTOOL_ARGS -shared_ins_file $CONCURRIT_HOME/work/shared_ins.txt -profile_shared 1"
+#PINTOOL_ARGS="$PINTOOL_ARGS -shared_ins_file $CONCURRIT_HOME/work/shared_ins.txt"
 
 PROGRAM_ARGS="$@"
 
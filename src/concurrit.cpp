@@ -59,6 +59,8 @@ void Concurrit_Constructor() {
 	google::InitGoogleLogging("concurrit");
 
 	PthreadOriginals::initialize();
+
+	VirtualClock::Init();
 }
 
 /********************************************************************************/
@@ -121,7 +123,8 @@ void Concurrit::Init(int argc /*= -1*/, char **argv /*= NULL*/) {
 
 	//==========================================
 
-	if(Config::RunUncontrolled || !Config::PinInstrEnabled) {
+	// stress mode runs uncontrolled, but keeps the instrumentation to inject delays
+	if((Config::RunUncontrolled && !Config::IsStressMode()) || !Config::PinInstrEnabled) {
 		PinMonitor::Shutdown();
 	}
 
@@ -179,6 +182,8 @@ void Concurrit::Destroy() {
 	safe_assert(INSTANCEOF(InstrHandler::Current, ConcurritInstrHandler*));
 	safe_delete(InstrHandler::Current);
 
+	CoroutineGroup::FinishParked();
+
 	Coroutine::FinishMain();
 
 	Thread::delete_tls_key();
@@ -53,6 +53,22 @@ bool Config::ReloadTestLibraryOnRestart = false;
 bool Config::MarkEndingBranchesCovered = true;
 bool Config::SaveExecutionTraceToFile = false;
 bool Config::CancelThreadsToRestart = false;
+AffinityPolicyType Config::AffinityPolicy = AFFINITY_NONE;
+int Config::AffinityWorkerIndex = -1;
+int Config::CoroutineStackSizeKB = 0; // 0 means the default pthread stack size
+int Config::MaxParkedCoroutines = 0;
+unsigned int Config::SchedulingPoints = ~((1U << SyncLock) | (1U << SyncUnlock) | (1U << SyncWait) | (1U << SyncSignal)); // all events but synchronization operations
+bool Config::ScheduleFences = false; // atomic updates replace accesses, so they stay scheduling points by default, but fences do not
+int Config::AdaptiveSampleRate = 256;
+bool Config::RunAhead = false;
+bool Config::VirtualTime = false;
+bool Config::ScopedInstrumentation = false;
+bool Config::FilterUnsharedAccesses = false;
+bool Config::WatchAccesses = false;
+int Config::StressDelayRate = 0;
+long Config::StressMaxDelayUSecs = 100;
+unsigned int Config::StressSeed = 0; // set to time(NULL) when -x is given without -y
+char* Config::StressReplayFile = NULL;
 //ExecutionModeType Config::ExecutionMode = ExecutionModeType::MODE_SINGLE;
 
 /********************************************************************************/
@@ -63,20 +79,32 @@ static void usage() {
 			"-h: Show this help. (OnlyShowHelp)\n\n"
 
 //			"-a: Track altenate paths (TrackAlternatePaths)\n"
+			"-aMODE: CPU affinity of the search. MODE in [none, compact, spread[:N]], compact pins main and the controlled threads to one core, spread[:N] pins parallel search worker N (default: the first core no other worker has claimed) to its own physical core (AffinityPolicy, AffinityWorkerIndex)\n"
+			"-bN: Profile and/or predicates once every N transitions to reorder their operands, 0 disables (AdaptiveSampleRate)\n"
 			"-c[0|1]: Cut covered subtrees. (DeleteCoveredSubtrees)\n"
 			"-dPATH: Save dot file of the execution tree in file PATH. (SaveDotGraphToFile)\n"
+			"-eKINDS: Run threads natively between scheduling points of the given kinds, and of the kinds the predicates of the test depend on (the first execution stops at every event). KINDS is a comma-separated subset of [auto, access, call, enter, return, pc, sync, atomic, sleep], -eauto derives all kinds from the predicates, -esync schedules only at pthread synchronization operations, -eatomic only at atomic instructions and fences; fences are scheduling points only with -eatomic (SchedulingPoints, ScheduleFences, RunAhead)\n"
 //			"-eMODE: Execution mode. MODE in [server, client]"
 			"-fN: Exit after first N explorations. (ExitOnFirstExecution)\n"
+			"-g[0|1]: Run controlled threads on a virtual clock, sleeps do not block (VirtualTime)\n"
+			"-i[0|1]: Instrument only the events that are scheduling points or that the compiled predicates depend on, re-instrumenting when new predicates need more (ScopedInstrumentation). Predicates evaluated directly by the test code are not seen\n"
+			"-j[0|1]: Record reads and writes only of the addresses and ranges that READS/WRITES predicates and symbol registrations refer to (WatchAccesses)\n"
 			"-k: Cancel threads to restart SUT.\n"
 			"-l: Test program as shared (.so) library.\n"
 			"-m[0|1]: Enable/disable manual instrumentation (ManuelInstrEnabled)\n"
+			"-n[0|1]: Do not schedule at memory accesses to pages that only one thread touched so far (FilterUnsharedAccesses)\n"
+			"-oN: Keep up to N ended threads parked for reuse by later scenarios (MaxParkedCoroutines)\n"
 			"-p[0|1]: Enable pin-tool instrumentation (PinInstrEnabled)\n"
+			"-qPATH: Replay under control the schedule that a failing stress execution saved to PATH, instead of the test case (StressReplayFile)\n"
 			"-r: Reload test library after each restart (ReloadTestLibraryOnRestart)\n"
 			"-s[0|1]: Use stack-based DFS (!KeepExecutionTree)\n"
 			"-t: Save execution trace to file (SaveExecutionTraceToFile)\n"
 			"-u: Run test program uncontrolled (RunUncontrolled)\n"
 			"-vN: Verbosity level (N >= 0)\n"
 			"-wN: Maximum wait time (MaxWaitTimeUSecs).\n"
+			"-xN: Stress mode: run uncontrolled, injecting random delays or yields at N per thousand events (StressDelayRate)\n"
+			"-yN: Seed of the first stress execution, the seed of each execution is saved to stress.txt (StressSeed)\n"
+			"-zN: Stack size of controlled threads in KB (CoroutineStackSizeKB)\n"
 
 			"=============================================\n");
 }
@@ -99,8 +127,9 @@ bool Config::ParseCommandLine(int argc /*= -1*/, char **argv /*= NULL*/) {
 
 	int c;
 	opterr = 0;
+	bool stress_seed_given = false;
 
-	while ((c = getopt(argc, argv, "c::d::f::hkl:m::p::rstuv:w:")) != -1) {
+	while ((c = getopt(argc, argv, "a:b:c::d::e:f::g::hi::j::kl:m::n::o:p::q:rstuv:w:x:y:z:")) != -1) {
 		switch(c) {
 //		case 'a':
 ////			Config::KeepExecutionTree = true;
@@ -108,6 +137,34 @@ bool Config::ParseCommandLine(int argc /*= -1*/, char **argv /*= NULL*/) {
 //			Config::MarkEndingBranchesCovered = false; // alternate paths handle this
 //			printf("Will track alternate paths!\n");
 //			break;
+		case 'a':
+			if(optarg == NULL) {
+				safe_fail("Argument of -a option is missing, none, compact or spread is required!");
+			}
+			// the mode name ends at the optional ":N" of spread
+			char mode[16];
+			snprintf(mode, 16, "%.*s", int(strcspn(optarg, ":")), optarg);
+			if(strcmp(mode, "none") == 0 && optarg[4] == '\0') {
+				Config::AffinityPolicy = AFFINITY_NONE;
+			} else if(strcmp(mode, "compact") == 0 && optarg[7] == '\0') {
+				Config::AffinityPolicy = AFFINITY_COMPACT;
+			} else if(strcmp(mode, "spread") == 0) {
+				Config::AffinityPolicy = AFFINITY_SPREAD;
+				if(optarg[6] == ':') {
+					Config::AffinityWorkerIndex = atoi(&optarg[7]);
+					safe_assert(Config::AffinityWorkerIndex >= 0);
+				}
+			} else {
+				safe_fail("Argument of -a option is incorrect, none, compact or spread is required!");
+			}
+			printf("Affinity policy is %s.\n", AffinityPolicyToString(Config::AffinityPolicy));
+			break;
+		case 'b':
+			safe_assert(optarg != NULL);
+			Config::AdaptiveSampleRate = atoi(optarg);
+			safe_assert(Config::AdaptiveSampleRate >= 0);
+			printf("AdaptiveSampleRate is %d.\n", Config::AdaptiveSampleRate);
+			break;
 		case 'c':
 			Config::DeleteCoveredSubtrees = get_bool_opt(optarg);
 			if(Config::DeleteCoveredSubtrees) {
@@ -116,6 +173,45 @@ bool Config::ParseCommandLine(int argc /*= -1*/, char **argv /*= NULL*/) {
 				printf("Will not cut covered subtrees!\n");
 			}
 			break;
+		case 'e':
+			if(optarg == NULL) {
+				safe_fail("Argument of -e option is missing, a list of event kinds is required!");
+			}
+			// thread ends are always scheduling points
+			Config::SchedulingPoints = (1U << ThreadEnd);
+			Config::RunAhead = true;
+			{
+				char* kinds = strdup(optarg);
+				std::vector<std::string> kind_list = TokenizeStringToVector(kinds, ",");
+				for(std::vector<std::string>::iterator itr = kind_list.begin(); itr < kind_list.end(); ++itr) {
+					if(*itr == "auto") {
+						// only the kinds the pending transition depends on
+					} else if(*itr == "access") {
+						// atomic instructions are accesses too
+						Config::SchedulingPoints |= (1U << MemAccessBefore) | (1U << AtomicAccess);
+					} else if(*itr == "call") {
+						Config::SchedulingPoints |= (1U << FuncCall);
+					} else if(*itr == "enter") {
+						Config::SchedulingPoints |= (1U << FuncEnter);
+					} else if(*itr == "return") {
+						Config::SchedulingPoints |= (1U << FuncReturn);
+					} else if(*itr == "pc") {
+						Config::SchedulingPoints |= (1U << AtPc);
+					} else if(*itr == "atomic") {
+						Config::SchedulingPoints |= (1U << AtomicAccess);
+						Config::ScheduleFences = true;
+					} else if(*itr == "sleep") {
+						Config::SchedulingPoints |= (1U << Sleep);
+					} else if(*itr == "sync") {
+						Config::SchedulingPoints |= (1U << SyncLock) | (1U << SyncUnlock) | (1U << SyncWait) | (1U << SyncSignal);
+					} else {
+						safe_fail("Unknown event kind in -e option: %s\n", itr->c_str());
+					}
+				}
+				free(kinds);
+			}
+			printf("Will run threads natively between scheduling points: %s.\n", optarg);
+			break;
 //		case 'e':
 //			if(optarg == NULL) {
 //				safe_fail("Argument of -e option is missing, server or client is required!");
@@ -134,6 +230,30 @@ bool Config::ParseCommandLine(int argc /*= -1*/, char **argv /*= NULL*/) {
 //			}
 //			printf("Execution mode is %d.\n", Config::ExecutionMode);
 //			break;
+		case 'g':
+			Config::VirtualTime = get_bool_opt(optarg);
+			if(Config::VirtualTime) {
+				printf("Will run controlled threads on a virtual clock.\n");
+			}
+			break;
+		case 'j':
+			Config::WatchAccesses = get_bool_opt(optarg);
+			if(Config::WatchAccesses) {
+				printf("Will record only the accesses to the addresses the predicates refer to.\n");
+			}
+			break;
+		case 'n':
+			Config::FilterUnsharedAccesses = get_bool_opt(optarg);
+			if(Config::FilterUnsharedAccesses) {
+				printf("Will not schedule at accesses to memory touched by only one thread.\n");
+			}
+			break;
+		case 'i':
+			Config::ScopedInstrumentation = get_bool_opt(optarg);
+			if(Config::ScopedInstrumentation) {
+				printf("Will instrument only the events the predicates depend on.\n");
+			}
+			break;
 		case 'h':
 			Config::OnlyShowHelp = true;
 			usage();
@@ -165,6 +285,12 @@ bool Config::ParseCommandLine(int argc /*= -1*/, char **argv /*= NULL*/) {
 				printf("Will disable manuel instrumentation!\n");
 			}
 			break;
+		case 'o':
+			safe_assert(optarg != NULL);
+			Config::MaxParkedCoroutines = atoi(optarg);
+			safe_assert(Config::MaxParkedCoroutines >= 0);
+			printf("Will keep up to %d ended threads parked.\n", Config::MaxParkedCoroutines);
+			break;
 		case 'p':
 			Config::PinInstrEnabled = get_bool_opt(optarg);
 			if(Config::PinInstrEnabled) {
@@ -199,6 +325,33 @@ bool Config::ParseCommandLine(int argc /*= -1*/, char **argv /*= NULL*/) {
 			safe_assert(Config::MaxWaitTimeUSecs > 0);
 			printf("MaxWaitTimeUSecs is %l.\n", Config::MaxWaitTimeUSecs);
 			break;
+		case 'x':
+			safe_assert(optarg != NULL);
+			Config::StressDelayRate = atoi(optarg);
+			safe_assert(BETWEEN(1, Config::StressDelayRate, 1000));
+			// stress mode runs the test uncontrolled, without the execution tree
+			Config::RunUncontrolled = true;
+			printf("Will run in stress mode with %d delays per thousand events.\n", Config::StressDelayRate);
+			break;
+		case 'y':
+			safe_assert(optarg != NULL);
+			Config::StressSeed = static_cast<unsigned int>(strtoul(optarg, NULL, 10));
+			stress_seed_given = true;
+			break;
+		case 'q':
+			safe_assert(optarg != NULL);
+			Config::StressReplayFile = optarg;
+			if(Config::ExitOnFirstExecution < 0) {
+				Config::ExitOnFirstExecution = 1;
+			}
+			printf("Will replay the stress schedule in %s.\n", Config::StressReplayFile);
+			break;
+		case 'z':
+			safe_assert(optarg != NULL);
+			Config::CoroutineStackSizeKB = atoi(optarg);
+			safe_assert(Config::CoroutineStackSizeKB >= 0);
+			printf("Stack size of controlled threads is %d KB.\n", Config::CoroutineStackSizeKB);
+			break;
 		case 'l':
 			if(optarg == NULL) {
 				safe_fail("Argument of -l option is missing, a library file is required!");
@@ -223,6 +376,21 @@ bool Config::ParseCommandLine(int argc /*= -1*/, char **argv /*= NULL*/) {
 
 //	safe_assert(!Config::TrackAlternatePaths || Config::KeepExecutionTree);
 
+	if(Config::IsStressMode()) {
+		// any seed, including 0, can be given with -y before or after -x
+		if(!stress_seed_given) {
+			Config::StressSeed = static_cast<unsigned int>(time(NULL));
+		}
+		printf("Stress seed is %u.\n", Config::StressSeed);
+	}
+
+	if(Config::IsStressReplay()) {
+		safe_assert(!Config::IsStressMode());
+		// the stress execution recorded every scheduling point, so the replay stops at each of them
+		Config::RunAhead = false;
+		Config::ScopedInstrumentation = false;
+	}
+
 	return true;
 }
 
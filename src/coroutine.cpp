@@ -36,6 +36,7 @@
 namespace concurrit {
 
 Coroutine* Coroutine::main_ = NULL;
+__thread Coroutine* Coroutine::current_ = NULL;
 
 Coroutine::Coroutine(THREADID tid, ThreadEntryFunction entry_function, void* entry_arg, int stack_size)
 : Thread(tid, entry_function, entry_arg, stack_size)
@@ -48,8 +49,7 @@ Coroutine::Coroutine(THREADID tid, ThreadEntryFunction entry_function, void* ent
 //	current_node_ = NULL;
 //	is_driver_thread_ = false;
 
-	srcloc_ = NULL;
-	instr_callback_info_[0] = '\0';
+	ResetRunState();
 
 	ThreadVarPtr p(new StaticThreadVar(this, "Self-ThreadVar"));
 	tvar_ = p;
@@ -57,6 +57,26 @@ Coroutine::Coroutine(THREADID tid, ThreadEntryFunction entry_function, void* ent
 
 /********************************************************************************/
 
+// a parked coroutine is reused for another thread of a later execution,
+// so nothing of its last run may leak into the next one
+void Coroutine::ResetRunState() {
+	srcloc_ = NULL;
+	instr_callback_info_[0] = '\0';
+	stress_rand_state_ = 0;
+
+	aux_changes_ = 0;
+	last_taken_node_ = NULL;
+	last_taken_version_ = 0;
+	last_taken_dependencies_ = 0;
+	last_taken_changes_ = 0;
+	native_deadline_ = 0;
+	vtime_ = 0;
+
+	in_sut_ = false;
+}
+
+/********************************************************************************/
+
 Coroutine::~Coroutine() {
 	// noop
 }
@@ -74,7 +94,10 @@ void Coroutine::StartMain() {
 	// for non-main coroutines, this is called in ThreadEntry
 	co->attach_pthread(pth_self);
 
+	Thread::SetAffinity(MAIN_TID);
+
 	main_ = co;
+	current_ = co;
 }
 
 void Coroutine::FinishMain() {
@@ -92,6 +115,7 @@ void Coroutine::FinishMain() {
 
 	delete co;
 	main_ = NULL;
+	current_ = NULL;
 }
 
 bool Coroutine::IsMain() {
@@ -105,8 +129,12 @@ bool Coroutine::IsMain() {
 /********************************************************************************/
 
 Coroutine* Coroutine::Current() {
-	Coroutine* co = ASINSTANCEOF(Thread::Current(), Coroutine*);
-	safe_assert(co != NULL);
+	Coroutine* co = current_;
+	if(co == NULL) {
+		co = ASINSTANCEOF(Thread::Current(), Coroutine*);
+		safe_assert(co != NULL);
+		current_ = co;
+	}
 
 //	safe_assert(co->group_ == NULL || co->group_->CheckCurrent(co));
 
@@ -185,6 +213,7 @@ void Coroutine::Start(pthread_t* pid /*= NULL*/, const pthread_attr_t* attr /*=
 	exception_ = NULL;
 //	current_node_ = NULL;
 //	trinfolist_.clear();
+	ResetRunState();
 
 	//---------------
 	CHANNEL_BEGIN_ATOMIC();
@@ -268,23 +297,33 @@ void* Coroutine::Run() {
 	void* return_value = NULL;
 	CHECK(status_ == PASSIVE) << "Wrong status " << status_ << ", expected " << PASSIVE;
 
-	Scenario* scenario = Scenario::NotNullCurrent();
+	Scenario* scenario = NULL;
+
+	current_ = this;
 
 	for(;true;) {
 		try {
+			// a parked coroutine may be restarted by a different scenario
+			scenario = Scenario::NotNullCurrent();
+
+			stress_rand_state_ = scenario->stress_seed() ^ (static_cast<unsigned int>(tid_) * 2654435761U);
+
 			SetStarted();
 
 			return_value = NULL;
 
 			try {
 				// run the actual function
+				in_sut_ = true;
 				return_value = call_function();
+				in_sut_ = false;
 
 				//---------------
 				if(PinMonitor::IsEnabled())
 					PinMonitor::ThreadEnd(this, scenario);
 
 			} catch(std::exception* e) {
+				in_sut_ = false;
 				// first check if this is due to pthread_exit
 				BacktrackException* be = ASINSTANCEOF(e, BacktrackException*);
 				if(be != NULL && be->reason() == PTH_EXIT) {
@@ -306,6 +345,7 @@ void* Coroutine::Run() {
 			SetEnded();
 
 		} catch(MessageType& m) {
+			in_sut_ = false;
 			// only terminate and restart messages are thrown
 			if(m == MSG_TERMINATE) {
 				MYLOG(2) << CO_TITLE << "terminating";
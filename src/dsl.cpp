@@ -292,8 +292,9 @@ void TransitionNode::OnTaken(Coroutine* current, int child_index /*= 0*/) {
 	safe_assert(BETWEEN(0, child_index, children_.size()-1));
 
 	// update var if not null
-	if(var_ != NULL) {
+	if(var_ != NULL && var_->thread() != current) {
 		var_->set_thread(current);
+		Scenario::NotNullCurrent()->exec_tree()->BumpVersion();
 	}
 
 	// update counter
@@ -332,6 +333,31 @@ void TransitionNode::OnTaken(Coroutine* current, int child_index /*= 0*/) {
 
 /*************************************************************************************/
 
+// run by the thread consuming this node, while it holds atomic_ref.
+// the node of the next step is reused if it was created in a previous execution
+RunThroughNode* RunThroughNode::NextStep() {
+	if(num_steps_ <= 1) {
+		return NULL;
+	}
+
+	RunThroughNode* next = NULL;
+	ExecutionTree* c = child(0);
+	if(c != NULL) {
+		next = ASINSTANCEOF(c, RunThroughNode*);
+		safe_assert(next != NULL && !next->covered());
+		next->Init(pred_, var_);
+	} else {
+		next = new RunThroughNode(static_info_, pred_, var_);
+		ChildLoc(this, 0).set(next);
+	}
+	next->set_num_steps(num_steps_ - 1);
+
+	next->OnSubmitted();
+	return next;
+}
+
+/*************************************************************************************/
+
 void ExecutionTreeManager::SaveDotGraph(const char* filename) {
 	safe_assert(filename != NULL);
 	DotGraph g("ExecutionTree");
@@ -347,6 +373,8 @@ void ExecutionTreeManager::SaveDotGraph(const char* filename) {
 /*************************************************************************************/
 
 ExecutionTreeManager::ExecutionTreeManager() {
+	version_ = 0;
+	acquired_ = NULL;
 	stack_index_ = 0;
 	safe_assert(node_stack_.empty());
 	node_stack_.push_back({ROOTNODE(), 0}); // of root node
@@ -374,6 +402,9 @@ void ExecutionTreeManager::Restart() {
 //		ROOTNODE()->PopulateLocations(0, &current_nodes_);
 //	}
 
+	acquired_ = NULL;
+	BumpVersion();
+
 	SetRef(NULL);
 }
 
@@ -424,6 +455,9 @@ ExecutionTree* ExecutionTreeManager::AcquireRefEx(AcquireRefMode mode, long time
 	return node;
 }
 
+// period at which main checks whether all threads are blocked in original calls
+static const long NativeBlockPollUSecs = 10000;
+
 // run by test threads to get the next transition node
 // only main can set timeout
 ExecutionTree* ExecutionTreeManager::AcquireRef(AcquireRefMode mode, long timeout_usec /*= -1*/) {
@@ -432,6 +466,9 @@ ExecutionTree* ExecutionTreeManager::AcquireRef(AcquireRefMode mode, long timeou
 	if(timeout_usec > 0) {
 		timer.start();
 	}
+	// set when all threads were seen blocked in original calls, with the wakeup count at that time
+	bool native_blocked = false;
+	unsigned native_wakeups = 0;
 
 	while(true) {
 		ExecutionTree* node = ExchangeRef(LOCKNODE());
@@ -455,12 +492,14 @@ ExecutionTree* ExecutionTreeManager::AcquireRef(AcquireRefMode mode, long timeou
 		else
 		if(mode == EXIT_ON_LOCK) {
 			LOCKNODE()->OnLock();
+			acquired_ = node;
 			return node; //  can be null, but cannot be lock or end node
 		}
 		else {
 			if(IS_EMPTY(node)) {
 				if(mode == EXIT_ON_EMPTY) {
 					LOCKNODE()->OnLock();
+					acquired_ = NULL;
 					// will process this
 					return NULL;
 				} else {
@@ -470,6 +509,7 @@ ExecutionTree* ExecutionTreeManager::AcquireRef(AcquireRefMode mode, long timeou
 			else // FULL
 			if(mode == EXIT_ON_FULL) {
 				LOCKNODE()->OnLock();
+				acquired_ = node;
 				// will process this
 				safe_assert(node != NULL);
 				return node;
@@ -481,18 +521,29 @@ ExecutionTree* ExecutionTreeManager::AcquireRef(AcquireRefMode mode, long timeou
 			//=========================================
 			// yield and wait
 			if(timeout_usec > 0) {
-				int result = sem_ref_.WaitTimed(timeout_usec);
+				int result = sem_ref_.WaitTimed(std::min(timeout_usec, NativeBlockPollUSecs));
 				if(result == ETIMEDOUT) {
-					// fire timeout (backtrack)
-					ExecutionTree* cn = GetRef();
-					MYLOG(2) << "AcquireRef: Node not consumed on time: " << (cn == NULL ? "NULL" : cn->message());
-					TRIGGER_BACKTRACK(TIMEOUT);
+					// no thread can take the node if all stay blocked in original calls for a whole period
+					CoroutineGroup* group = safe_notnull(Scenario::Current())->group();
+					const unsigned wakeups = group->native_wakeups();
+					if(group->IsAllNativeBlocked()) {
+						if(native_blocked && native_wakeups == wakeups) {
+							MYLOG(2) << "AcquireRef: All threads are blocked in original calls.";
+							TRIGGER_BACKTRACK(TIMEOUT);
+						}
+						native_blocked = true;
+						native_wakeups = wakeups;
+					} else {
+						native_blocked = false;
+					}
+				} else {
+					safe_assert(result == PTH_SUCCESS);
+					sem_ref_.Signal();
 				}
-				safe_assert(result == PTH_SUCCESS);
 			} else {
 				sem_ref_.Wait();
+				sem_ref_.Signal();
 			}
-			sem_ref_.Signal();
 		}
 
 		//=========================================
@@ -513,7 +564,7 @@ ExecutionTree* ExecutionTreeManager::AcquireRef(AcquireRefMode mode, long timeou
 
 /*************************************************************************************/
 
-void ExecutionTreeManager::ReleaseRef(ExecutionTree* node /*= NULL*/, int child_index /*= -1*/) {
+void ExecutionTreeManager::ReleaseRef(ExecutionTree* node /*= NULL*/, int child_index /*= -1*/, ExecutionTree* next /*= NULL*/) {
 	safe_assert(IS_LOCKNODE(GetRef(std::memory_order_relaxed)));
 	LOCKNODE()->OnUnlock();
 
@@ -524,6 +575,11 @@ void ExecutionTreeManager::ReleaseRef(ExecutionTree* node /*= NULL*/, int child_
 		Scenario::NotNullCurrent()->avg_counter("Search stack size").increment(node_stack_.size());
 	}
 
+	// putting back the acquired node does not change the state seen by the threads
+	if(child_index >= 0 || node != acquired_) {
+		BumpVersion();
+	}
+
 	if(child_index >= 0) {
 		safe_assert(node != NULL);
 
@@ -531,8 +587,10 @@ void ExecutionTreeManager::ReleaseRef(ExecutionTree* node /*= NULL*/, int child_
 		AddToPath(node, child_index);
 
 		// if released node is an end node, we do not nullify atomic_ref
-		SetRef(is_endnode ? node : NULL);
+		safe_assert(next == NULL || !is_endnode);
+		SetRef(is_endnode ? node : next);
 	} else {
+		safe_assert(next == NULL);
 		// release
 		SetRef(node);
 	}
@@ -1014,6 +1072,29 @@ void ExecutionTreeManager::EndWithException(Coroutine* current, std::exception*
 }
 
 
+/*************************************************************************************/
+
+size_t SelectThreadNode::NumSelectable(CoroutineGroup* group) {
+	size_t n = 0;
+	if(scope_ != NULL && !scope_->empty()) {
+		if(restriction_.empty()) {
+			return scope_->size();
+		}
+		for(ThreadVarPtrSet::iterator itr = scope_->begin(); itr != scope_->end(); ++itr) {
+			if(restriction_.Allows(*itr)) ++n;
+		}
+	} else {
+		if(restriction_.empty()) {
+			return group->GetNumMembers();
+		}
+		MembersMap* members = group->members();
+		for(MembersMap::iterator itr = members->begin(); itr != members->end(); ++itr) {
+			if(restriction_.Allows(itr->second)) ++n;
+		}
+	}
+	return n;
+}
+
 /*************************************************************************************/
 
 bool ForallThreadNode::ComputeCoverage(bool call_parent /*= false*/) {
@@ -1022,8 +1103,7 @@ bool ForallThreadNode::ComputeCoverage(bool call_parent /*= false*/) {
 	// since the computation below may turn already covered not covered
 
 	if(!covered_) {
-		// scope_size_ == 0 means scope is NULL, so use the total number of threads when needed
-		size_t sz = scope_size_ == 0 ? scenario->group()->GetNumMembers() : scope_size_;
+		size_t sz = NumSelectable(scenario->group());
 		covered_ = (children_.size() == sz) && ExecutionTree::ComputeCoverage(call_parent);
 	}
 	return covered_;
@@ -41,11 +41,44 @@ namespace concurrit {
  * CoroutineGroup
  */
 
+std::vector<Coroutine*> CoroutineGroup::parked_;
+
+/********************************************************************************/
+
 CoroutineGroup:: CoroutineGroup() {
 	scenario_ = NULL;
 	next_tid_ = 1;
 	member_tidseq_.clear();
 	next_idx_ = 0;
+	native_wakeups_ = 0;
+}
+
+/********************************************************************************/
+
+Coroutine* CoroutineGroup::NewMember(THREADID tid, ThreadEntryFunction function, void* arg) {
+	if(!parked_.empty()) {
+		Coroutine* co = parked_.back();
+		parked_.pop_back();
+		safe_assert(co->status() == ENDED && co->group() == NULL);
+		MYLOG(2) << "Reusing parked coroutine " << co->tid() << " as " << tid;
+		co->set_tid(tid);
+		co->set_entry_function(function);
+		co->set_entry_arg(arg);
+		co->ResetRunState();
+		return co;
+	}
+	return new Coroutine(tid, function, arg, Config::CoroutineStackSizeKB * 1024);
+}
+
+/********************************************************************************/
+
+void CoroutineGroup::FinishParked() {
+	for(std::vector<Coroutine*>::iterator itr = parked_.begin(); itr < parked_.end(); ++itr) {
+		Coroutine* co = *itr;
+		co->Finish();
+		safe_assert(co->status() == TERMINATED);
+	}
+	parked_.clear();
 }
 
 /********************************************************************************/
@@ -65,6 +98,7 @@ void CoroutineGroup::AddMember(Coroutine* member) {
 
 	// once determined the tid, then insert it as new member
 	members_[tid] = member;
+	set_table_slot(tid, member);
 	member->set_group(this);
 
 	// put in the creation order
@@ -87,6 +121,11 @@ void CoroutineGroup::DeleteMember(Coroutine* member) {
 	safe_assert(tid >= 0);
 
 	members_.erase(tid);
+	set_table_slot(tid, NULL);
+	{
+		ScopeMutex smutex(&create_mutex_);
+		pthread_to_member_.erase(member->pthread());
+	}
 	member->set_group(NULL);
 
 	member_tidseq_[tid] = NULL;
@@ -96,6 +135,11 @@ void CoroutineGroup::DeleteMember(Coroutine* member) {
 
 void CoroutineGroup::DeleteAllMembers() {
 	members_.clear();
+	member_table_.clear();
+	{
+		ScopeMutex smutex(&create_mutex_);
+		pthread_to_member_.clear();
+	}
 	member_tidseq_.clear();
 	next_tid_ = 1;
 	next_idx_ = 0;
@@ -144,6 +188,7 @@ void CoroutineGroup::TakeOutMember(Coroutine* member) {
 	MembersMap::iterator itr = members_.find(member->tid());
 	safe_assert(itr != members_.end());
 	members_.erase(itr);
+	set_table_slot(member->tid(), NULL);
 }
 
 void CoroutineGroup::PutBackMember(Coroutine* member) {
@@ -151,18 +196,31 @@ void CoroutineGroup::PutBackMember(Coroutine* member) {
 	safe_check(!HasMember(member));
 	safe_assert(!member->IsMain()); // cannot add main in here
 	members_[member->tid()] = member;
+	set_table_slot(member->tid(), member);
 }
 
 /********************************************************************************/
 
 void CoroutineGroup::Finish() {
+	bool parked_any = false;
 	// no need to finish main, it is always running
 	for_each_member(co) {
+		if(co->status() == ENDED && parked_.size() < static_cast<size_t>(Config::MaxParkedCoroutines)) {
+			// keep the thread waiting for a restart message
+			co->set_group(NULL);
+			parked_.push_back(co);
+			parked_any = true;
+			continue;
+		}
 		if(co->status() > PASSIVE) {
 			co->Finish();
 		}
 		safe_assert(co->status() == TERMINATED);
 	}
+	// parked members may now be restarted by other groups
+	if(parked_any) {
+		DeleteAllMembers();
+	}
 }
 
 
@@ -283,6 +341,39 @@ bool CoroutineGroup::IsAllEnded() {
 
 /********************************************************************************/
 
+bool CoroutineGroup::IsAllNativeBlocked() {
+	bool blocked = false;
+	for_each_member(co) {
+		StatusType status = co->status();
+		if(status <= PASSIVE || co->is_ended()) continue;
+		if(status != NATIVE_BLOCKED || co->native_deadline() != 0) {
+			return false;
+		}
+		blocked = true;
+	}
+	return blocked;
+}
+
+/********************************************************************************/
+
+uint64_t CoroutineGroup::GetIdleDeadline() {
+	uint64_t deadline = 0;
+	for_each_member(co) {
+		StatusType status = co->status();
+		if(status <= PASSIVE || co->is_ended()) continue;
+		if(status == ENABLED) {
+			return 0;
+		}
+		uint64_t d = co->native_deadline();
+		if(status == NATIVE_BLOCKED && d != 0 && (deadline == 0 || d < deadline)) {
+			deadline = d;
+		}
+	}
+	return deadline;
+}
+
+/********************************************************************************/
+
 //bool CoroutineGroup::CheckCurrent(Coroutine* current) {
 //	if(ConcurritExecutionMode == SINGLE_RUNNER) {
 //		return current_ == current;
@@ -312,20 +403,29 @@ Coroutine* CoroutineGroup::GetMember(THREADID tid) {
 		safe_assert(Coroutine::main() != NULL);
 		return Coroutine::main();
 	}
-	MembersMap::iterator itr = members_.find(tid);
-	if(itr == members_.end()) {
+	if(tid < 0 || static_cast<size_t>(tid) >= member_table_.size()) {
 		return NULL;
-	} else {
-		Coroutine* co = itr->second;
-		safe_assert(co != NULL);
-		safe_assert(co->group() != NULL);
-		return co;
 	}
+	Coroutine* co = member_table_[tid];
+	safe_assert(co == NULL || co->group() != NULL);
+	safe_assert((co == NULL) == (members_.find(tid) == members_.end()));
+	return co;
 }
 
 /********************************************************************************/
 
+// called from interposed pthread functions, so pthread_to_member_ is only read here,
+// under the same lock as IndexPThread, which is the only writer while threads run
 Coroutine* CoroutineGroup::GetMember(const pthread_t& pid) {
+	ScopeMutex smutex(&create_mutex_);
+	PThreadToMemberMap::const_iterator itr = pthread_to_member_.find(pid);
+	if(itr != pthread_to_member_.end()) {
+		Coroutine* co = itr->second;
+		// the entry is stale if the member restarted on a new pthread
+		if(co->pthread() == pid && GetMember(co->tid()) == co) {
+			return co;
+		}
+	}
 	for_each_member(co) {
 		if(co->pthread() == pid) {
 			return co;
@@ -336,6 +436,27 @@ Coroutine* CoroutineGroup::GetMember(const pthread_t& pid) {
 
 /********************************************************************************/
 
+void CoroutineGroup::IndexPThread(Coroutine* member) {
+	safe_assert(member != NULL && !member->IsMain());
+	pthread_t pid = member->pthread();
+	if(pid != PTH_INVALID_THREAD) {
+		ScopeMutex smutex(&create_mutex_);
+		pthread_to_member_[pid] = member;
+	}
+}
+
+/********************************************************************************/
+
+void CoroutineGroup::set_table_slot(THREADID tid, Coroutine* member) {
+	safe_assert(tid > MAIN_TID);
+	if(static_cast<size_t>(tid) >= member_table_.size()) {
+		member_table_.resize(tid + 1, NULL);
+	}
+	member_table_[tid] = member;
+}
+
+/********************************************************************************/
+
 void CoroutineGroup::KillAll(int signal_number, THREADID sender /*= 0*/) {
 	for_each_member(co) {
 		if(co->tid() != sender) {
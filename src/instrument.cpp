@@ -37,87 +37,105 @@
 
 // functions implementing manual instrumentation routines
 // these functions overwrite functions in libdummy.so when concurrit is preloaded
+// they run concurrit's runtime, whose synchronization operations are not events of the SUT
 
 using namespace concurrit;
 
 /********************************************************************************/
 
 void concurritAddressOfSymbolEx(const char* symbol, uintptr_t addr) {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritAddressOfSymbolEx(symbol, addr);
 }
 
 void concurritStartTest() {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritStartTest();
 }
 void concurritEndTest() {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritEndTest();
 }
 
 void concurritEndSearch() {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritEndSearch();
 }
 
 void concurritStartInstrumentEx(const char* filename, const char* funcname, int line) {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritStartInstrumentEx(filename, funcname, line);
 }
 void concurritEndInstrumentEx(const char* filename, const char* funcname, int line) {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritEndInstrumentEx(filename, funcname, line);
 }
 
 void concurritAtPcEx(int pc, const char* filename, const char* funcname, int line) {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritAtPcEx(pc, filename, funcname, line);
 }
 
 void concurritFuncEnterEx(void* addr, uintptr_t arg0, uintptr_t arg1, const char* filename, const char* funcname, int line) {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritFuncEnterEx(addr, arg0, arg1, filename, funcname, line);
 }
 void concurritFuncReturnEx(void* addr, uintptr_t retval, const char* filename, const char* funcname, int line) {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritFuncReturnEx(addr, retval, filename, funcname, line);
 }
 
 void concurritFuncCallEx(void* from_addr, void* to_addr, uintptr_t arg0, uintptr_t arg1, const char* filename, const char* funcname, int line) {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritFuncCallEx(from_addr, to_addr, arg0, arg1, filename, funcname, line);
 }
 
 void concurritMemReadEx(void* addr, size_t size, const char* filename, const char* funcname, int line) {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritMemReadEx(addr, size, filename, funcname, line);
 }
 void concurritMemWriteEx(void* addr, size_t size, const char* filename, const char* funcname, int line) {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritMemWriteEx(addr, size, filename, funcname, line);
 }
 
 void concurritMemAccessBeforeEx(const char* filename, const char* funcname, int line) {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritMemAccessBeforeEx(filename, funcname, line);
 }
 void concurritMemAccessAfterEx(const char* filename, const char* funcname, int line) {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritMemAccessAfterEx(filename, funcname, line);
 }
 
 void concurritThreadStartEx(const char* filename, const char* funcname, int line) {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritThreadStartEx(filename, funcname, line);
 }
 
 void concurritThreadEndEx(const char* filename, const char* funcname, int line) {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritThreadEndEx(filename, funcname, line);
 }
 
 void concurritTriggerAssert(const char* expr, const char* filename, const char* funcname, int line) {
+	RuntimeScope rs;
 	safe_assert(InstrHandler::Current != NULL);
 	InstrHandler::Current->concurritTriggerAssert(expr, filename, funcname, line);
 }
@@ -43,6 +43,28 @@ int (* volatile PthreadOriginals::_pthread_create) (pthread_t *, const pthread_a
 int (* volatile PthreadOriginals::_pthread_join) (pthread_t, void **) = NULL;
 void (* volatile PthreadOriginals::_pthread_exit) (void *) = NULL;
 int (* volatile PthreadOriginals::_pthread_cancel) (pthread_t) = NULL;
+int (* volatile PthreadOriginals::_pthread_mutex_lock) (pthread_mutex_t*) = NULL;
+int (* volatile PthreadOriginals::_pthread_mutex_trylock) (pthread_mutex_t*) = NULL;
+int (* volatile PthreadOriginals::_pthread_mutex_unlock) (pthread_mutex_t*) = NULL;
+int (* volatile PthreadOriginals::_pthread_cond_wait) (pthread_cond_t*, pthread_mutex_t*) = NULL;
+int (* volatile PthreadOriginals::_pthread_cond_timedwait) (pthread_cond_t*, pthread_mutex_t*, const struct timespec*) = NULL;
+int (* volatile PthreadOriginals::_pthread_cond_signal) (pthread_cond_t*) = NULL;
+int (* volatile PthreadOriginals::_pthread_cond_broadcast) (pthread_cond_t*) = NULL;
+int (* volatile PthreadOriginals::_pthread_rwlock_rdlock) (pthread_rwlock_t*) = NULL;
+int (* volatile PthreadOriginals::_pthread_rwlock_wrlock) (pthread_rwlock_t*) = NULL;
+int (* volatile PthreadOriginals::_pthread_rwlock_tryrdlock) (pthread_rwlock_t*) = NULL;
+int (* volatile PthreadOriginals::_pthread_rwlock_trywrlock) (pthread_rwlock_t*) = NULL;
+int (* volatile PthreadOriginals::_pthread_rwlock_unlock) (pthread_rwlock_t*) = NULL;
+int (* volatile PthreadOriginals::_pthread_barrier_wait) (pthread_barrier_t*) = NULL;
+int (* volatile PthreadOriginals::_sem_wait) (sem_t*) = NULL;
+int (* volatile PthreadOriginals::_sem_trywait) (sem_t*) = NULL;
+int (* volatile PthreadOriginals::_sem_post) (sem_t*) = NULL;
+int (* volatile PthreadOriginals::_sem_timedwait) (sem_t*, const struct timespec*) = NULL;
+unsigned int (* volatile PthreadOriginals::_sleep) (unsigned int) = NULL;
+int (* volatile PthreadOriginals::_usleep) (useconds_t) = NULL;
+int (* volatile PthreadOriginals::_nanosleep) (const struct timespec*, struct timespec*) = NULL;
+int (* volatile PthreadOriginals::_gettimeofday) (struct timeval*, void*) = NULL;
+int (* volatile PthreadOriginals::_clock_gettime) (clockid_t, struct timespec*) = NULL;
 
 /********************************************************************************/
 
@@ -100,25 +122,198 @@ int PthreadOriginals::pthread_cancel(pthread_t thread) {
 
 /********************************************************************************/
 
+// the synchronization functions are called by the loader and by static constructors
+// before initialize(), so each is resolved on its first call
+
+int PthreadOriginals::pthread_mutex_lock(pthread_mutex_t* mutex) {
+	if(_pthread_mutex_lock == NULL) init_original(pthread_mutex_lock, int (* volatile) (pthread_mutex_t*));
+
+	return _pthread_mutex_lock(mutex);
+}
+
+int PthreadOriginals::pthread_mutex_trylock(pthread_mutex_t* mutex) {
+	if(_pthread_mutex_trylock == NULL) init_original(pthread_mutex_trylock, int (* volatile) (pthread_mutex_t*));
+
+	return _pthread_mutex_trylock(mutex);
+}
+
+int PthreadOriginals::pthread_mutex_unlock(pthread_mutex_t* mutex) {
+	if(_pthread_mutex_unlock == NULL) init_original(pthread_mutex_unlock, int (* volatile) (pthread_mutex_t*));
+
+	return _pthread_mutex_unlock(mutex);
+}
+
+int PthreadOriginals::pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex) {
+	if(_pthread_cond_wait == NULL) init_original(pthread_cond_wait, int (* volatile) (pthread_cond_t*, pthread_mutex_t*));
+
+	return _pthread_cond_wait(cond, mutex);
+}
+
+int PthreadOriginals::pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime) {
+	if(_pthread_cond_timedwait == NULL) init_original(pthread_cond_timedwait, int (* volatile) (pthread_cond_t*, pthread_mutex_t*, const struct timespec*));
+
+	return _pthread_cond_timedwait(cond, mutex, abstime);
+}
+
+int PthreadOriginals::pthread_cond_signal(pthread_cond_t* cond) {
+	if(_pthread_cond_signal == NULL) init_original(pthread_cond_signal, int (* volatile) (pthread_cond_t*));
+
+	return _pthread_cond_signal(cond);
+}
+
+int PthreadOriginals::pthread_cond_broadcast(pthread_cond_t* cond) {
+	if(_pthread_cond_broadcast == NULL) init_original(pthread_cond_broadcast, int (* volatile) (pthread_cond_t*));
+
+	return _pthread_cond_broadcast(cond);
+}
+
+int PthreadOriginals::pthread_rwlock_rdlock(pthread_rwlock_t* rwlock) {
+	if(_pthread_rwlock_rdlock == NULL) init_original(pthread_rwlock_rdlock, int (* volatile) (pthread_rwlock_t*));
+
+	return _pthread_rwlock_rdlock(rwlock);
+}
+
+int PthreadOriginals::pthread_rwlock_wrlock(pthread_rwlock_t* rwlock) {
+	if(_pthread_rwlock_wrlock == NULL) init_original(pthread_rwlock_wrlock, int (* volatile) (pthread_rwlock_t*));
+
+	return _pthread_rwlock_wrlock(rwlock);
+}
+
+int PthreadOriginals::pthread_rwlock_tryrdlock(pthread_rwlock_t* rwlock) {
+	if(_pthread_rwlock_tryrdlock == NULL) init_original(pthread_rwlock_tryrdlock, int (* volatile) (pthread_rwlock_t*));
+
+	return _pthread_rwlock_tryrdlock(rwlock);
+}
+
+int PthreadOriginals::pthread_rwlock_trywrlock(pthread_rwlock_t* rwlock) {
+	if(_pthread_rwlock_trywrlock == NULL) init_original(pthread_rwlock_trywrlock, int (* volatile) (pthread_rwlock_t*));
+
+	return _pthread_rwlock_trywrlock(rwlock);
+}
+
+int PthreadOriginals::pthread_rwlock_unlock(pthread_rwlock_t* rwlock) {
+	if(_pthread_rwlock_unlock == NULL) init_original(pthread_rwlock_unlock, int (* volatile) (pthread_rwlock_t*));
+
+	return _pthread_rwlock_unlock(rwlock);
+}
+
+int PthreadOriginals::pthread_barrier_wait(pthread_barrier_t* barrier) {
+	if(_pthread_barrier_wait == NULL) init_original(pthread_barrier_wait, int (* volatile) (pthread_barrier_t*));
+
+	return _pthread_barrier_wait(barrier);
+}
+
+int PthreadOriginals::sem_wait(sem_t* sem) {
+	if(_sem_wait == NULL) init_original(sem_wait, int (* volatile) (sem_t*));
+
+	return _sem_wait(sem);
+}
+
+int PthreadOriginals::sem_trywait(sem_t* sem) {
+	if(_sem_trywait == NULL) init_original(sem_trywait, int (* volatile) (sem_t*));
+
+	return _sem_trywait(sem);
+}
+
+int PthreadOriginals::sem_post(sem_t* sem) {
+	if(_sem_post == NULL) init_original(sem_post, int (* volatile) (sem_t*));
+
+	return _sem_post(sem);
+}
+
+int PthreadOriginals::sem_timedwait(sem_t* sem, const struct timespec* abstime) {
+	if(_sem_timedwait == NULL) init_original(sem_timedwait, int (* volatile) (sem_t*, const struct timespec*));
+
+	return _sem_timedwait(sem, abstime);
+}
+
+unsigned int PthreadOriginals::sleep(unsigned int seconds) {
+	if(_sleep == NULL) init_original(sleep, unsigned int (* volatile) (unsigned int));
+
+	return _sleep(seconds);
+}
+
+int PthreadOriginals::usleep(useconds_t usecs) {
+	if(_usleep == NULL) init_original(usleep, int (* volatile) (useconds_t));
+
+	return _usleep(usecs);
+}
+
+int PthreadOriginals::nanosleep(const struct timespec* req, struct timespec* rem) {
+	if(_nanosleep == NULL) init_original(nanosleep, int (* volatile) (const struct timespec*, struct timespec*));
+
+	return _nanosleep(req, rem);
+}
+
+int PthreadOriginals::gettimeofday(struct timeval* tv, void* tz) {
+	if(_gettimeofday == NULL) init_original(gettimeofday, int (* volatile) (struct timeval*, void*));
+
+	return _gettimeofday(tv, tz);
+}
+
+int PthreadOriginals::clock_gettime(clockid_t clk, struct timespec* tp) {
+	if(_clock_gettime == NULL) init_original(clock_gettime, int (* volatile) (clockid_t, struct timespec*));
+
+	return _clock_gettime(clk, tp);
+}
+
+/********************************************************************************/
+
+std::atomic<uint64_t> VirtualClock::now_(0);
+uint64_t VirtualClock::start_ = 0;
+
+void VirtualClock::Init() {
+	start_ = EpochSecs * NSecsPerSec;
+	now_ = start_;
+}
+
+void VirtualClock::AdvanceTo(uint64_t nsecs) {
+	uint64_t now = now_;
+	while(now < nsecs && !now_.compare_exchange_weak(now, nsecs)) {
+		// now is reloaded
+	}
+}
+
+bool VirtualClock::ToRealDeadline(const struct timespec* abstime, struct timespec* deadline) {
+	uint64_t vdeadline = FromTimespec(abstime);
+	uint64_t vnow = Now();
+
+	CHECK(PthreadOriginals::clock_gettime(CLOCK_REALTIME, deadline) == 0) << "Cannot read the real clock!";
+	if(vdeadline <= vnow) {
+		return false;
+	}
+
+	uint64_t wait = vdeadline - vnow;
+	if(wait > MaxRealWaitNSecs) wait = MaxRealWaitNSecs;
+	ToTimespec(FromTimespec(deadline) + wait, deadline);
+	return true;
+}
+
+/********************************************************************************/
+
 // we ensure that pthread calls that we interpose run atomically
 static Mutex concurrit_pthread_lock;
 
 int pthread_create(pthread_t* thread, const pthread_attr_t *attr, void *(*start_routine) (void *), void *arg) {
+	RuntimeScope rs;
 	ScopeMutex m(&concurrit_pthread_lock);
 	safe_assert(PthreadHandler::Current != NULL);
 	return PthreadHandler::Current->pthread_create(thread, attr, start_routine, arg);
 }
 int pthread_join(pthread_t thread, void ** value_ptr) {
+	RuntimeScope rs;
 	ScopeMutex m(&concurrit_pthread_lock);
 	safe_assert(PthreadHandler::Current != NULL);
 	return PthreadHandler::Current->pthread_join(thread, value_ptr);
 }
 void pthread_exit(void * param0) {
+	RuntimeScope rs;
 	ScopeMutex m(&concurrit_pthread_lock);
 	safe_assert(PthreadHandler::Current != NULL);
 	return PthreadHandler::Current->pthread_exit(param0);
 }
 int pthread_cancel(pthread_t thread) {
+	RuntimeScope rs;
 	ScopeMutex m(&concurrit_pthread_lock);
 	safe_assert(PthreadHandler::Current != NULL);
 	return PthreadHandler::Current->pthread_cancel(thread);
@@ -126,6 +321,127 @@ int pthread_cancel(pthread_t thread) {
 
 /********************************************************************************/
 
+// synchronization functions do not take concurrit_pthread_lock,
+// and until concurrit is initialized, they directly call the originals
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::pthread_mutex_lock(mutex);
+	}
+	return safe_notnull(PthreadHandler::Current)->pthread_mutex_lock(mutex);
+}
+int pthread_mutex_trylock(pthread_mutex_t* mutex) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::pthread_mutex_trylock(mutex);
+	}
+	return safe_notnull(PthreadHandler::Current)->pthread_mutex_trylock(mutex);
+}
+int pthread_mutex_unlock(pthread_mutex_t* mutex) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::pthread_mutex_unlock(mutex);
+	}
+	return safe_notnull(PthreadHandler::Current)->pthread_mutex_unlock(mutex);
+}
+int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::pthread_cond_wait(cond, mutex);
+	}
+	return safe_notnull(PthreadHandler::Current)->pthread_cond_wait(cond, mutex);
+}
+int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::pthread_cond_timedwait(cond, mutex, abstime);
+	}
+	return safe_notnull(PthreadHandler::Current)->pthread_cond_timedwait(cond, mutex, abstime);
+}
+int pthread_cond_signal(pthread_cond_t* cond) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::pthread_cond_signal(cond);
+	}
+	return safe_notnull(PthreadHandler::Current)->pthread_cond_signal(cond);
+}
+int pthread_cond_broadcast(pthread_cond_t* cond) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::pthread_cond_broadcast(cond);
+	}
+	return safe_notnull(PthreadHandler::Current)->pthread_cond_broadcast(cond);
+}
+int pthread_rwlock_rdlock(pthread_rwlock_t* rwlock) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::pthread_rwlock_rdlock(rwlock);
+	}
+	return safe_notnull(PthreadHandler::Current)->pthread_rwlock_rdlock(rwlock);
+}
+int pthread_rwlock_wrlock(pthread_rwlock_t* rwlock) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::pthread_rwlock_wrlock(rwlock);
+	}
+	return safe_notnull(PthreadHandler::Current)->pthread_rwlock_wrlock(rwlock);
+}
+int pthread_rwlock_unlock(pthread_rwlock_t* rwlock) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::pthread_rwlock_unlock(rwlock);
+	}
+	return safe_notnull(PthreadHandler::Current)->pthread_rwlock_unlock(rwlock);
+}
+int pthread_barrier_wait(pthread_barrier_t* barrier) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::pthread_barrier_wait(barrier);
+	}
+	return safe_notnull(PthreadHandler::Current)->pthread_barrier_wait(barrier);
+}
+int sem_wait(sem_t* sem) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::sem_wait(sem);
+	}
+	return safe_notnull(PthreadHandler::Current)->sem_wait(sem);
+}
+int sem_post(sem_t* sem) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::sem_post(sem);
+	}
+	return safe_notnull(PthreadHandler::Current)->sem_post(sem);
+}
+int sem_timedwait(sem_t* sem, const struct timespec* abstime) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::sem_timedwait(sem, abstime);
+	}
+	return safe_notnull(PthreadHandler::Current)->sem_timedwait(sem, abstime);
+}
+
+unsigned int sleep(unsigned int seconds) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::sleep(seconds);
+	}
+	return safe_notnull(PthreadHandler::Current)->sleep(seconds);
+}
+int usleep(useconds_t usecs) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::usleep(usecs);
+	}
+	return safe_notnull(PthreadHandler::Current)->usleep(usecs);
+}
+int nanosleep(const struct timespec* req, struct timespec* rem) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::nanosleep(req, rem);
+	}
+	return safe_notnull(PthreadHandler::Current)->nanosleep(req, rem);
+}
+int gettimeofday(struct timeval* tv, void* tz) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::gettimeofday(tv, tz);
+	}
+	return safe_notnull(PthreadHandler::Current)->gettimeofday(tv, tz);
+}
+int clock_gettime(clockid_t clk, struct timespec* tp) {
+	if(!Concurrit::IsInitialized()) {
+		return PthreadOriginals::clock_gettime(clk, tp);
+	}
+	return safe_notnull(PthreadHandler::Current)->clock_gettime(clk, tp);
+}
+
+/********************************************************************************/
+
 static PthreadHandler DefaultPthreadHandler;
 PthreadHandler* PthreadHandler::Current = &DefaultPthreadHandler;
 
@@ -151,6 +467,82 @@ int PthreadHandler::pthread_cancel(pthread_t thread) {
 	return PthreadOriginals::pthread_cancel(thread);
 }
 
+int PthreadHandler::pthread_mutex_lock(pthread_mutex_t* mutex) {
+	return PthreadOriginals::pthread_mutex_lock(mutex);
+}
+
+int PthreadHandler::pthread_mutex_trylock(pthread_mutex_t* mutex) {
+	return PthreadOriginals::pthread_mutex_trylock(mutex);
+}
+
+int PthreadHandler::pthread_mutex_unlock(pthread_mutex_t* mutex) {
+	return PthreadOriginals::pthread_mutex_unlock(mutex);
+}
+
+int PthreadHandler::pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex) {
+	return PthreadOriginals::pthread_cond_wait(cond, mutex);
+}
+
+int PthreadHandler::pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime) {
+	return PthreadOriginals::pthread_cond_timedwait(cond, mutex, abstime);
+}
+
+int PthreadHandler::pthread_cond_signal(pthread_cond_t* cond) {
+	return PthreadOriginals::pthread_cond_signal(cond);
+}
+
+int PthreadHandler::pthread_cond_broadcast(pthread_cond_t* cond) {
+	return PthreadOriginals::pthread_cond_broadcast(cond);
+}
+
+int PthreadHandler::pthread_rwlock_rdlock(pthread_rwlock_t* rwlock) {
+	return PthreadOriginals::pthread_rwlock_rdlock(rwlock);
+}
+
+int PthreadHandler::pthread_rwlock_wrlock(pthread_rwlock_t* rwlock) {
+	return PthreadOriginals::pthread_rwlock_wrlock(rwlock);
+}
+
+int PthreadHandler::pthread_rwlock_unlock(pthread_rwlock_t* rwlock) {
+	return PthreadOriginals::pthread_rwlock_unlock(rwlock);
+}
+
+int PthreadHandler::pthread_barrier_wait(pthread_barrier_t* barrier) {
+	return PthreadOriginals::pthread_barrier_wait(barrier);
+}
+
+int PthreadHandler::sem_wait(sem_t* sem) {
+	return PthreadOriginals::sem_wait(sem);
+}
+
+int PthreadHandler::sem_post(sem_t* sem) {
+	return PthreadOriginals::sem_post(sem);
+}
+
+int PthreadHandler::sem_timedwait(sem_t* sem, const struct timespec* abstime) {
+	return PthreadOriginals::sem_timedwait(sem, abstime);
+}
+
+unsigned int PthreadHandler::sleep(unsigned int seconds) {
+	return PthreadOriginals::sleep(seconds);
+}
+
+int PthreadHandler::usleep(useconds_t usecs) {
+	return PthreadOriginals::usleep(usecs);
+}
+
+int PthreadHandler::nanosleep(const struct timespec* req, struct timespec* rem) {
+	return PthreadOriginals::nanosleep(req, rem);
+}
+
+int PthreadHandler::gettimeofday(struct timeval* tv, void* tz) {
+	return PthreadOriginals::gettimeofday(tv, tz);
+}
+
+int PthreadHandler::clock_gettime(clockid_t clk, struct timespec* tp) {
+	return PthreadOriginals::clock_gettime(clk, tp);
+}
+
 /********************************************************************************/
 
 int ConcurritPthreadHandler::pthread_create(pthread_t* thread, const pthread_attr_t *attr, void *(*start_routine) (void *), void *arg) {
@@ -219,6 +611,375 @@ int ConcurritPthreadHandler::pthread_cancel(pthread_t thread) {
 
 /********************************************************************************/
 
+Coroutine* ConcurritPthreadHandler::TrackedThread() {
+	if(!PinMonitor::IsEnabled() || !PinMonitor::IsSyncTracked()) return NULL;
+
+	// skip the operations of concurrit's runtime and of threads outside of controlled transitions
+	Coroutine* current = Coroutine::CurrentOrNull();
+	if(current == NULL || !current->in_sut() || current->IsMain() || current->status() != ENABLED) return NULL;
+
+	return current;
+}
+
+void ConcurritPthreadHandler::OnSyncEvent(Coroutine* current, EventKind kind, void* addr) {
+	RuntimeScope rs;
+	Scenario* scenario = safe_notnull(Scenario::Current());
+	PinMonitor::SyncOp(current, scenario, kind, PTR2ADDRINT(addr));
+}
+
+// the thread is not enabled while it blocks in an original function, so it is not selected,
+// and main backtracks without waiting for the timeout when all threads block in untimed calls
+class NativeBlockScope {
+public:
+	explicit NativeBlockScope(Coroutine* current, uint64_t deadline = 0) : current_(current), status_(current->status()) {
+		current_->set_native_deadline(deadline);
+		current_->set_status(NATIVE_BLOCKED);
+	}
+	~NativeBlockScope() {
+		// a waiter woken by another thread continues at the time of the wakeup
+		current_->set_vtime(VirtualClock::Now());
+		// keep a status given by another thread while this one blocked, e.g., when the execution is ended
+		current_->cas_status(NATIVE_BLOCKED, status_);
+		current_->set_native_deadline(0);
+		safe_notnull(current_->group())->OnNativeWakeup();
+	}
+private:
+	Coroutine* current_;
+	StatusType status_;
+};
+
+/********************************************************************************/
+
+int ConcurritPthreadHandler::pthread_mutex_lock(pthread_mutex_t* mutex) {
+	Coroutine* current = TrackedThread();
+	if(current == NULL) {
+		return PthreadHandler::pthread_mutex_lock(mutex);
+	}
+
+	OnSyncEvent(current, SyncLock, mutex);
+
+	int result = PthreadOriginals::pthread_mutex_trylock(mutex);
+	if(result == EBUSY) {
+		NativeBlockScope b(current);
+		result = PthreadOriginals::pthread_mutex_lock(mutex);
+	}
+	return result;
+}
+
+int ConcurritPthreadHandler::pthread_mutex_trylock(pthread_mutex_t* mutex) {
+	Coroutine* current = TrackedThread();
+	int result = PthreadHandler::pthread_mutex_trylock(mutex);
+	// a failed trylock does not acquire the mutex, so it is not a lock event.
+	// the event of a successful one comes after the acquire, as the thread cannot block in it
+	if(current != NULL && result == 0) {
+		OnSyncEvent(current, SyncLock, mutex);
+	}
+	return result;
+}
+
+int ConcurritPthreadHandler::pthread_mutex_unlock(pthread_mutex_t* mutex) {
+	Coroutine* current = TrackedThread();
+	if(current != NULL) {
+		OnSyncEvent(current, SyncUnlock, mutex);
+	}
+	return PthreadHandler::pthread_mutex_unlock(mutex);
+}
+
+/********************************************************************************/
+
+int ConcurritPthreadHandler::pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex) {
+	Coroutine* current = TrackedThread();
+	if(current == NULL) {
+		return PthreadHandler::pthread_cond_wait(cond, mutex);
+	}
+
+	OnSyncEvent(current, SyncWait, cond);
+
+	NativeBlockScope b(current);
+	return PthreadOriginals::pthread_cond_wait(cond, mutex);
+}
+
+int ConcurritPthreadHandler::pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime) {
+	Coroutine* current = TrackedThread();
+	Coroutine* vcurrent = VirtualTimeThread();
+	if(current == NULL && vcurrent == NULL) {
+		return PthreadHandler::pthread_cond_timedwait(cond, mutex, abstime);
+	}
+
+	if(current != NULL) {
+		OnSyncEvent(current, SyncWait, cond);
+	}
+
+	if(vcurrent == NULL) {
+		NativeBlockScope b(current, VirtualClock::FromTimespec(abstime));
+		return PthreadOriginals::pthread_cond_timedwait(cond, mutex, abstime);
+	}
+
+	// the deadline is on the virtual clock, so wait for bounded real times until it passes.
+	// the virtual clock reads the same for all clocks, so abstime is compared the same whichever clock
+	// the condition was initialized with, and the real waits name CLOCK_REALTIME of the deadline explicitly
+	NativeBlockScope b(vcurrent, VirtualClock::FromTimespec(abstime));
+	bool idle = false;
+	unsigned progress = 0;
+	while(true) {
+		struct timespec deadline;
+		if(!VirtualClock::ToRealDeadline(abstime, &deadline)) {
+			return ETIMEDOUT;
+		}
+		int result = ::pthread_cond_clockwait(cond, mutex, CLOCK_REALTIME, &deadline);
+		if(result != ETIMEDOUT) {
+			return result;
+		}
+		OnRealWaitExpired(vcurrent, &idle, &progress);
+	}
+	unreachable();
+	return ETIMEDOUT;
+}
+
+int ConcurritPthreadHandler::pthread_cond_signal(pthread_cond_t* cond) {
+	Coroutine* current = TrackedThread();
+	if(current != NULL) {
+		OnSyncEvent(current, SyncSignal, cond);
+	}
+	return PthreadHandler::pthread_cond_signal(cond);
+}
+
+int ConcurritPthreadHandler::pthread_cond_broadcast(pthread_cond_t* cond) {
+	Coroutine* current = TrackedThread();
+	if(current != NULL) {
+		OnSyncEvent(current, SyncSignal, cond);
+	}
+	return PthreadHandler::pthread_cond_broadcast(cond);
+}
+
+/********************************************************************************/
+
+int ConcurritPthreadHandler::pthread_rwlock_rdlock(pthread_rwlock_t* rwlock) {
+	Coroutine* current = TrackedThread();
+	if(current == NULL) {
+		return PthreadHandler::pthread_rwlock_rdlock(rwlock);
+	}
+
+	OnSyncEvent(current, SyncLock, rwlock);
+
+	int result = PthreadOriginals::pthread_rwlock_tryrdlock(rwlock);
+	if(result == EBUSY || result == EAGAIN) {
+		NativeBlockScope b(current);
+		result = PthreadOriginals::pthread_rwlock_rdlock(rwlock);
+	}
+	return result;
+}
+
+int ConcurritPthreadHandler::pthread_rwlock_wrlock(pthread_rwlock_t* rwlock) {
+	Coroutine* current = TrackedThread();
+	if(current == NULL) {
+		return PthreadHandler::pthread_rwlock_wrlock(rwlock);
+	}
+
+	OnSyncEvent(current, SyncLock, rwlock);
+
+	int result = PthreadOriginals::pthread_rwlock_trywrlock(rwlock);
+	if(result == EBUSY) {
+		NativeBlockScope b(current);
+		result = PthreadOriginals::pthread_rwlock_wrlock(rwlock);
+	}
+	return result;
+}
+
+int ConcurritPthreadHandler::pthread_rwlock_unlock(pthread_rwlock_t* rwlock) {
+	Coroutine* current = TrackedThread();
+	if(current != NULL) {
+		OnSyncEvent(current, SyncUnlock, rwlock);
+	}
+	return PthreadHandler::pthread_rwlock_unlock(rwlock);
+}
+
+/********************************************************************************/
+
+int ConcurritPthreadHandler::pthread_barrier_wait(pthread_barrier_t* barrier) {
+	Coroutine* current = TrackedThread();
+	if(current == NULL) {
+		return PthreadHandler::pthread_barrier_wait(barrier);
+	}
+
+	OnSyncEvent(current, SyncWait, barrier);
+
+	NativeBlockScope b(current);
+	return PthreadOriginals::pthread_barrier_wait(barrier);
+}
+
+int ConcurritPthreadHandler::sem_wait(sem_t* sem) {
+	Coroutine* current = TrackedThread();
+	if(current == NULL) {
+		return PthreadHandler::sem_wait(sem);
+	}
+
+	OnSyncEvent(current, SyncWait, sem);
+
+	int result = PthreadOriginals::sem_trywait(sem);
+	if(result != 0 && errno == EAGAIN) {
+		NativeBlockScope b(current);
+		result = PthreadOriginals::sem_wait(sem);
+	}
+	return result;
+}
+
+int ConcurritPthreadHandler::sem_post(sem_t* sem) {
+	Coroutine* current = TrackedThread();
+	if(current != NULL) {
+		OnSyncEvent(current, SyncSignal, sem);
+	}
+	return PthreadHandler::sem_post(sem);
+}
+
+int ConcurritPthreadHandler::sem_timedwait(sem_t* sem, const struct timespec* abstime) {
+	Coroutine* current = TrackedThread();
+	Coroutine* vcurrent = VirtualTimeThread();
+	if(current == NULL && vcurrent == NULL) {
+		return PthreadHandler::sem_timedwait(sem, abstime);
+	}
+
+	if(current != NULL) {
+		OnSyncEvent(current, SyncWait, sem);
+	}
+
+	// an available semaphore is taken even if abstime has passed
+	int result = PthreadOriginals::sem_trywait(sem);
+	if(result == 0 || errno != EAGAIN) return result;
+
+	if(vcurrent == NULL) {
+		NativeBlockScope b(current, VirtualClock::FromTimespec(abstime));
+		return PthreadOriginals::sem_timedwait(sem, abstime);
+	}
+
+	NativeBlockScope b(vcurrent, VirtualClock::FromTimespec(abstime));
+	bool idle = false;
+	unsigned progress = 0;
+	while(true) {
+		struct timespec deadline;
+		if(!VirtualClock::ToRealDeadline(abstime, &deadline)) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		result = PthreadOriginals::sem_timedwait(sem, &deadline);
+		if(result == 0 || errno != ETIMEDOUT) {
+			return result;
+		}
+		OnRealWaitExpired(vcurrent, &idle, &progress);
+	}
+	unreachable();
+	return -1;
+}
+
+void ConcurritPthreadHandler::OnRealWaitExpired(Coroutine* current, bool* idle, unsigned* progress) {
+	// the real wait expiring is not a timeout, as another thread may still signal in virtual time;
+	// once no member runs, and none has returned from a blocking call or taken a transition meanwhile, no one can
+	CoroutineGroup* group = safe_notnull(current->group());
+	const unsigned p = group->native_wakeups() + safe_notnull(Scenario::Current())->exec_tree()->version();
+	const uint64_t deadline = group->GetIdleDeadline();
+	if(deadline == 0) {
+		*idle = false;
+	} else if(*idle && *progress == p) {
+		VirtualClock::AdvanceTo(deadline);
+		*idle = false;
+	} else {
+		*idle = true;
+		*progress = p;
+	}
+}
+
+/********************************************************************************/
+
+Coroutine* ConcurritPthreadHandler::VirtualTimeThread() {
+	if(!Config::VirtualTime || !PinMonitor::IsEnabled()) return NULL;
+
+	Coroutine* current = Coroutine::CurrentOrNull();
+	if(current == NULL || !current->in_sut() || current->IsMain()) return NULL;
+
+	return current;
+}
+
+// a sleep is a scheduling point only between controlled transitions
+void ConcurritPthreadHandler::OnSleep(Coroutine* current, uint64_t nsecs) {
+	current->set_vtime(VirtualClock::Advance(current->vtime(), nsecs));
+
+	if(current->status() == ENABLED) {
+		RuntimeScope rs;
+		Scenario* scenario = safe_notnull(Scenario::Current());
+		PinMonitor::Sleep(current, scenario, nsecs);
+	}
+}
+
+unsigned int ConcurritPthreadHandler::sleep(unsigned int seconds) {
+	Coroutine* current = VirtualTimeThread();
+	if(current == NULL) {
+		return PthreadHandler::sleep(seconds);
+	}
+
+	OnSleep(current, static_cast<uint64_t>(seconds) * VirtualClock::NSecsPerSec);
+	return 0;
+}
+
+int ConcurritPthreadHandler::usleep(useconds_t usecs) {
+	Coroutine* current = VirtualTimeThread();
+	if(current == NULL) {
+		return PthreadHandler::usleep(usecs);
+	}
+
+	OnSleep(current, static_cast<uint64_t>(usecs) * 1000ULL);
+	return 0;
+}
+
+int ConcurritPthreadHandler::nanosleep(const struct timespec* req, struct timespec* rem) {
+	Coroutine* current = VirtualTimeThread();
+	if(current == NULL) {
+		return PthreadHandler::nanosleep(req, rem);
+	}
+
+	if(req == NULL || req->tv_sec < 0 || req->tv_nsec < 0 || req->tv_nsec >= static_cast<long>(VirtualClock::NSecsPerSec)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	OnSleep(current, VirtualClock::FromTimespec(req));
+	if(rem != NULL) {
+		rem->tv_sec = 0;
+		rem->tv_nsec = 0;
+	}
+	return 0;
+}
+
+int ConcurritPthreadHandler::gettimeofday(struct timeval* tv, void* tz) {
+	Coroutine* current = VirtualTimeThread();
+	if(tv == NULL || current == NULL) {
+		return PthreadHandler::gettimeofday(tv, tz);
+	}
+
+	uint64_t now = VirtualClock::Tick();
+	current->set_vtime(now);
+	tv->tv_sec = static_cast<time_t>(now / VirtualClock::NSecsPerSec);
+	tv->tv_usec = static_cast<suseconds_t>((now % VirtualClock::NSecsPerSec) / 1000ULL);
+	// the timezone argument is obsolete, it is filled by the original function
+	struct timeval real;
+	return (tz == NULL) ? 0 : PthreadOriginals::gettimeofday(&real, tz);
+}
+
+int ConcurritPthreadHandler::clock_gettime(clockid_t clk, struct timespec* tp) {
+	bool is_wall_clock = (clk == CLOCK_REALTIME || clk == CLOCK_MONOTONIC || clk == CLOCK_MONOTONIC_RAW
+			|| clk == CLOCK_REALTIME_COARSE || clk == CLOCK_MONOTONIC_COARSE || clk == CLOCK_BOOTTIME);
+	Coroutine* current = VirtualTimeThread();
+	if(tp == NULL || !is_wall_clock || current == NULL) {
+		return PthreadHandler::clock_gettime(clk, tp);
+	}
+
+	uint64_t now = VirtualClock::Tick();
+	current->set_vtime(now);
+	VirtualClock::ToTimespec(now, tp);
+	return 0;
+}
+
+/********************************************************************************/
+
 
 } // end namespace
 
@@ -40,6 +40,10 @@ namespace concurrit {
 /********************************************************************************/
 
 void ConcurritInstrHandler::concurritStartTest() {
+	if(Config::IsStressMode()) {
+		PinMonitor::Enable();
+		return;
+	}
 	if(Config::RunUncontrolled) return;
 
 	MYLOG(1) << "concurritStartTest";
@@ -51,6 +55,10 @@ void ConcurritInstrHandler::concurritStartTest() {
 }
 
 void ConcurritInstrHandler::concurritEndTest() {
+	if(Config::IsStressMode()) {
+		PinMonitor::Disable();
+		return;
+	}
 	if(Config::RunUncontrolled) return;
 
 	MYLOG(1) << "concurritEndTest";
@@ -78,7 +86,7 @@ void ConcurritInstrHandler::concurritAddressOfSymbolEx(const char* symbol, uintp
 /********************************************************************************/
 
 void ConcurritInstrHandler::concurritStartInstrumentEx(const char* filename, const char* funcname, int line) {
-	if(!PinMonitor::IsEnabled() || Config::RunUncontrolled) return;
+	if(!PinMonitor::IsEnabled() || (Config::RunUncontrolled && !Config::IsStressMode())) return;
 
 	Coroutine* current = safe_notnull(Coroutine::Current());
 	if(filename != NULL) current->set_srcloc(new SourceLocation(filename, funcname, line));
@@ -89,7 +97,7 @@ void ConcurritInstrHandler::concurritStartInstrumentEx(const char* filename, con
 /********************************************************************************/
 
 void ConcurritInstrHandler::concurritEndInstrumentEx(const char* filename, const char* funcname, int line) {
-	if(!PinMonitor::IsEnabled() || Config::RunUncontrolled) return;
+	if(!PinMonitor::IsEnabled() || (Config::RunUncontrolled && !Config::IsStressMode())) return;
 
 	Coroutine* current = safe_notnull(Coroutine::Current());
 	if(filename != NULL) current->set_srcloc(new SourceLocation(filename, funcname, line));
@@ -44,7 +44,22 @@ PinToolOptions PinMonitor::options_ = {
 		TRUE, // TrackFuncCalls;
 		TRUE,  // InstrTopLevelFuncs
 		FALSE,  // InstrAfterMemoryAccess
+		0,  // GuardTable
+		~0U,  // InstrumentedKinds
+		FALSE,  // FilterUnsharedAccesses
+		0,  // WatchTable
+		FALSE,  // ResolveSourceLocations
+		TRUE,  // InstrumentFences
 };
+PinGuardTable PinMonitor::guards_ = { 0 };
+volatile unsigned PinMonitor::predicate_dependencies_ = AUXDEP_NONE;
+volatile unsigned PinMonitor::runahead_dependencies_ = AUXDEP_UNKNOWN;
+Mutex PinMonitor::options_mutex_;
+PinWatchSnapshot PinMonitor::watch_all_snapshot_ = { 1, 0, { 0 }, { { 0, 0 } } };
+PinWatchTable PinMonitor::watches_ = { &PinMonitor::watch_all_snapshot_ };
+std::vector<PinWatchRange> PinMonitor::watch_ranges_;
+std::vector<PinWatchSnapshot*> PinMonitor::retired_watches_;
+bool PinMonitor::watch_all_ = false;
 
 /********************************************************************************/
 
@@ -57,6 +72,15 @@ void PinMonitor::Init() {
 //	}
 	if(!down_) {
 		// init pin tool options, detected by Pin
+		ScopeMutex m(&options_mutex_);
+		options_.GuardTable = PTR2ADDRINT(&guards_);
+		options_.InstrumentedKinds = InstrumentedKinds(InstrumentedDependencies());
+		options_.InstrumentFences = InstrumentsFences(InstrumentedDependencies()) ? TRUE : FALSE;
+		options_.FilterUnsharedAccesses = Config::FilterUnsharedAccesses ? TRUE : FALSE;
+		options_.WatchTable = PTR2ADDRINT(&watches_);
+		// locations are shown only in execution traces
+		options_.ResolveSourceLocations = Config::SaveExecutionTraceToFile ? TRUE : FALSE;
+		PublishWatches();
 		InitPinTool(&PinMonitor::options_);
 	}
 }
@@ -96,14 +120,14 @@ void PinMonitor::Init() {
 /******************************************************************************************/
 
 void PinMonitor::Enable() {
-	if(!Config::RunUncontrolled) {
+	if(!Config::RunUncontrolled || Config::IsStressMode()) {
 		MYLOG(2) << ">>> Enabling instrumentation.";
 		if(Config::PinInstrEnabled && !down_) EnablePinTool();
 		enabled_ = true;
 	}
 }
 void PinMonitor::Disable() {
-	if(!Config::RunUncontrolled) {
+	if(!Config::RunUncontrolled || Config::IsStressMode()) {
 		MYLOG(2) << ">>> Disabling instrumentation.";
 		if(Config::PinInstrEnabled && !down_) DisablePinTool();
 		enabled_ = false;
@@ -129,6 +153,7 @@ void PinMonitor::AddressOfSymbol(const char* symbol, ADDRINT addr) {
 	safe_check(strnlen(symbol, 64) < 64);
 
 	symbol_to_address_[std::string(symbol)] = addr;
+	WatchAccesses(addr, 1);
 
 	MYLOG(1) << "Updated address of symbol " << symbol << " to " << ADDRINT2PTR(addr);
 }
@@ -143,12 +168,288 @@ ADDRINT PinMonitor::GetAddressOfSymbol(const std::string& symbol, ADDRINT addr /
 
 /********************************************************************************/
 
+static inline bool CoversRange(const std::vector<PinWatchRange>& ranges, ADDRINT begin, ADDRINT end) {
+	for(std::vector<PinWatchRange>::const_iterator itr = ranges.begin(); itr != ranges.end(); ++itr) {
+		if(itr->begin <= begin && end <= itr->end) return true;
+	}
+	return false;
+}
+
+void PinMonitor::WatchAccesses(ADDRINT addr, size_t size) {
+	if(!Config::WatchAccesses || watch_all_) return;
+	safe_assert(size > 0);
+
+	ScopeMutex m(&options_mutex_);
+	// predicates are created for every new node, so most ranges are already watched
+	if(CoversRange(watch_ranges_, addr, addr + size)) return;
+	PinWatchRange range = { addr, addr + size };
+	watch_ranges_.push_back(range);
+	PublishWatches();
+}
+
+void PinMonitor::WatchAllAccesses() {
+	if(!Config::WatchAccesses || watch_all_) return;
+
+	ScopeMutex m(&options_mutex_);
+	watch_all_ = true;
+	PublishWatches();
+}
+
+void PinMonitor::EndExecution() {
+	ScopeMutex m(&options_mutex_);
+	// the first execution has compiled the predicates of the test, later ones stop only at their events
+	if(runahead_dependencies_ != AUXDEP_NONE) {
+		runahead_dependencies_ = AUXDEP_NONE;
+		UpdateInstrumentation();
+	}
+	for(std::vector<PinWatchSnapshot*>::iterator itr = retired_watches_.begin(); itr != retired_watches_.end(); ++itr) {
+		free(*itr);
+	}
+	retired_watches_.clear();
+}
+
+static bool CompareWatchRanges(const PinWatchRange& r1, const PinWatchRange& r2) {
+	return r1.begin < r2.begin;
+}
+
+// sorts and merges the ranges into a new snapshot. the replaced snapshot may still be read,
+// so it is freed at the end of the execution
+void PinMonitor::PublishWatches() {
+	PinWatchSnapshot* old_snapshot = watches_.current;
+	if(old_snapshot != &watch_all_snapshot_) {
+		retired_watches_.push_back(old_snapshot);
+	}
+
+	if(!Config::WatchAccesses || watch_all_) {
+		__atomic_store_n(&watches_.current, &watch_all_snapshot_, __ATOMIC_RELEASE);
+		return;
+	}
+
+	std::sort(watch_ranges_.begin(), watch_ranges_.end(), CompareWatchRanges);
+	std::vector<PinWatchRange> merged;
+	for(std::vector<PinWatchRange>::iterator itr = watch_ranges_.begin(); itr != watch_ranges_.end(); ++itr) {
+		if(!merged.empty() && itr->begin <= merged.back().end) {
+			merged.back().end = std::max(merged.back().end, itr->end);
+		} else {
+			merged.push_back(*itr);
+		}
+	}
+	watch_ranges_.swap(merged);
+
+	const size_t n = watch_ranges_.size();
+	if(n > MaxWatchRanges) {
+		// too many ranges to keep snapshotting, and to search on each access
+		MYLOG(1) << "Watching all addresses instead of " << n << " address ranges";
+		watch_all_ = true;
+		watch_ranges_.clear();
+		__atomic_store_n(&watches_.current, &watch_all_snapshot_, __ATOMIC_RELEASE);
+		return;
+	}
+
+	PinWatchSnapshot* snapshot = static_cast<PinWatchSnapshot*>(calloc(1, sizeof(PinWatchSnapshot) + (n > 0 ? n - 1 : 0) * sizeof(PinWatchRange)));
+	safe_assert(snapshot != NULL);
+	snapshot->watch_all = 0;
+	snapshot->num_ranges = n;
+	for(size_t i = 0; i < n; ++i) {
+		const PinWatchRange& range = watch_ranges_[i];
+		snapshot->ranges[i] = range;
+		const ADDRINT first = range.begin >> PinWatchSnapshot::PageBits;
+		const ADDRINT last = (range.end - 1) >> PinWatchSnapshot::PageBits;
+		if(last - first >= PinWatchSnapshot::BloomBits) {
+			memset(snapshot->bloom, 0xFF, sizeof(snapshot->bloom));
+			continue;
+		}
+		for(ADDRINT page = first; page <= last; ++page) {
+			const uint32_t b = PinWatchSnapshot::BloomIndex(page);
+			snapshot->bloom[b / 64] |= (1ULL << (b % 64));
+		}
+	}
+	MYLOG(1) << "Watching " << n << " address ranges";
+	__atomic_store_n(&watches_.current, snapshot, __ATOMIC_RELEASE);
+}
+
+/********************************************************************************/
+
+void PinMonitor::OnSchedulingPoint(Coroutine* current, Scenario* scenario, EventKind kind) {
+	OnSchedulingPoint(current, scenario, kind, IsSchedulingPoint(kind));
+}
+
+void PinMonitor::OnSchedulingPoint(Coroutine* current, Scenario* scenario, EventKind kind, bool is_point) {
+	if(Config::IsStressMode()) {
+		InjectDelay(current);
+		// the transitions of the controlled engine, which a replay of the schedule with -q takes
+		if(is_point) {
+			scenario->OnStressTransition(current);
+		}
+		current->FinishControlledTransition();
+	} else if(is_point
+			|| (Config::RunAhead && AuxDependsOn(predicate_dependencies_ | runahead_dependencies_, AuxChangesOf(kind)))) {
+		scenario->OnControlledTransition(current, AuxUpdatesOf(kind));
+	} else {
+		// not a scheduling point, so run ahead until the next one
+		current->OnAuxChanges(AuxUpdatesOf(kind));
+		current->FinishControlledTransition();
+	}
+}
+
+/********************************************************************************/
+
+// FuncReturn also includes the updates done after its transition
+unsigned PinMonitor::AuxChangesOf(EventKind kind) {
+	switch(kind) {
+	case concurrit::MemAccessBefore:
+		return AUXDEP_READS | AUXDEP_WRITES;
+	case concurrit::MemRead:
+		return AUXDEP_READS;
+	case concurrit::MemWrite:
+		return AUXDEP_WRITES;
+	case concurrit::FuncCall:
+		return AUXDEP_CALLSFROM | AUXDEP_CALLSTO | AUXDEP_ARG0 | AUXDEP_ARG1;
+	case concurrit::FuncEnter:
+		return AUXDEP_ENTERS | AUXDEP_INFUNC | AUXDEP_NUMINFUNC | AUXDEP_ARG0 | AUXDEP_ARG1;
+	case concurrit::FuncReturn:
+		return AUXDEP_RETURNS | AUXDEP_RETVAL | AUXDEP_INFUNC | AUXDEP_ARG0 | AUXDEP_ARG1;
+	case concurrit::ThreadEnd:
+		return AUXDEP_ENDS;
+	case concurrit::AtPc:
+		return AUXDEP_PC | AUXDEP_ATPC;
+	case concurrit::SyncLock:
+		return AUXDEP_LOCKS;
+	case concurrit::SyncUnlock:
+		return AUXDEP_UNLOCKS;
+	case concurrit::SyncWait:
+		return AUXDEP_WAITS;
+	case concurrit::SyncSignal:
+		return AUXDEP_SIGNALS;
+	case concurrit::AtomicAccess:
+		return AUXDEP_READS | AUXDEP_WRITES | AUXDEP_ATOMICS;
+	case concurrit::Sleep:
+		return AUXDEP_SLEEPS;
+	default:
+		return AUXDEP_UNKNOWN;
+	}
+}
+
+unsigned PinMonitor::AuxUpdatesOf(EventKind kind) {
+	switch(kind) {
+	case concurrit::MemAccessBefore:
+		return AUXDEP_NONE;
+	case concurrit::AtomicAccess:
+		return AUXDEP_ATOMICS;
+	default:
+		return AuxChangesOf(kind);
+	}
+}
+
+/********************************************************************************/
+
+uint32_t PinMonitor::InstrumentedKinds(unsigned dependencies) {
+	if(!Config::ScopedInstrumentation || Config::IsStressMode() || Config::SaveExecutionTraceToFile) return ~0U;
+
+	// FuncEnter and FuncReturn are always instrumented, the pin tool keeps call stacks with them
+	static const EventKind kinds[] = { concurrit::MemAccessBefore, concurrit::MemRead, concurrit::MemWrite, concurrit::AtomicAccess, concurrit::FuncCall };
+	uint32_t instrumented = ~0U;
+	for(size_t i = 0; i < sizeof(kinds) / sizeof(EventKind); ++i) {
+		// MemRead and MemWrite only update the auxiliary state, MemAccessBefore is their scheduling point
+		bool is_scheduling_point = kinds[i] != concurrit::MemRead && kinds[i] != concurrit::MemWrite && IsSchedulingPoint(kinds[i]);
+		if(!is_scheduling_point && !AuxDependsOn(dependencies, AuxChangesOf(kinds[i]))) {
+			instrumented &= ~(1U << kinds[i]);
+		}
+	}
+	return instrumented;
+}
+
+/********************************************************************************/
+
+bool PinMonitor::InstrumentsFences(unsigned dependencies) {
+	if(Config::ScheduleFences || Config::SaveExecutionTraceToFile) return true;
+	// the dependencies of the predicates are tracked only for scoped instrumentation and run-ahead
+	if(!Config::ScopedInstrumentation && !Config::RunAhead) return true;
+	return AuxDependsOn(dependencies, AUXDEP_ATOMICS);
+}
+
+/********************************************************************************/
+
+void PinMonitor::OnPredicateCompiled(unsigned dependencies) {
+	if(!Config::ScopedInstrumentation && !Config::RunAhead) return;
+	// predicates are compiled for every new node, so return quickly if nothing is new
+	if((predicate_dependencies_ | dependencies) == predicate_dependencies_) return;
+
+	ScopeMutex m(&options_mutex_);
+	// set before the node of the predicate is published, so a thread waiting for the node stops at its events
+	__atomic_or_fetch(&predicate_dependencies_, dependencies, __ATOMIC_RELEASE);
+	UpdateInstrumentation();
+}
+
+// run-ahead stops at the events the predicates of later executions may depend on,
+// so those are instrumented too, which is every event in the first execution
+unsigned PinMonitor::InstrumentedDependencies() {
+	return Config::RunAhead ? (predicate_dependencies_ | runahead_dependencies_) : predicate_dependencies_;
+}
+
+void PinMonitor::UpdateInstrumentation() {
+	safe_assert(options_mutex_.IsLockedBySelf());
+	unsigned dependencies = InstrumentedDependencies();
+	uint32_t kinds = Config::ScopedInstrumentation ? InstrumentedKinds(dependencies) : options_.InstrumentedKinds;
+	uint32_t fences = InstrumentsFences(dependencies) ? TRUE : FALSE;
+	if(kinds != options_.InstrumentedKinds || fences != options_.InstrumentFences) {
+		MYLOG(1) << "Re-instrumenting for event kinds " << kinds << (fences ? " with fences" : "");
+		options_.InstrumentedKinds = kinds;
+		options_.InstrumentFences = fences;
+		// before Init, the options are sent by Init
+		if(options_.GuardTable != 0 && !down_) {
+			InitPinTool(&PinMonitor::options_);
+		}
+	}
+}
+
+/********************************************************************************/
+
+uint32_t PinMonitor::SkippableKinds(Coroutine* current, Scenario* scenario) {
+	if(!scenario->CanSkipControlledTransition(current)) return 0;
+	return SkippableKinds(current->last_taken_dependencies());
+}
+
+uint32_t PinMonitor::SkippableKinds(unsigned dependencies) {
+	// a stress execution and its replay see every scheduling point, and a trace every event
+	if(Config::IsStressMode() || Config::IsStressReplay() || Config::SaveExecutionTraceToFile) return 0;
+
+	static const EventKind kinds[] = { concurrit::MemAccessBefore, concurrit::MemRead, concurrit::MemWrite, concurrit::AtomicAccess, concurrit::FuncCall };
+
+	uint32_t skip_kinds = 0;
+	for(size_t i = 0; i < sizeof(kinds) / sizeof(EventKind); ++i) {
+		if(!AuxDependsOn(dependencies, AuxChangesOf(kinds[i]))) {
+			skip_kinds |= (1U << kinds[i]);
+		}
+	}
+	return skip_kinds;
+}
+
+/********************************************************************************/
+
+// stress mode: with probability StressDelayRate/1000, yields or sleeps for a random time.
+// the random stream of each thread depends only on the seed of the execution and the tid
+void PinMonitor::InjectDelay(Coroutine* current) {
+	unsigned int* state = current->stress_rand_state();
+	if((rand_r(state) % 1000) >= Config::StressDelayRate) return;
+
+	int r = rand_r(state);
+	if(r & 1) {
+		Thread::Yield(true);
+	} else {
+		long usecs = 1 + ((r >> 1) % Config::StressMaxDelayUSecs);
+		short_sleep(usecs * 1000, true);
+	}
+}
+
+/********************************************************************************/
+
 void PinMonitor::MemAccessBefore(Coroutine* current, Scenario* scenario, SourceLocation* loc /*= NULL*/) {
 	safe_assert(current != NULL && scenario != NULL);
 //	safe_assert(loc != NULL);
 
 	current->set_srcloc(loc);
-	scenario->OnControlledTransition(current);
+	OnSchedulingPoint(current, scenario, concurrit::MemAccessBefore);
 }
 
 /********************************************************************************/
@@ -167,6 +468,9 @@ void PinMonitor::MemWrite(Coroutine* current, Scenario* scenario, ADDRINT addr,
 	safe_assert(current != NULL && scenario != NULL);
 //	safe_assert(loc != NULL);
 
+	// no predicate refers to the address
+	if(!IsWatchedAccess(addr, size)) return;
+
 	if(Config::SaveExecutionTraceToFile) {
 		snprintf(current->instr_callback_info(), 256,
 				"MemWrite by %d to %lx size %d",
@@ -176,6 +480,7 @@ void PinMonitor::MemWrite(Coroutine* current, Scenario* scenario, ADDRINT addr,
 
 	// update auxstate
 	AuxState::Writes->set(addr, size, current->tid());
+	current->OnAuxChanges(AUXDEP_WRITES);
 
 	current->set_srcloc(loc);
 }
@@ -186,6 +491,9 @@ void PinMonitor::MemRead(Coroutine* current, Scenario* scenario, ADDRINT addr, u
 	safe_assert(current != NULL && scenario != NULL);
 //	safe_assert(loc != NULL);
 
+	// no predicate refers to the address
+	if(!IsWatchedAccess(addr, size)) return;
+
 	if(Config::SaveExecutionTraceToFile) {
 		snprintf(current->instr_callback_info(), 256,
 				"MemRead by %d from %lx size %d",
@@ -195,6 +503,7 @@ void PinMonitor::MemRead(Coroutine* current, Scenario* scenario, ADDRINT addr, u
 
 	// update auxstate
 	AuxState::Reads->set(addr, size, current->tid());
+	current->OnAuxChanges(AUXDEP_READS);
 
 	current->set_srcloc(loc);
 }
@@ -212,14 +521,14 @@ void PinMonitor::FuncCall(Coroutine* current, Scenario* scenario, ADDRINT addr_s
 	}
 
 	// update auxstate
-	AuxState::CallsFrom->set(addr_src, current->tid());
-	AuxState::CallsTo->set(addr_target, current->tid());
+	AuxState::CallsFrom->set(addr_src, true, current->tid());
+	AuxState::CallsTo->set(addr_target, true, current->tid());
 
 	AuxState::Arg0->set(addr_target, arg0, current->tid());
 	AuxState::Arg1->set(addr_target, arg1, current->tid());
 
 	current->set_srcloc(loc_src);
-	scenario->OnControlledTransition(current);
+	OnSchedulingPoint(current, scenario, concurrit::FuncCall);
 }
 
 /********************************************************************************/
@@ -250,7 +559,7 @@ void PinMonitor::FuncEnter(Coroutine* current, Scenario* scenario, ADDRINT addr,
 	AuxState::Arg1->set(addr, arg1, current->tid());
 
 	current->set_srcloc(loc);
-	scenario->OnControlledTransition(current);
+	OnSchedulingPoint(current, scenario, concurrit::FuncEnter);
 }
 
 /********************************************************************************/
@@ -272,7 +581,7 @@ void PinMonitor::FuncReturn(Coroutine* current, Scenario* scenario, ADDRINT addr
 	AuxState::RetVal->set(addr, retval, current->tid());
 
 	current->set_srcloc(loc);
-	scenario->OnControlledTransition(current);
+	OnSchedulingPoint(current, scenario, concurrit::FuncReturn);
 
 	int c = AuxState::InFunc->get(addr, current->tid());
 	safe_assert(c >= 0);
@@ -306,7 +615,7 @@ void PinMonitor::ThreadEnd(Coroutine* current, Scenario* scenario) {
 	AuxState::Ends->set(true, tid);
 	safe_assert(AuxState::Ends->isset(tid));
 
-	scenario->OnControlledTransition(current);
+	OnSchedulingPoint(current, scenario, concurrit::ThreadEnd);
 
 	safe_assert(AuxState::Ends->isset(tid));
 }
@@ -327,7 +636,86 @@ void PinMonitor::AtPc(Coroutine* current, Scenario* scenario, int pc, SourceLoca
 	AuxState::AtPc->set(true, current->tid());
 
 	current->set_srcloc(loc);
-	scenario->OnControlledTransition(current);
+	OnSchedulingPoint(current, scenario, concurrit::AtPc);
+}
+
+/********************************************************************************/
+
+// sent instead of MemAccessBefore, after the MemRead and MemWrite events of the instruction
+void PinMonitor::AtomicAccess(Coroutine* current, Scenario* scenario, ADDRINT addr, uint32_t size, SourceLocation* loc /*= NULL*/) {
+	safe_assert(current != NULL && scenario != NULL);
+
+	if(Config::SaveExecutionTraceToFile) {
+		if(addr == 0) {
+			snprintf(current->instr_callback_info(), 256,
+					"Fence by %d",
+					current->tid());
+		} else {
+			snprintf(current->instr_callback_info(), 256,
+					"AtomicAccess by %d to %lx size %d",
+					current->tid(), addr, size);
+		}
+		MYLOG(2) << "Calling pinmonitor " << current->instr_callback_info();
+	}
+
+	// update auxstate
+	AuxState::Atomics->set((addr == 0 ? AuxState::FenceKey : addr), true, current->tid());
+
+	current->set_srcloc(loc);
+	// fences are not scheduling points by default, only with -eatomic or when the pending node depends on them
+	OnSchedulingPoint(current, scenario, concurrit::AtomicAccess, IsSchedulingPoint(concurrit::AtomicAccess) && (addr != 0 || Config::ScheduleFences));
+}
+
+/********************************************************************************/
+
+void PinMonitor::Sleep(Coroutine* current, Scenario* scenario, uint64_t nsecs) {
+	safe_assert(current != NULL && scenario != NULL);
+
+	if(Config::SaveExecutionTraceToFile) {
+		snprintf(current->instr_callback_info(), 256,
+				"Sleep by %d for %lu nsecs",
+				current->tid(), nsecs);
+		MYLOG(2) << "Calling pinmonitor " << current->instr_callback_info();
+	}
+
+	// update auxstate
+	AuxState::Sleeps->set(true, current->tid());
+
+	OnSchedulingPoint(current, scenario, concurrit::Sleep);
+}
+
+/********************************************************************************/
+
+void PinMonitor::SyncOp(Coroutine* current, Scenario* scenario, EventKind kind, ADDRINT addr) {
+	safe_assert(current != NULL && scenario != NULL);
+
+	if(Config::SaveExecutionTraceToFile) {
+		snprintf(current->instr_callback_info(), 256,
+				"%s by %d on %lx",
+				EventKindToString(kind), current->tid(), addr);
+		MYLOG(2) << "Calling pinmonitor " << current->instr_callback_info();
+	}
+
+	// update auxstate
+	switch(kind) {
+	case concurrit::SyncLock:
+		AuxState::Locks->set(addr, true, current->tid());
+		break;
+	case concurrit::SyncUnlock:
+		AuxState::Unlocks->set(addr, true, current->tid());
+		break;
+	case concurrit::SyncWait:
+		AuxState::Waits->set(addr, true, current->tid());
+		break;
+	case concurrit::SyncSignal:
+		AuxState::Signals->set(addr, true, current->tid());
+		break;
+	default:
+		unreachable();
+		break;
+	}
+
+	OnSchedulingPoint(current, scenario, kind);
 }
 
 /********************************************************************************/
@@ -345,6 +733,11 @@ void CallPinMonitor(EventBuffer* event) {
 		return;
 	}
 
+	RuntimeScope rs;
+
+	// read before handling the event, so later changes invalidate the returned kinds
+	const uint32_t epoch = PinMonitor::GuardEpoch();
+
 //	Coroutine* current = safe_notnull(PinMonitor::GetCoroutineByTid(event->threadid));
 	Coroutine* current = safe_notnull(Coroutine::Current());
 	safe_assert(!current->IsMain());
@@ -378,10 +771,16 @@ void CallPinMonitor(EventBuffer* event) {
 		case AtPc:
 			PinMonitor::AtPc(current, scenario, event->pc, event->loc_src);
 			break;
+		case AtomicAccess:
+			PinMonitor::AtomicAccess(current, scenario, event->addr, event->size, event->loc_src);
+			break;
 		default:
 			safe_fail("Unrecognized event type: %d\n", event->type);
 			break;
 	}
+
+	event->skip_kinds = PinMonitor::SkippableKinds(current, scenario);
+	event->skip_epoch = epoch;
 }
 
 /********************************************************************************/
@@ -68,7 +68,11 @@ Scenario::Scenario(const char* name) {
 	TransitionAssertionsPtr q(new TransitionAssertions());
 	trans_assertions_ = q;
 
+	trans_dependencies_ = AUXDEP_NONE;
+
 	test_status_ = TEST_BEGIN;
+
+	stress_seed_ = 0;
 }
 
 /********************************************************************************/
@@ -157,7 +161,7 @@ ThreadVarPtr Scenario::CreateThread(THREADID tid, ThreadEntryFunction function,
 		// create a new thread
 		MYLOG(2) << SC_TITLE << "Creating new coroutine " << tid;
 		// create and add new thread
-		co = new Coroutine(tid, function, arg);
+		co = CoroutineGroup::NewMember(tid, function, arg);
 		group_.AddMember(co); // also sets the tid
 	} else {
 		MYLOG(2) << SC_TITLE << "Re-creating and restarting coroutine " << tid;
@@ -169,6 +173,7 @@ ThreadVarPtr Scenario::CreateThread(THREADID tid, ThreadEntryFunction function,
 	safe_assert(co->tid() > MAIN_TID);
 	// start it. in the usual case, waits until a transfer happens, or starts immediatelly depending ont he argument transfer_on_start
 	co->Start(pid, attr);
+	group_.IndexPThread(co);
 
 	return co->tvar();
 }
@@ -186,7 +191,7 @@ ThreadVarPtr Scenario::CreatePThread(ThreadEntryFunction function, void* arg /*=
 		// create a new thread
 		MYLOG(2) << SC_TITLE << "Creating new pthread coroutine.";
 		// create and add new thread
-		co = new Coroutine(-1, function, arg);
+		co = CoroutineGroup::NewMember(-1, function, arg);
 		group_.AddMember(co); // also sets the tid
 	} else {
 		MYLOG(2) << SC_TITLE << "Re-creating and restarting pthread coroutine " << co->tid();
@@ -198,6 +203,7 @@ ThreadVarPtr Scenario::CreatePThread(ThreadEntryFunction function, void* arg /*=
 	safe_assert(co != NULL && co->tid() > MAIN_TID);
 	// start it. in the usual case, waits until a transfer happens, or starts immediatelly depending ont he argument transfer_on_start
 	co->Start(pid, attr);
+	group_.IndexPThread(co);
 
 	MYLOG(2) << SC_TITLE << "Created new pthread coroutine " << co->tid();
 
@@ -432,13 +438,22 @@ ConcurritException* Scenario::RunOnce() throw() {
 
 	test_status_ = TEST_ENDED;
 
+	PredicateTable::EndExecution();
+	PinMonitor::EndExecution();
+
 	timer.stop();
 
 	avg_counter("Average time to explore each path").increment((long int)(timer.getElapsedTimeInMicroSec()));
 
 	avg_counter("Average memory usage (KB)").increment(Statistics::GetMemoryUsageInKB());
 
-	return CollectExceptions();
+	ConcurritException* exc = CollectExceptions();
+
+	if(Config::IsStressMode()) {
+		SaveStressExecution(exc != NULL && exc->get_backtrack() == NULL);
+	}
+
+	return exc;
 }
 
 /********************************************************************************/
@@ -513,8 +528,12 @@ void Scenario::RunTestCase() throw() {
 				// first wait for the TestStart event
 				WaitForTestStart();
 
-				// then run the actual test case
-				TestCase();
+				// then run the actual test case, or the saved schedule of a stress execution
+				if(Config::IsStressReplay()) {
+					ReplayStressSchedule();
+				} else {
+					TestCase();
+				}
 
 				MYLOG(2) << "TestCase ended!";
 			}
@@ -709,6 +728,9 @@ void Scenario::Start() {
 
 	test_status_ = TEST_BEGIN;
 
+	// each execution starts at the same virtual time
+	VirtualClock::Reset();
+
 //	test_end_sem_.Init(0);
 
 	// reset counters per execution
@@ -719,6 +741,12 @@ void Scenario::Start() {
 	fprintf(stderr, "\n\n---------------------------\n");
 	fprintf(stderr, "EXPLORING EXECUTION -- %d --\n\n", counter("Num Executions").value());
 
+	if(Config::IsStressMode()) {
+		// each execution gets its own seed, so a failing one can be rerun alone with -y
+		stress_seed_ = Config::StressSeed + counter("Num Executions").value() - 1;
+		stress_schedule_.clear();
+	}
+
 	if(schedule_ == NULL) {
 		schedule_ = new Schedule();
 	} else {
@@ -734,6 +762,7 @@ void Scenario::Start() {
 
 	trans_constraints_->clear();
 	trans_assertions_->clear();
+	UpdateTransitionConjunctions();
 
 	// open trace file
 	if(Config::SaveExecutionTraceToFile) {
@@ -757,6 +786,29 @@ void Scenario::Finish(Result* result) {
 	// finish timer
 	timer("Search time").stop();
 
+	// throughput of the search under the current affinity policy
+	double search_secs = timer("Search time").getElapsedTimeInSec();
+	if(search_secs > 0) {
+		Counter& eps = counter(format_string("Executions per second (affinity: %s)", AffinityPolicyToString(Config::AffinityPolicy)));
+		eps.reset();
+		eps.increment(static_cast<unsigned long>(counter("Num Executions").value() / search_secs));
+	}
+
+	Counter& interned = counter("Num interned predicates");
+	interned.reset();
+	interned.increment(PredicateTable::Size());
+
+	// saving of the adaptive operand order, measured on the sampled evaluations
+	Counter& declared = counter("Sampled cycles of and/or operands in declaration order");
+	declared.reset();
+	declared.increment(AdaptiveNAry::sampled_declared_cycles());
+	Counter& adaptive = counter("Sampled cycles of and/or operands in adaptive order");
+	adaptive.reset();
+	adaptive.increment(AdaptiveNAry::sampled_adaptive_cycles());
+	Counter& reorders = counter("Num reorders of and/or operands");
+	reorders.reset();
+	reorders.increment(AdaptiveNAry::num_reorders());
+
 	if(schedule_ != NULL) {
 		delete schedule_;
 		schedule_ = NULL;
@@ -826,6 +878,73 @@ void Scenario::SaveSearchInfo() {
 
 /********************************************************************************/
 
+void Scenario::OnStressTransition(Coroutine* current) {
+	ScopeMutex m(&stress_mutex_);
+	stress_schedule_.push_back(ScheduleItem(ScheduleItem_ThreadId, current->tid()));
+}
+
+/********************************************************************************/
+
+void Scenario::SaveStressExecution(bool failed) {
+	// one line per execution, so each execution can be rerun alone with its seed
+	static std::string stress_file_name = InConcurritWorkDir("stress.txt");
+	const int execution = counter("Num Executions").value();
+	FILE* stress_file = my_fopen(stress_file_name.c_str(), (execution == 1 ? "w" : "a"), EXIT_ON_FAIL);
+	fprintf(stress_file, "%d: -x%d -y%u%s\n", execution, Config::StressDelayRate, stress_seed_, (failed ? " failed" : ""));
+	my_fclose(stress_file, EXIT_ON_FAIL);
+
+	if(failed) {
+		// all threads have ended, so the schedule is complete
+		static std::string schedule_file_name = InConcurritWorkDir("stress_schedule.txt");
+		stress_schedule_.Serializable::Store(schedule_file_name.c_str());
+		fprintf(stderr, "Stress execution %d failed with -x%d -y%u, replay its %d transitions under control with -q%s\n",
+				execution, Config::StressDelayRate, stress_seed_, int(stress_schedule_.size()), schedule_file_name.c_str());
+	}
+}
+
+/********************************************************************************/
+
+// true for the transitions of the thread with the given tid, which need not exist yet when the predicate is created
+class TidTransitionPredicate : public TransitionPredicate {
+public:
+	explicit TidTransitionPredicate(THREADID tid) : TransitionPredicate(), tid_(tid) {}
+	~TidTransitionPredicate() {}
+
+	bool EvalState(Coroutine* t = NULL) {
+		return t != NULL && t->tid() == tid_;
+	}
+
+	std::string ToString() {
+		std::stringstream s;
+		s << "TID == " << tid_;
+		return s.str();
+	}
+
+private:
+	DECL_FIELD(THREADID, tid)
+};
+
+void Scenario::ReplayStressSchedule() {
+	static PersistentSchedule schedule;
+	if(schedule.empty()) {
+		schedule.Serializable::Load(Config::StressReplayFile);
+	}
+
+	MYLOG(1) << SC_TITLE << "Replaying " << schedule.size() << " stress transitions from " << Config::StressReplayFile;
+
+	// the tids match the stress execution, since threads are created in the same order when the schedule is followed
+	static StaticDSLInfo static_info(NULL, "REPLAY_STRESS_SCHEDULE");
+	for(PersistentSchedule::iterator itr = schedule.begin(); itr < schedule.end(); ++itr) {
+		safe_assert(itr->kind_ == ScheduleItem_ThreadId);
+		TransitionPredicatePtr pred(new TidTransitionPredicate(itr->value_));
+		DSLRunThrough(&static_info, pred);
+	}
+
+	MYLOG(1) << SC_TITLE << "Replayed the stress schedule, the threads continue uncontrolled";
+}
+
+/********************************************************************************/
+
 //TransferPoint* Scenario::OnYield(SchedulePoint* spoint, Coroutine* target) {
 //
 //	MYLOG(2) << SC_TITLE << "OnYield starting";
@@ -1489,6 +1608,16 @@ void Scenario::EvalSelectThread(Coroutine* current, SelectThreadNode* node, int&
 
 /********************************************************************************/
 
+void Scenario::UpdateTransitionConjunctions() {
+	constraints_.Update(trans_constraints_);
+	assertions_.Update(trans_assertions_);
+	trans_dependencies_ = constraints_.dependencies() | assertions_.dependencies();
+
+	exec_tree_.BumpVersion();
+}
+
+/********************************************************************************/
+
 void Scenario::EvalTransition(Coroutine* current, TransitionNode* node, int& child_index, bool& take) {
 	safe_assert(current != NULL && node != NULL);
 	safe_assert(child_index == -1 && take == false);
@@ -1496,19 +1625,26 @@ void Scenario::EvalTransition(Coroutine* current, TransitionNode* node, int& chi
 	// set current thread id
 	AuxState::Tid->set_thread(current);
 
+	PredicateProgram::TickSampleClock();
+
 	//==========================================//
 
+	// only the conjuncts whose inputs changed since the last transition of current are evaluated
+	const unsigned tree_version = exec_tree_.version();
+	int num_evals = 0;
+
 	// first check assertions
-	TransitionAssertionsPtr assertions = trans_assertions_;
-	if(assertions != NULL && !assertions->EvalState(current)) {
+	if(!assertions_.Eval(current, tree_version, &num_evals)) {
+		TransitionAssertionsPtr assertions = trans_assertions_;
 		TRIGGER_ASSERTION_VIOLATION(assertions->ToString().c_str(), "", "", 0);
 	}
 
 	//==========================================//
 
 	// then check constraints
-	TransitionConstraintsPtr constraints = trans_constraints_;
-	if(constraints != NULL && !constraints->EvalState(current)) {
+	const bool satisfied = constraints_.Eval(current, tree_version, &num_evals);
+	avg_counter("Conjuncts evaluated per transition").increment(num_evals);
+	if(!satisfied) {
 		return;
 	}
 
@@ -1518,10 +1654,9 @@ void Scenario::EvalTransition(Coroutine* current, TransitionNode* node, int& chi
 	if(runthrough != NULL) {
 
 		// now evaluate the actual predicate
-		TransitionPredicatePtr pred = runthrough->pred();
-		safe_assert(pred != NULL);
+		safe_assert(runthrough->pred() != NULL);
 
-		if(pred->EvalState(current)) {
+		if(runthrough->program()->Eval(current)) {
 			MYLOG(2) << "Will consume the current run-through";
 			child_index = 0;
 		}
@@ -1532,10 +1667,9 @@ void Scenario::EvalTransition(Coroutine* current, TransitionNode* node, int& chi
 		RunUntilNode* rununtil = ASINSTANCEOF(node, RunUntilNode*);
 		if(rununtil != NULL) {
 			// now evaluate the actual predicate
-			TransitionPredicatePtr pred = rununtil->pred();
-			safe_assert(pred != NULL);
+			safe_assert(rununtil->pred() != NULL);
 
-			if(pred->EvalState(current)) {
+			if(rununtil->program()->Eval(current)) {
 				MYLOG(2) << "Will consume the current run-until";
 				child_index = 0;
 				take = false;
@@ -1832,13 +1966,49 @@ void Scenario::EvalTransition(Coroutine* current, TransitionNode* node, int& chi
 
 /********************************************************************************/
 
+// the thread took the current node at its last controlled transition, and since then neither the node,
+// nor the thread variables and constraints, nor the auxiliary variables its predicates read have changed.
+// so evaluating the node again would give the same result, and the thread would take the node again.
+// only the auxiliary state of the current thread is tracked (see AuxDependencyOn)
+bool Scenario::CanSkipControlledTransition(Coroutine* current, unsigned changes) {
+	current->OnAuxChanges(changes);
+
+	return CanSkipControlledTransition(current);
+}
+
+bool Scenario::CanSkipControlledTransition(Coroutine* current) {
+	ExecutionTree* node = current->last_taken_node();
+	if(node == NULL) return false;
+
+	if(AuxDependsOn(current->last_taken_dependencies(), current->last_taken_changes() | current->aux_changes())
+		|| exec_tree_.version() != current->last_taken_version()
+		|| exec_tree_.PeekRef() != node) {
+		current->set_last_taken_node(NULL);
+		return false;
+	}
+	return true;
+}
+
+/********************************************************************************/
+
 // program state should be updated before this point
-void Scenario::OnControlledTransition(Coroutine* current) {
+void Scenario::OnControlledTransition(Coroutine* current, unsigned changes /*= AUXDEP_UNKNOWN*/) {
 	CHECK(!Config::RunUncontrolled) << "Hit a controlled transition in an uncontrolled run!";
 
 	// make thread blocked
 	if(current->status() != ENABLED) return;
 
+	if(CanSkipControlledTransition(current, changes)) {
+		counter("Num skipped transitions").increment();
+		current->FinishControlledTransition();
+		return;
+	}
+
+	// from now on, changes are all the changes since the last evaluated transition
+	changes = current->TakeAuxChanges();
+	constraints_.AddChanges(current->tid(), changes);
+	assertions_.AddChanges(current->tid(), changes);
+
 	MYLOG(2) << "Before controlled transition by " << current->tid();
 
 	current->StartControlledTransition();
@@ -1920,11 +2090,27 @@ void Scenario::OnControlledTransition(Coroutine* current) {
 			// in this case, we insert a new node to the path represented by newnode
 			node->OnConsumed(current, child_index);
 			node->condvar()->Broadcast();
-			exec_tree_.ReleaseRef(node, child_index);
+
+			// if the node is a step of a batch, publish the next step instead of returning to main
+			RunThroughNode* runthrough = ASINSTANCEOF(node, RunThroughNode*);
+			ExecutionTree* next = runthrough != NULL ? runthrough->NextStep() : NULL;
+			if(next != NULL) {
+				counter("Num batched steps").increment();
+			}
+			exec_tree_.ReleaseRef(node, child_index, next);
 
 		} else {
 			if(!take) {
 				node->mutex()->Lock();
+			} else if(trans != NULL) {
+				// remember the node, so the next transitions can skip it if its inputs do not change
+				unsigned dependencies = trans->program()->dependencies() | trans_dependencies_;
+				if(!AuxDependsOn(dependencies, changes)) {
+					current->set_last_taken_node(node);
+					current->set_last_taken_version(exec_tree_.version());
+					current->set_last_taken_dependencies(dependencies);
+					current->set_last_taken_changes(changes);
+				}
 			}
 
 			MYLOG(3) << "Releasing transition back";
@@ -2303,7 +2489,21 @@ void Scenario::DSLRunThrough(StaticDSLInfo* static_info, const TransitionPredica
 /********************************************************************************/
 
 void Scenario::DSLRunThrough(StaticDSLInfo* static_info, const TransitionPredicatePtr& pred, const ThreadVarPtr& var /*= ThreadVarPtr()*/, const char* message /*= NULL*/) {
+	DSLRunThroughN(static_info, pred, 1, var, message);
+}
+
+/********************************************************************************/
+
+void Scenario::DSLRunThroughN(StaticDSLInfo* static_info, const TransitionPredicatePtr& pred, int num_steps, const char* message /*= NULL*/) {
+	DSLRunThroughN(static_info, pred, num_steps, ThreadVarPtr(), message);
+}
+
+/********************************************************************************/
+
+// the n steps are consumed one after the other without main; main only waits until the last one is consumed
+void Scenario::DSLRunThroughN(StaticDSLInfo* static_info, const TransitionPredicatePtr& pred, int num_steps, const ThreadVarPtr& var /*= ThreadVarPtr()*/, const char* message /*= NULL*/) {
 	safe_assert(static_info != NULL);
+	safe_check(num_steps >= 1);
 	if(message != NULL) static_info->set_message(message);
 
 	MYLOG(2) << "Adding DSLRunThrough";
@@ -2350,6 +2550,7 @@ void Scenario::DSLRunThrough(StaticDSLInfo* static_info, const TransitionPredica
 	} else {
 		trans = new RunThroughNode(static_info, pred, var);
 	}
+	trans->set_num_steps(num_steps);
 
 	safe_assert(trans != NULL && !trans->covered());
 
@@ -2361,9 +2562,9 @@ void Scenario::DSLRunThrough(StaticDSLInfo* static_info, const TransitionPredica
 	exec_tree_.ReleaseRef(trans);
 
 	//=======================================================
-	// wait for the consumption
+	// wait for the consumption of all steps
 
-	node = exec_tree_.AcquireRefEx(EXIT_ON_EMPTY);
+	node = exec_tree_.AcquireRefEx(EXIT_ON_EMPTY, num_steps * Config::MaxWaitTimeUSecs);
 	safe_assert(node == NULL);
 	exec_tree_.ReleaseRef(NULL);
 
@@ -123,6 +123,8 @@ void* Thread::ThreadEntry(void* arg) {
 
 	Thread::SetCancellable();
 
+	Thread::SetAffinity(thread->tid());
+
 	ret_val = thread->Run();
 
 	// runs CleanupHandler
@@ -143,6 +145,128 @@ void Thread::SetCancellable() {
 	safe_assert(__pthread_errno__ == PTH_SUCCESS);
 }
 
+/********************************************************************************/
+
+// cpus the process may run on, in increasing order
+static std::vector<int> allowed_cpus;
+// mask shared by main and all controlled threads of this search
+static cpu_set_t search_cpu_set;
+
+// adds cpu and its allowed SMT siblings to cpu_set
+static void add_core(int cpu, const cpu_set_t* allowed, cpu_set_t* cpu_set) {
+	CPU_SET(cpu, cpu_set);
+	char path[128];
+	snprintf(path, 128, "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+	FILE* file = fopen(path, "r");
+	if(file != NULL) {
+		// format is either "0,4" or "0-1"
+		int first = -1, last = -1;
+		char sep = '\0';
+		while(fscanf(file, "%d%c", &first, &sep) >= 1) {
+			last = first;
+			if(sep == '-' && fscanf(file, "%d%c", &last, &sep) < 1) break;
+			for(int sibling = first; sibling <= last && sibling < CPU_SETSIZE; ++sibling) {
+				if(CPU_ISSET(sibling, allowed)) {
+					CPU_SET(sibling, cpu_set);
+				}
+			}
+			if(sep != ',' && sep != '-') break;
+		}
+		fclose(file);
+	}
+}
+
+// the first allowed cpu of each physical core, in increasing order
+static std::vector<int> allowed_cores(const cpu_set_t* allowed) {
+	std::vector<int> cores;
+	cpu_set_t seen;
+	CPU_ZERO(&seen);
+	for(size_t i = 0; i < allowed_cpus.size(); ++i) {
+		int cpu = allowed_cpus[i];
+		if(CPU_ISSET(cpu, &seen)) continue; // an SMT sibling of an earlier core
+		cores.push_back(cpu);
+		add_core(cpu, allowed, &seen);
+	}
+	return cores;
+}
+
+// claims the first core no other running search worker holds, by locking a file per core in the work directory.
+// the lock is released when the process exits. returns -1 if all cores are taken
+static int claim_core(size_t num_cores) {
+	for(size_t index = 0; index < num_cores; ++index) {
+		char name[64];
+		snprintf(name, 64, "core%zu.lock", index);
+		std::string path = InConcurritWorkDir(name);
+		int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+		if(fd < 0) {
+			MYLOG(1) << "Could not open " << path << ": " << strerror(errno);
+			return -1;
+		}
+		if(flock(fd, LOCK_EX | LOCK_NB) == 0) {
+			return int(index); // fd stays open to hold the lock
+		}
+		close(fd);
+	}
+	return -1;
+}
+
+static void init_search_cpu_set() {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if(sched_getaffinity(0, sizeof(cpu_set_t), &set) != 0) {
+		safe_fail("sched_getaffinity failed: %s\n", strerror(errno));
+	}
+	for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+		if(CPU_ISSET(cpu, &set)) {
+			allowed_cpus.push_back(cpu);
+		}
+	}
+	safe_assert(!allowed_cpus.empty());
+
+	// compact: the search runs on the first allowed core
+	// spread: each search worker runs on its own physical core, chosen by its worker index,
+	// or else the first core no other worker has claimed
+	std::vector<int> cores = allowed_cores(&set);
+	size_t index = 0;
+	if(Config::AffinityPolicy == AFFINITY_SPREAD) {
+		if(Config::AffinityWorkerIndex >= 0) {
+			index = size_t(Config::AffinityWorkerIndex);
+		} else {
+			int claimed = claim_core(cores.size());
+			if(claimed < 0) {
+				MYLOG(1) << "All " << cores.size() << " cores are claimed by other search workers, sharing one by process id";
+				claimed = int(getpid() % cores.size());
+			}
+			index = size_t(claimed);
+		}
+		if(index >= cores.size()) {
+			MYLOG(1) << "Worker index " << index << " exceeds the " << cores.size() << " allowed cores, sharing one";
+			index %= cores.size();
+		}
+	}
+	CPU_ZERO(&search_cpu_set);
+	add_core(cores[index], &set, &search_cpu_set);
+}
+
+// called by each controlled thread (and main) when it starts
+// all threads of one search share one core, so they hand control back and forth without moving cache lines
+void Thread::SetAffinity(THREADID tid) {
+	if(Config::AffinityPolicy == AFFINITY_NONE) return;
+
+	// main calls this first, before any controlled thread starts
+	if(allowed_cpus.empty()) {
+		init_search_cpu_set();
+	}
+
+	__pthread_errno__ = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &search_cpu_set);
+	if(__pthread_errno__ != PTH_SUCCESS) {
+		MYLOG(1) << "Could not set affinity of thread " << tid << ": " << PTHResultToString(__pthread_errno__);
+		__pthread_errno__ = PTH_SUCCESS;
+	}
+}
+
+/********************************************************************************/
+
 void Thread::attach_pthread(pthread_t self) {
 	safe_assert(pthread_ == self || pthread_ == PTH_INVALID_THREAD);
 
@@ -195,7 +319,11 @@ void Thread::Start(pthread_t* pid /*= NULL*/, const pthread_attr_t* attr /*= NUL
 	pthread_attr_t attr_local;
 	if(attr_ptr == NULL && stack_size_ > 0) {
 		pthread_attr_init(&attr_local);
-		pthread_attr_setstacksize(&attr_local, static_cast<size_t>(stack_size_));
+		size_t stack_size = static_cast<size_t>(stack_size_);
+		if(stack_size < static_cast<size_t>(PTHREAD_STACK_MIN)) {
+			stack_size = static_cast<size_t>(PTHREAD_STACK_MIN);
+		}
+		pthread_attr_setstacksize(&attr_local, stack_size);
 		attr_ptr = &attr_local;
 	}
 	return_value_ = NULL;
@@ -36,75 +36,100 @@
 namespace concurrit {
 
 
-boost::shared_ptr<AuxVar0<bool, false>> AuxState::Ends;
+boost::intrusive_ptr<AuxVar0<bool, false>> AuxState::Ends;
 
-boost::shared_ptr<AuxVar1<ADDRINT, uint32_t, 0, 0>> AuxState::Reads;
-boost::shared_ptr<AuxVar1<ADDRINT, uint32_t, 0, 0>> AuxState::Writes;
+boost::intrusive_ptr<AuxVar1<ADDRINT, uint32_t, 0, 0>> AuxState::Reads;
+boost::intrusive_ptr<AuxVar1<ADDRINT, uint32_t, 0, 0>> AuxState::Writes;
 
-boost::shared_ptr<AuxVar1<ADDRINT, bool, 0, false>> AuxState::CallsFrom;
-boost::shared_ptr<AuxVar1<ADDRINT, bool, 0, false>> AuxState::CallsTo;
+boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> AuxState::CallsFrom;
+boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> AuxState::CallsTo;
 
-boost::shared_ptr<AuxVar1<ADDRINT, bool, 0, false>> AuxState::Enters;
-boost::shared_ptr<AuxVar1<ADDRINT, bool, 0, false>> AuxState::Returns;
+boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> AuxState::Enters;
+boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> AuxState::Returns;
 
-boost::shared_ptr<AuxVar1<ADDRINT, int, 0, 0>> AuxState::InFunc;
-boost::shared_ptr<AuxVar1<ADDRINT, int, 0, 0>> AuxState::NumInFunc;
+boost::intrusive_ptr<AuxVar1<ADDRINT, int, 0, 0>> AuxState::InFunc;
+boost::intrusive_ptr<AuxVar1<ADDRINT, int, 0, 0>> AuxState::NumInFunc;
 
-boost::shared_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> AuxState::Arg0;
-boost::shared_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> AuxState::Arg1;
+boost::intrusive_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> AuxState::Arg0;
+boost::intrusive_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> AuxState::Arg1;
 
-boost::shared_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> AuxState::RetVal;
+boost::intrusive_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> AuxState::RetVal;
 
-boost::shared_ptr<AuxVar0<int, -1>> AuxState::Pc;
-boost::shared_ptr<AuxVar0<bool, false>> AuxState::AtPc;
+boost::intrusive_ptr<AuxVar0<int, -1>> AuxState::Pc;
+boost::intrusive_ptr<AuxVar0<bool, false>> AuxState::AtPc;
+boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> AuxState::Locks;
+boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> AuxState::Unlocks;
+boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> AuxState::Waits;
+boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> AuxState::Signals;
+boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> AuxState::Atomics;
+const ADDRINT AuxState::FenceKey;
+boost::intrusive_ptr<AuxVar0<bool, false>> AuxState::Sleeps;
 
 ThreadVarPtr AuxState::Tid;
 
 /*************************************************************************************/
 
 void AuxState::Init() {
-	boost::shared_ptr<AuxVar0<bool, false>> _ends(new StaticAuxVar0<bool, false>("Ends"));
+	boost::intrusive_ptr<AuxVar0<bool, false>> _ends(new StaticAuxVar0<bool, false>("Ends", AUXDEP_ENDS));
 	AuxState::Ends = _ends;
 
-	boost::shared_ptr<AuxVar1<ADDRINT, uint32_t, 0, 0>> _reads(new StaticAuxVar1<ADDRINT, uint32_t, 0, false>("Reads"));
+	boost::intrusive_ptr<AuxVar1<ADDRINT, uint32_t, 0, 0>> _reads(new StaticAuxVar1<ADDRINT, uint32_t, 0, false>("Reads", AUXDEP_READS));
 	AuxState::Reads = _reads;
 
-	boost::shared_ptr<AuxVar1<ADDRINT, uint32_t, 0, 0>> _writes(new StaticAuxVar1<ADDRINT, uint32_t, 0, false>("Writes"));
+	boost::intrusive_ptr<AuxVar1<ADDRINT, uint32_t, 0, 0>> _writes(new StaticAuxVar1<ADDRINT, uint32_t, 0, false>("Writes", AUXDEP_WRITES));
 	AuxState::Writes = _writes;
 
-	boost::shared_ptr<AuxVar1<ADDRINT, bool, 0, false>> _callsfrom(new StaticAuxVar1<ADDRINT, bool, 0, false>("CallsFrom"));
+	boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> _callsfrom(new StaticAuxVar1<ADDRINT, bool, 0, false>("CallsFrom", AUXDEP_CALLSFROM));
 	AuxState::CallsFrom = _callsfrom;
 
-	boost::shared_ptr<AuxVar1<ADDRINT, bool, 0, false>> _callsto(new StaticAuxVar1<ADDRINT, bool, 0, false>("CallsTo"));
+	boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> _callsto(new StaticAuxVar1<ADDRINT, bool, 0, false>("CallsTo", AUXDEP_CALLSTO));
 	AuxState::CallsTo = _callsto;
 
-	boost::shared_ptr<AuxVar1<ADDRINT, bool, 0, false>> _enters(new StaticAuxVar1<ADDRINT, bool, 0, false>("Enters"));
+	boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> _enters(new StaticAuxVar1<ADDRINT, bool, 0, false>("Enters", AUXDEP_ENTERS));
 	AuxState::Enters = _enters;
 
-	boost::shared_ptr<AuxVar1<ADDRINT, bool, 0, false>> _returns(new StaticAuxVar1<ADDRINT, bool, 0, false>("Returns"));
+	boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> _returns(new StaticAuxVar1<ADDRINT, bool, 0, false>("Returns", AUXDEP_RETURNS));
 	AuxState::Returns = _returns;
 
-	boost::shared_ptr<AuxVar1<ADDRINT, int, 0, 0>> _infunc(new StaticAuxVar1<ADDRINT, int, 0, 0>("InFunc"));
+	boost::intrusive_ptr<AuxVar1<ADDRINT, int, 0, 0>> _infunc(new StaticAuxVar1<ADDRINT, int, 0, 0>("InFunc", AUXDEP_INFUNC));
 	AuxState::InFunc = _infunc;
 
-	boost::shared_ptr<AuxVar1<ADDRINT, int, 0, 0>> _numinfunc(new StaticAuxVar1<ADDRINT, int, 0, 0>("NumInFunc"));
+	boost::intrusive_ptr<AuxVar1<ADDRINT, int, 0, 0>> _numinfunc(new StaticAuxVar1<ADDRINT, int, 0, 0>("NumInFunc", AUXDEP_NUMINFUNC));
 	AuxState::NumInFunc = _numinfunc;
 
-	boost::shared_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> _arg0(new StaticAuxVar1<ADDRINT, ADDRINT, 0, 0>("Arg0"));
+	boost::intrusive_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> _arg0(new StaticAuxVar1<ADDRINT, ADDRINT, 0, 0>("Arg0", AUXDEP_ARG0));
 	AuxState::Arg0 = _arg0;
 
-	boost::shared_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> _arg1(new StaticAuxVar1<ADDRINT, ADDRINT, 0, 0>("Arg1"));
+	boost::intrusive_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> _arg1(new StaticAuxVar1<ADDRINT, ADDRINT, 0, 0>("Arg1", AUXDEP_ARG1));
 	AuxState::Arg1 = _arg1;
 
-	boost::shared_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> _retval(new StaticAuxVar1<ADDRINT, ADDRINT, 0, 0>("RetVal"));
+	boost::intrusive_ptr<AuxVar1<ADDRINT, ADDRINT, 0, 0>> _retval(new StaticAuxVar1<ADDRINT, ADDRINT, 0, 0>("RetVal", AUXDEP_RETVAL));
 	AuxState::RetVal = _retval;
 
-	boost::shared_ptr<AuxVar0<int, -1>> _pc(new StaticAuxVar0<int, -1>("Pc"));
+	boost::intrusive_ptr<AuxVar0<int, -1>> _pc(new StaticAuxVar0<int, -1>("Pc", AUXDEP_PC));
 	AuxState::Pc = _pc;
 
-	boost::shared_ptr<AuxVar0<bool, false>> _atpc(new StaticAuxVar0<bool, false>("AtPc"));
+	boost::intrusive_ptr<AuxVar0<bool, false>> _atpc(new StaticAuxVar0<bool, false>("AtPc", AUXDEP_ATPC));
 	AuxState::AtPc = _atpc;
 
+	boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> _locks(new StaticAuxVar1<ADDRINT, bool, 0, false>("Locks", AUXDEP_LOCKS));
+	AuxState::Locks = _locks;
+
+	boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> _unlocks(new StaticAuxVar1<ADDRINT, bool, 0, false>("Unlocks", AUXDEP_UNLOCKS));
+	AuxState::Unlocks = _unlocks;
+
+	boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> _waits(new StaticAuxVar1<ADDRINT, bool, 0, false>("Waits", AUXDEP_WAITS));
+	AuxState::Waits = _waits;
+
+	boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> _signals(new StaticAuxVar1<ADDRINT, bool, 0, false>("Signals", AUXDEP_SIGNALS));
+	AuxState::Signals = _signals;
+
+	boost::intrusive_ptr<AuxVar1<ADDRINT, bool, 0, false>> _atomics(new StaticAuxVar1<ADDRINT, bool, 0, false>("Atomics", AUXDEP_ATOMICS));
+	AuxState::Atomics = _atomics;
+
+	boost::intrusive_ptr<AuxVar0<bool, false>> _sleeps(new StaticAuxVar0<bool, false>("Sleeps", AUXDEP_SLEEPS));
+	AuxState::Sleeps = _sleeps;
+
 	ThreadVarPtr _tid(new StaticThreadVar(NULL, "TID"));
 	AuxState::Tid = _tid;
 }
@@ -122,6 +147,15 @@ void AuxState::Reset(THREADID t /*= -1*/) {
 	Returns->reset(t);
 
 	AtPc->reset(t);
+
+	Locks->reset(t);
+	Unlocks->reset(t);
+	Waits->reset(t);
+	Signals->reset(t);
+
+	Atomics->reset(t);
+
+	Sleeps->reset(t);
 }
 
 /*************************************************************************************/
@@ -141,6 +175,15 @@ void AuxState::Clear() {
 	Pc->clear();
 	AtPc->clear();
 
+	Locks->clear();
+	Unlocks->clear();
+	Waits->clear();
+	Signals->clear();
+
+	Atomics->clear();
+
+	Sleeps->clear();
+
 	InFunc->clear();
 	NumInFunc->clear();
 
@@ -158,26 +201,665 @@ void AuxState::Clear() {
 static TransitionPredicatePtr __true_transition_predicate__(new TrueTransitionPredicate());
 static TransitionPredicatePtr __false_transition_predicate__(new FalseTransitionPredicate());
 
-TransitionPredicatePtr TransitionPredicate::True() { return __true_transition_predicate__; }
-TransitionPredicatePtr TransitionPredicate::False() { return __false_transition_predicate__; }
+const TransitionPredicatePtr& TransitionPredicate::True() { return __true_transition_predicate__; }
+const TransitionPredicatePtr& TransitionPredicate::False() { return __false_transition_predicate__; }
+
+void TransitionPredicate::Compile(PredicateProgram* program) {
+	program->EmitCall(this);
+}
+
+/*************************************************************************************/
+
+void PredicateProgram::Compile(const TransitionPredicatePtr& pred) {
+	safe_assert(pred != NULL);
+	code_.clear();
+	value_ = true;
+	dependencies_ = AUXDEP_NONE;
+	pure_ = true;
+	adaptive_.reset();
+	root_ = pred.get();
+	tree_ = NULL;
+	entry_ = PREDPC_UNLINKED;
+	calibration_.left = 0;
+	pred->Compile(this);
+	Link();
+	epoch_ = sample_epoch_;
+	if(code_.size() == 1 && (code_[0].op == PREDOP_CALL || code_[0].op == PREDOP_FUNCTION)) {
+		// a lone call gains nothing from the loop
+		tree_ = root_;
+	} else
+	if(!code_.empty()) {
+		// the first evaluation of each form warms it up
+		calibration_.left = 2 * CalibrationSamples + 2;
+		for(int i = 0; i < 2; ++i) {
+			calibration_.cycles[i] = 0;
+			calibration_.samples[i] = 0;
+		}
+		// not sampled in the current epoch, so calibrated from the next evaluation on
+		epoch_ = sample_epoch_ - 1;
+	}
+	PinMonitor::OnPredicateCompiled(dependencies_);
+}
+
+/*************************************************************************************/
+
+static inline uint64_t ReadCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+unsigned long PredicateProgram::sample_epoch_ = 0;
+long PredicateProgram::until_tick_ = 0;
+uint32_t PredicateProgram::jitter_ = 2463534242U;
+
+// xorshift32, used only by the thread evaluating a transition
+uint32_t PredicateProgram::NextJitter() {
+	jitter_ ^= jitter_ << 13;
+	jitter_ ^= jitter_ >> 17;
+	jitter_ ^= jitter_ << 5;
+	return jitter_;
+}
+
+// the period is drawn from [rate/2, 3*rate/2), so that samples do not keep falling on the
+// same thread when the threads take transitions in turns
+void PredicateProgram::AdvanceSampleClock() {
+	if(Config::AdaptiveSampleRate <= 0) {
+		until_tick_ = LONG_MAX;
+		return;
+	}
+	until_tick_ = Config::AdaptiveSampleRate / 2 + 1 + static_cast<long>(NextJitter() % static_cast<uint32_t>(Config::AdaptiveSampleRate));
+	++sample_epoch_;
+}
+
+// the first evaluation in a new epoch of the sample clock
+bool PredicateProgram::EvalCode(Coroutine* t) {
+	if(calibration_.left > 0) {
+		return Calibrate(t);
+	}
+	return SampleCode(t);
+}
+
+// samples over MaxCalibrationCycles were interrupted, so they are dropped
+static const uint64_t MaxCalibrationCycles = 2000;
+// the code must take less than 7/8 of the cycles of the tree
+static const double CalibrationMargin = 0.875;
+
+// a pure program is evaluated CalibrationRepeats times per sample, timing one evaluation mostly
+// measures reading the counter
+static const int CalibrationRepeats = 16;
+
+// the code is not faster than the tree when the instructions save no work over the virtual calls,
+// e.g., for thread expressions. the code runs in the declared order, without adaptive_ sampling it.
+// calibration_ is updated only by the thread evaluating the transition
+bool PredicateProgram::Calibrate(Coroutine* t) {
+	// the form is drawn at random, alternating would give each form every other thread
+	const int by_tree = NextJitter() & 1;
+	--calibration_.left;
+	const int repeats = pure_ ? CalibrationRepeats : 1;
+	bool value = false;
+	const uint64_t start = ReadCycleCounter();
+	for(int i = 0; i < repeats; ++i) {
+		value = by_tree ? root_->EvalState(t) : RunLoop(t);
+	}
+	const uint64_t cycles = (ReadCycleCounter() - start) / repeats;
+	if(calibration_.left < 2 * CalibrationSamples && cycles < MaxCalibrationCycles) {
+		calibration_.cycles[by_tree] += cycles;
+		calibration_.samples[by_tree] += 1;
+	}
+	if(calibration_.left == 0) {
+		// compare the averages, the code is kept only if it is clearly faster,
+		// since the samples do not include the clock check in Eval
+		const double code_cycles = static_cast<double>(calibration_.cycles[0]) * calibration_.samples[1];
+		const double tree_cycles = static_cast<double>(calibration_.cycles[1]) * calibration_.samples[0];
+		if(tree_cycles * CalibrationMargin < code_cycles) {
+			tree_ = root_;
+		}
+		epoch_ = sample_epoch_;
+	}
+	return value;
+}
+
+bool PredicateProgram::SampleCode(Coroutine* t) {
+	epoch_ = sample_epoch_;
+	if(adaptive_ == NULL) {
+		return RunLoop(t);
+	}
+	bool value;
+	if(adaptive_->Sample(t, this, &value)) {
+		return value;
+	}
+	return RunLoop(t);
+}
+
+bool PredicateProgram::RunLoop(Coroutine* t) {
+	safe_assert(entry_ != PREDPC_UNLINKED);
+	const PredicateInstr* code = code_.empty() ? NULL : &code_[0];
+	int pc = entry_;
+	while(pc >= 0) {
+		const PredicateInstr& instr = code[pc];
+		// tested in order of frequency, conditional branches predict better than a jump table
+		bool acc;
+		if(instr.op == PREDOP_AUX) {
+			acc = instr.aux_fn(instr.aux_arg, instr.tvar1 == NULL ? safe_notnull(t)->tid() : safe_notnull(instr.tvar1->thread())->tid());
+		} else
+		if(instr.op == PREDOP_TVARS_EQ || instr.op == PREDOP_TVARS_NEQ) {
+			Coroutine* co1 = instr.tvar1 == NULL ? t : instr.tvar1->thread();
+			Coroutine* co2 = instr.tvar2->thread();
+			if(co1 == NULL || co2 == NULL) {
+				acc = true;
+			} else {
+				acc = (co1->tid() == co2->tid()) == (instr.op == PREDOP_TVARS_EQ);
+			}
+		} else
+		if(instr.op == PREDOP_FUNCTION) {
+			acc = instr.fn(instr.fn_arg, safe_notnull(t));
+		} else {
+			safe_assert(instr.op == PREDOP_CALL);
+			acc = instr.pred->EvalState(t);
+		}
+		pc = acc ? instr.next_true : instr.next_false;
+	}
+	safe_assert(pc == PREDPC_END_TRUE || pc == PREDPC_END_FALSE);
+	return pc == PREDPC_END_TRUE;
+}
+
+// the first instruction from pc on that computes a value, given the accumulator before pc
+static int ResolvePC(const std::vector<PredicateInstr>& code, int pc, bool acc) {
+	const int size = static_cast<int>(code.size());
+	for(;;) {
+		if(pc >= size) {
+			return acc ? PREDPC_END_TRUE : PREDPC_END_FALSE;
+		}
+		const PredicateInstr& instr = code[pc];
+		switch(instr.op) {
+		case PREDOP_NOT:
+			acc = !acc;
+			++pc;
+			break;
+		case PREDOP_JUMP_FALSE:
+			pc += acc ? 1 : instr.offset;
+			break;
+		case PREDOP_JUMP_TRUE:
+			pc += acc ? instr.offset : 1;
+			break;
+		default:
+			return pc;
+		}
+	}
+}
+
+void PredicateProgram::Link() {
+	for(size_t pc = 0; pc < code_.size(); ++pc) {
+		PredicateInstr& instr = code_[pc];
+		instr.next_true = ResolvePC(code_, pc + 1, true);
+		instr.next_false = ResolvePC(code_, pc + 1, false);
+	}
+	entry_ = ResolvePC(code_, 0, value_);
+}
+
+/*************************************************************************************/
+
+void PredicateProgram::EmitConstant(bool value) {
+	safe_assert(code_.empty());
+	value_ = value;
+}
+
+void PredicateProgram::EmitCall(TransitionPredicate* pred) {
+	safe_assert(code_.empty() && pred != NULL);
+	PredicateInstr instr(PREDOP_CALL);
+	instr.pred = pred;
+	code_.push_back(instr);
+	dependencies_ |= AUXDEP_UNKNOWN;
+	pure_ = false;
+}
+
+void PredicateProgram::EmitAux(AuxPredicateFunction fn, void* arg, ThreadVar* tvar, unsigned dependency) {
+	safe_assert(code_.empty() && fn != NULL);
+	PredicateInstr instr(PREDOP_AUX);
+	instr.aux_fn = fn;
+	instr.aux_arg = arg;
+	// TID is bound to t whenever the program runs, so read t's state directly
+	instr.tvar1 = (tvar == AuxState::Tid.get()) ? NULL : tvar;
+	code_.push_back(instr);
+	dependencies_ |= AuxDependencyOn(dependency, tvar);
+	// an operand over another thread's state requires its thread variable to be bound,
+	// which an earlier operand may check, so it must not be moved before that operand.
+	// TID is always bound, so operands over TID can be moved
+	pure_ = pure_ && (instr.tvar1 == NULL);
+}
+
+void PredicateProgram::EmitFunction(PredicateFunction fn, void* arg, unsigned dependency /*= AUXDEP_UNKNOWN*/) {
+	safe_assert(code_.empty() && fn != NULL);
+	PredicateInstr instr(PREDOP_FUNCTION);
+	instr.fn = fn;
+	instr.fn_arg = arg;
+	code_.push_back(instr);
+	dependencies_ |= dependency;
+	// functors with known inputs are the expression templates, which have no side effects
+	pure_ = pure_ && ((dependency & AUXDEP_UNKNOWN) == 0);
+}
+
+void PredicateProgram::EmitThreadVarsEqual(ThreadVar* tvar1, ThreadVar* tvar2, bool negate /*= false*/) {
+	safe_assert(code_.empty() && tvar1 != NULL && tvar2 != NULL);
+	PredicateInstr instr(negate ? PREDOP_TVARS_NEQ : PREDOP_TVARS_EQ);
+	// as in EmitAux, TID is bound to t
+	instr.tvar1 = (tvar1 == AuxState::Tid.get()) ? NULL : tvar1;
+	instr.tvar2 = tvar2;
+	code_.push_back(instr);
+	dependencies_ |= AUXDEP_THREADS;
+}
+
+void PredicateProgram::EmitNot() {
+	if(code_.empty()) {
+		value_ = !value_;
+	} else {
+		code_.push_back(PredicateInstr(PREDOP_NOT));
+	}
+	entry_ = PREDPC_UNLINKED;
+}
+
+/*************************************************************************************/
+
+void PredicateProgram::EmitNAry(NAryOp op, std::vector<TransitionPredicatePtr>* preds) {
+	std::vector<PredicateProgram> operands(preds->size());
+	for(size_t i = 0; i < preds->size(); ++i) {
+		(*preds)[i]->Compile(&operands[i]);
+	}
+	EmitNAry(op, &operands);
+}
+
+// appends an operand of an n-ary program. the jumps of the operand to its own end on the decisive
+// value are collected into jumps with the jumps between the operands, so they all go to the end
+static void AppendOperand(std::vector<PredicateInstr>* code, const std::vector<PredicateInstr>& operand, PredicateOpcode jump, std::vector<int>* jumps) {
+	if(!code->empty()) {
+		jumps->push_back(static_cast<int>(code->size()));
+		code->push_back(PredicateInstr(jump));
+	}
+	const int base = static_cast<int>(code->size());
+	const int size = static_cast<int>(operand.size());
+	for(int k = 0; k < size; ++k) {
+		code->push_back(operand[k]);
+		if(operand[k].op == jump && k + operand[k].offset == size) {
+			jumps->push_back(base + k);
+		}
+	}
+}
+
+// folds the constant operands, and jumps to the end when the value of an operand decides the result
+void PredicateProgram::EmitNAry(NAryOp op, std::vector<PredicateProgram>* operands) {
+	safe_assert(code_.empty());
+	const bool decisive = (op == NAryOR);
+	const PredicateOpcode jump = decisive ? PREDOP_JUMP_TRUE : PREDOP_JUMP_FALSE;
+
+	std::vector<int> jumps;
+	std::vector<PredicateProgram> nonconstants;
+	for(std::vector<PredicateProgram>::iterator itr = operands->begin(); itr != operands->end(); ++itr) {
+		PredicateProgram& operand = (*itr);
+		dependencies_ |= operand.dependencies_;
+		if(operand.is_constant()) {
+			if(operand.value() == decisive) {
+				code_.clear();
+				value_ = decisive;
+				adaptive_.reset();
+				return;
+			}
+			continue;
+		}
+		pure_ = pure_ && operand.pure_;
+		nonconstants.push_back(operand);
+		AppendOperand(&code_, operand.code_, jump, &jumps);
+	}
+
+	if(code_.empty()) {
+		value_ = !decisive;
+	}
+
+	const int end = static_cast<int>(code_.size());
+	for(std::vector<int>::iterator itr = jumps.begin(); itr != jumps.end(); ++itr) {
+		code_[*itr].offset = end - (*itr);
+	}
+
+	// the order of pure operands is adapted at runtime. when this program becomes
+	// an operand of another one, only its code_ is copied into the other program
+	if(pure_ && Config::AdaptiveSampleRate > 0 && BETWEEN(2, nonconstants.size(), AdaptiveNAry::MaxOperands)) {
+		adaptive_.reset(new AdaptiveNAry(op, nonconstants));
+	}
+}
+
+/*************************************************************************************/
+
+uint64_t AdaptiveNAry::sampled_declared_cycles_ = 0;
+uint64_t AdaptiveNAry::sampled_adaptive_cycles_ = 0;
+unsigned long AdaptiveNAry::num_reorders_ = 0;
+
+AdaptiveNAry::AdaptiveNAry(NAryOp op, const std::vector<PredicateProgram>& operands)
+: op_(op), operands_(operands), order_(0), sampling_(false), samples_(0) {
+	safe_assert(BETWEEN(2, operands_.size(), MaxOperands));
+	for(int i = 0; i < MaxOperands; ++i) {
+		cost_[i] = 0;
+		decisive_[i] = 0;
+	}
+	// start with the declaration order
+	for(int i = static_cast<int>(operands_.size()) - 1; i >= 0; --i) {
+		order_ = (order_ << 4) | static_cast<uint64_t>(i);
+		operands_[i].Link();
+	}
+}
+
+/*************************************************************************************/
+
+// evaluates all operands, which is safe since they are pure
+bool AdaptiveNAry::Sample(Coroutine* t, PredicateProgram* program, bool* value) {
+	if(__atomic_exchange_n(&sampling_, true, __ATOMIC_ACQUIRE)) {
+		return false;
+	}
+	const bool decisive = (op_ == NAryOR);
+	const int size = static_cast<int>(operands_.size());
+	bool values[MaxOperands];
+	uint64_t cycles[MaxOperands];
+	bool result = !decisive;
+	for(int i = 0; i < size; ++i) {
+		const uint64_t start = ReadCycleCounter();
+		values[i] = operands_[i].RunLoop(t);
+		cycles[i] = ReadCycleCounter() - start;
+
+		cost_[i] += cycles[i];
+		if(values[i] == decisive) {
+			decisive_[i] += 1;
+			result = decisive;
+		}
+	}
+
+	// what the short circuit evaluation would cost in each order
+	uint64_t declared = 0;
+	for(int i = 0; i < size; ++i) {
+		declared += cycles[i];
+		if(values[i] == decisive) break;
+	}
+	uint64_t adaptive = 0;
+	uint64_t order = order_;
+	for(int i = 0; i < size; ++i, order >>= 4) {
+		adaptive += cycles[order & 0xF];
+		if(values[order & 0xF] == decisive) break;
+	}
+	__atomic_fetch_add(&sampled_declared_cycles_, declared, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&sampled_adaptive_cycles_, adaptive, __ATOMIC_RELAXED);
+
+	if((++samples_ % SamplesPerReorder) == 0) {
+		Reorder(program);
+	}
+	__atomic_store_n(&sampling_, false, __ATOMIC_RELEASE);
+	*value = result;
+	return true;
+}
+
+/*************************************************************************************/
+
+// sorts by the expected cost per decisive value (cost_/decisive_, with add-one smoothing).
+// halving the profile afterwards lets the order follow changes in the workload.
+// the scenario evaluates one transition at a time (TID is shared), and the new code has
+// the same size as the old one, so it is written over the old code in place
+void AdaptiveNAry::Reorder(PredicateProgram* program) {
+	const int size = static_cast<int>(operands_.size());
+	int indices[MaxOperands];
+	double ranks[MaxOperands];
+	for(int i = 0; i < size; ++i) {
+		indices[i] = i;
+		ranks[i] = cost_[i] / (decisive_[i] + 1);
+		cost_[i] /= 2;
+		decisive_[i] /= 2;
+	}
+	// insertion sort, stable so ties keep the declaration order
+	for(int i = 1; i < size; ++i) {
+		int k = indices[i];
+		int j = i - 1;
+		for(; j >= 0 && ranks[indices[j]] > ranks[k]; --j) {
+			indices[j+1] = indices[j];
+		}
+		indices[j+1] = k;
+	}
+
+	uint64_t order = 0;
+	for(int i = size - 1; i >= 0; --i) {
+		order = (order << 4) | static_cast<uint64_t>(indices[i]);
+	}
+	if(order == order_) {
+		return;
+	}
+	order_ = order;
+	__atomic_fetch_add(&num_reorders_, 1UL, __ATOMIC_RELAXED);
+
+	// same layout as EmitNAry, with the operands in the new order
+	const PredicateOpcode jump = (op_ == NAryOR) ? PREDOP_JUMP_TRUE : PREDOP_JUMP_FALSE;
+	std::vector<PredicateInstr> reordered;
+	std::vector<int> jumps;
+	for(int i = 0; i < size; ++i, order >>= 4) {
+		AppendOperand(&reordered, operands_[order & 0xF].code(), jump, &jumps);
+	}
+	const int end = static_cast<int>(reordered.size());
+	for(std::vector<int>::iterator itr = jumps.begin(); itr != jumps.end(); ++itr) {
+		reordered[*itr].offset = end - (*itr);
+	}
+	std::vector<PredicateInstr>& code = program->code();
+	safe_assert(reordered.size() == code.size());
+	std::copy(reordered.begin(), reordered.end(), code.begin());
+	program->Link();
+}
+
+/*************************************************************************************/
+
+std::string PredicateProgram::ToString() {
+	std::stringstream s;
+	if(code_.empty()) {
+		s << (value_ ? "true" : "false");
+	}
+	for(size_t i = 0; i < code_.size(); ++i) {
+		if(i > 0) s << "; ";
+		const PredicateInstr& instr = code_[i];
+		switch(instr.op) {
+		case PREDOP_CALL: s << "call"; break;
+		case PREDOP_AUX: s << "aux"; break;
+		case PREDOP_FUNCTION: s << "function"; break;
+		case PREDOP_TVARS_EQ: s << "tvars-eq"; break;
+		case PREDOP_TVARS_NEQ: s << "tvars-neq"; break;
+		case PREDOP_NOT: s << "not"; break;
+		case PREDOP_JUMP_FALSE: s << "jump-false " << instr.offset; break;
+		case PREDOP_JUMP_TRUE: s << "jump-true " << instr.offset; break;
+		default: unreachable();
+		}
+	}
+	return s.str();
+}
+
+/*************************************************************************************/
+
+TransitionConjunction::~TransitionConjunction() {
+	for(int i = 0; i < AuxSlotTable<Slot>::MaxSlots; ++i) {
+		Slot* slot = slots_.at(i);
+		if(slot != NULL && slot->values != NULL) {
+			free(slot->values);
+		}
+	}
+}
+
+void TransitionConjunction::Update(const TransitionConstraintsPtr& preds) {
+	version_ = NextAuxEpoch(version_);
+	dependencies_ = AUXDEP_NONE;
+
+	if(preds == NULL || preds->empty()) {
+		conjuncts_.reset();
+		return;
+	}
+
+	ConjunctsPtr conjuncts(new Conjuncts());
+	conjuncts->version = version_;
+	conjuncts->preds.assign(preds->begin(), preds->end());
+	conjuncts->programs.resize(preds->size());
+	for(size_t i = 0; i < preds->size(); ++i) {
+		conjuncts->programs[i].Compile(conjuncts->preds[i]);
+		dependencies_ |= conjuncts->programs[i].dependencies();
+	}
+	conjuncts_ = conjuncts;
+}
+
+void TransitionConjunction::AddChanges(THREADID tid, unsigned changes) {
+	slots_.get(tid)->changes |= changes;
+}
+
+// evaluates the conjuncts in order, and stops at the first false one like NAryTransitionPredicate.
+// the conjuncts after it are not evaluated, so their values are dropped if their inputs changed
+// the conjuncts are borrowed: they are replaced only by the installers, not while a transition is evaluated
+bool TransitionConjunction::Eval(Coroutine* t, unsigned tree_version, int* num_evals) {
+	Conjuncts* conjuncts = conjuncts_.get();
+	if(conjuncts == NULL) return true;
+
+	const unsigned n = conjuncts->programs.size();
+	Slot* slot = slots_.get(safe_notnull(t)->tid());
+	if(slot->size < n) {
+		char* values = static_cast<char*>(realloc(slot->values, n));
+		safe_assert(values != NULL);
+		slot->values = values;
+		slot->size = n;
+		slot->version = 0;
+	}
+	if(slot->version != conjuncts->version) {
+		memset(slot->values, CONJUNCT_UNKNOWN, n);
+		slot->version = conjuncts->version;
+	}
+
+	// the variables the last evaluated transition updated were reset when it finished
+	const unsigned changes = slot->changes | slot->last_changes | (slot->tree_version != tree_version ? AUXDEP_THREADS : AUXDEP_NONE);
+	bool result = true;
+	for(unsigned i = 0; i < n; ++i) {
+		PredicateProgram& program = conjuncts->programs[i];
+		char& value = slot->values[i];
+		const bool stale = (value == CONJUNCT_UNKNOWN) || program.DependsOn(changes);
+		if(!result) {
+			if(stale) value = CONJUNCT_UNKNOWN;
+			continue;
+		}
+		if(stale) {
+			value = program.Eval(t) ? CONJUNCT_TRUE : CONJUNCT_FALSE;
+			++(*num_evals);
+		}
+		result = (value == CONJUNCT_TRUE);
+	}
+
+	slot->last_changes = slot->changes;
+	slot->changes = AUXDEP_NONE;
+	slot->tree_version = tree_version;
+	return result;
+}
 
 /*************************************************************************************/
 
+PredicateTable::Table PredicateTable::table_;
+unsigned long PredicateTable::epoch_ = 0;
+Mutex PredicateTable::mutex_;
+
+__thread PredicateBuildCache* PredicateBuildCache::current_ = NULL;
+
+// a DSL statement finds the predicates it built in an earlier execution in its build cache,
+// they may have been evicted from the table since, which only means other statements build their own
+TransitionPredicatePtr PredicateTable::Find(const PredicateKey& key) {
+	PredicateBuildCache* cache = PredicateBuildCache::Current();
+	if(cache != NULL) {
+		TransitionPredicatePtr p = cache->Find(key);
+		if(p != NULL) {
+			return p;
+		}
+	}
+
+	ScopeMutex m(&mutex_);
+	Table::iterator itr = table_.find(key);
+	if(itr == table_.end()) {
+		return TransitionPredicatePtr();
+	}
+	itr->second.epoch = epoch_;
+	if(cache != NULL) {
+		cache->Add(key, itr->second.pred);
+	}
+	return itr->second.pred;
+}
+
+TransitionPredicatePtr PredicateTable::Insert(const PredicateKey& key, const TransitionPredicatePtr& pred) {
+	safe_assert(pred != NULL);
+	ScopeMutex m(&mutex_);
+	Entry entry = { pred, epoch_ };
+	std::pair<Table::iterator, bool> res = table_.insert(std::make_pair(key, entry));
+	res.first->second.epoch = epoch_;
+	res.first->second.pred->set_interned(true);
+	PredicateBuildCache* cache = PredicateBuildCache::Current();
+	if(cache != NULL) {
+		cache->Add(key, res.first->second.pred);
+	}
+	return res.first->second.pred;
+}
+
+// evicted predicates stay alive while the execution tree or a composite refers to them,
+// so their addresses are not reused under other keys
+void PredicateTable::EndExecution() {
+	ScopeMutex m(&mutex_);
+	for(Table::iterator itr = table_.begin(); itr != table_.end();) {
+		if(itr->second.epoch != epoch_) {
+			table_.erase(itr++);
+		} else {
+			++itr;
+		}
+	}
+	++epoch_;
+}
+
+size_t PredicateTable::Size() {
+	ScopeMutex m(&mutex_);
+	return table_.size();
+}
+
+/*************************************************************************************/
+
+// composite predicates are interned only if their operands are, otherwise the table would keep
+// alive the predicates built anew in each iteration
+
 TransitionPredicatePtr operator!(const TransitionPredicatePtr& pred) {
-	TransitionPredicatePtr p(new NotTransitionPredicate(pred));
+	if(!TransitionPredicate::IsInterned(pred)) {
+		TransitionPredicatePtr p(new NotTransitionPredicate(pred));
+		return p;
+	}
+	PredicateKey key(PKIND_NOT, PKEY_PTR(pred));
+	TransitionPredicatePtr p = PredicateTable::Find(key);
+	if(p == NULL) {
+		p = PredicateTable::Insert(key, TransitionPredicatePtr(new NotTransitionPredicate(pred)));
+	}
 	return p;
 }
 
 /********************************************************************************/
 
-TransitionPredicatePtr operator &&(const TransitionPredicatePtr& pred1, const TransitionPredicatePtr& pred2) {
-	TransitionPredicatePtr p(new NAryTransitionPredicate<NAryAND>(pred1, pred2));
+template<NAryOp op_>
+static TransitionPredicatePtr MakeNAry(const TransitionPredicatePtr& pred1, const TransitionPredicatePtr& pred2) {
+	if(!TransitionPredicate::IsInterned(pred1) || !TransitionPredicate::IsInterned(pred2)) {
+		TransitionPredicatePtr p(new NAryTransitionPredicate<op_>(pred1, pred2));
+		return p;
+	}
+	PredicateKey key(op_ == NAryAND ? PKIND_AND : PKIND_OR, PKEY_PTR(pred1), PKEY_PTR(pred2));
+	TransitionPredicatePtr p = PredicateTable::Find(key);
+	if(p == NULL) {
+		p = PredicateTable::Insert(key, TransitionPredicatePtr(new NAryTransitionPredicate<op_>(pred1, pred2)));
+	}
 	return p;
 }
 
+TransitionPredicatePtr operator &&(const TransitionPredicatePtr& pred1, const TransitionPredicatePtr& pred2) {
+	return MakeNAry<NAryAND>(pred1, pred2);
+}
+
 TransitionPredicatePtr operator ||(const TransitionPredicatePtr& pred1, const TransitionPredicatePtr& pred2) {
-	TransitionPredicatePtr p(new NAryTransitionPredicate<NAryOR>(pred1, pred2));
-	return p;
+	return MakeNAry<NAryOR>(pred1, pred2);
 }
 
 /********************************************************************************/
@@ -211,6 +893,10 @@ public:
 		return co1->tid() == co2->tid();
 	}
 
+	void Compile(PredicateProgram* program) {
+		program->EmitThreadVarsEqual(tvar1_.get(), tvar2_.get());
+	}
+
 	static TransitionPredicatePtr create(const ThreadVarPtr& tvar1, const ThreadVarPtr& tvar2) {
 		TransitionPredicatePtr p(new TPThreadVarsEqual(tvar1, tvar2));
 		return p;
@@ -238,6 +924,10 @@ public:
 		return co1->tid() != co2->tid();
 	}
 
+	void Compile(PredicateProgram* program) {
+		program->EmitThreadVarsEqual(tvar1_.get(), tvar2_.get(), true);
+	}
+
 	static TransitionPredicatePtr create(const ThreadVarPtr& tvar1, const ThreadVarPtr& tvar2) {
 		TransitionPredicatePtr p(new TPThreadVarsNotEqual(tvar1, tvar2));
 		return p;
@@ -255,6 +945,7 @@ AssertionInstaller::AssertionInstaller(Scenario* scenario, const TransitionPredi
 	safe_assert(scenario_ != NULL);
 	safe_assert(pred_ != NULL);
 	scenario_->trans_assertions()->push_back(pred_);
+	scenario_->UpdateTransitionConjunctions();
 }
 
 AssertionInstaller::~AssertionInstaller() {
@@ -263,6 +954,7 @@ AssertionInstaller::~AssertionInstaller() {
 	safe_assert(!scenario_->trans_assertions()->empty());
 	safe_assert(scenario_->trans_assertions()->back().get() == pred_.get());
 	scenario_->trans_assertions()->pop_back();
+	scenario_->UpdateTransitionConjunctions();
 }
 
 /********************************************************************************/
@@ -272,6 +964,7 @@ ConstraintInstaller::ConstraintInstaller(Scenario* scenario, const TransitionPre
 	safe_assert(scenario_ != NULL);
 	safe_assert(pred_ != NULL);
 	scenario_->trans_constraints()->push_back(pred_);
+	scenario_->UpdateTransitionConjunctions();
 }
 
 ConstraintInstaller::~ConstraintInstaller() {
@@ -280,16 +973,27 @@ ConstraintInstaller::~ConstraintInstaller() {
 	safe_assert(!scenario_->trans_constraints()->empty());
 	safe_assert(scenario_->trans_constraints()->back().get() == pred_.get());
 	scenario_->trans_constraints()->pop_back();
+	scenario_->UpdateTransitionConjunctions();
 }
 
 /********************************************************************************/
 
 TransitionPredicatePtr operator == (const ThreadVarPtr& t1, const ThreadVarPtr& t2) {
-	return TPThreadVarsEqual::create(t1, t2);
+	PredicateKey key(PKIND_TVARS_EQ, PKEY_PTR(t1), PKEY_PTR(t2));
+	TransitionPredicatePtr p = PredicateTable::Find(key);
+	if(p == NULL) {
+		p = PredicateTable::Insert(key, TPThreadVarsEqual::create(t1, t2));
+	}
+	return p;
 }
 
 TransitionPredicatePtr operator != (const ThreadVarPtr& t1, const ThreadVarPtr& t2) {
-	return TPThreadVarsNotEqual::create(t1, t2);
+	PredicateKey key(PKIND_TVARS_NEQ, PKEY_PTR(t1), PKEY_PTR(t2));
+	TransitionPredicatePtr p = PredicateTable::Find(key);
+	if(p == NULL) {
+		p = PredicateTable::Insert(key, TPThreadVarsNotEqual::create(t1, t2));
+	}
+	return p;
 }
 
 /********************************************************************************/
@@ -366,6 +1070,97 @@ THREADID ThreadVar::tid() {
 	return thread_->tid();
 }
 
+/********************************************************************************/
+
+void ThreadVar::RemoveSet(ThreadVarPtrSet* set) {
+	std::vector<ThreadVarPtrSet*>::iterator itr = std::find(sets_.begin(), sets_.end(), set);
+	safe_assert(itr != sets_.end());
+	sets_.erase(itr);
+}
+
+/********************************************************************************/
+
+void ThreadVarPtrSet::Reindex() {
+	if(!stale_) {
+		return;
+	}
+	tids_.clear();
+	by_tid_.clear();
+	for(iterator itr = begin(); itr != end(); ++itr) {
+		const ThreadVarPtr& t = *itr;
+		if(t->is_empty()) continue;
+		THREADID tid = t->tid();
+		if(tids_.contains(tid)) continue; // keep the first member in set order
+		if(static_cast<size_t>(tid) >= by_tid_.size()) {
+			by_tid_.resize(tid + 1, NULL);
+		}
+		by_tid_[tid] = &t;
+		tids_.insert(tid);
+	}
+	stale_ = false;
+}
+
+/********************************************************************************/
+
+const ThreadVarPtr ThreadVarPtrSet::None;
+
+const ThreadVarPtr& ThreadVarPtrSet::FindByThread(Coroutine* thread) {
+	if(thread == NULL) {
+		// unbound members are not indexed
+		for(iterator itr = begin(); itr != end(); ++itr) {
+			if((*itr)->is_empty()) {
+				return *itr;
+			}
+		}
+		return None;
+	}
+	THREADID tid = thread->tid();
+	Reindex();
+	if(!tids_.contains(tid)) {
+		return None;
+	}
+	const ThreadVarPtr& t = *by_tid_[tid];
+	safe_assert(t->thread() == thread);
+	return t;
+}
+
+/********************************************************************************/
+
+ThreadRestriction ThreadRestriction::current_;
+
+bool ThreadRestriction::Allows(Coroutine* thread) const {
+	safe_assert(thread != NULL);
+	for(std::vector<ThreadVarPtrSet*>::const_iterator itr = without_.begin(), end = without_.end(); itr != end; ++itr) {
+		if((*itr)->FindByThread(thread) != NULL) {
+			return false;
+		}
+	}
+	for(std::vector<ThreadVarPtrSet*>::const_iterator itr = with_.begin(), end = with_.end(); itr != end; ++itr) {
+		if((*itr)->FindByThread(thread) == NULL) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ThreadRestriction::Allows(const ThreadVarPtr& t) const {
+	safe_assert(t != NULL);
+	if(!t->is_empty()) {
+		return Allows(t->thread());
+	}
+	for(std::vector<ThreadVarPtrSet*>::const_iterator itr = without_.begin(), end = without_.end(); itr != end; ++itr) {
+		if((*itr)->find(t) != (*itr)->end()) {
+			return false;
+		}
+	}
+	for(std::vector<ThreadVarPtrSet*>::const_iterator itr = with_.begin(), end = with_.end(); itr != end; ++itr) {
+		if((*itr)->find(t) == (*itr)->end()) {
+			return false;
+		}
+	}
+	return true;
+}
+
 /********************************************************************************/
 //int ThreadVar::next_id_ = 0;
 //
@@ -420,9 +1215,21 @@ bool TPInFunc::EvalState(Coroutine* t /*= NULL*/) {
 	return AuxState::InFunc->get(addr_, tid) > 0;
 }
 
+void TPInFunc::Compile(PredicateProgram* program) {
+	program->EmitAux(&TPInFunc::IsInFunc, this, tvar_.get(), AUXDEP_INFUNC);
+}
+
+bool TPInFunc::IsInFunc(void* pred, THREADID tid) {
+	return AuxState::InFunc->get(static_cast<TPInFunc*>(pred)->addr_, tid) > 0;
+}
+
 TransitionPredicatePtr TPInFunc::create(const ADDRINT& addr, const ThreadVarPtr& tvar /*= ThreadVarPtr()*/) {
 	safe_assert(addr != 0);
-	TransitionPredicatePtr p(new TPInFunc(addr, tvar));
+	PredicateKey key(PKIND_IN_FUNC, static_cast<uint64_t>(addr), PKEY_PTR(tvar));
+	TransitionPredicatePtr p = PredicateTable::Find(key);
+	if(p == NULL) {
+		p = PredicateTable::Insert(key, TransitionPredicatePtr(new TPInFunc(addr, tvar)));
+	}
 	return p;
 }
 
@@ -430,19 +1237,62 @@ TransitionPredicatePtr TPInFunc::create(const ADDRINT& addr, const ThreadVarPtr&
 
 // Thread expressions
 
+bool ThreadExpr::TidEquals(ThreadVar* var, bool negate /*= false*/) {
+	safe_assert(var != NULL);
+	Coroutine* co1 = AuxState::Tid->thread();
+	Coroutine* co2 = var->thread();
+	if(co1 == NULL || co2 == NULL) {
+		return true;
+	}
+	return (co1->tid() == co2->tid()) != negate;
+}
+
+// interns the thread expression built by new_expr under key
+#define INTERN_THREAD_EXPR(key, new_expr) \
+	TransitionPredicatePtr p = PredicateTable::Find(key); \
+	if(p == NULL) { \
+		p = PredicateTable::Insert(key, TransitionPredicatePtr(new_expr)); \
+	} \
+	return boost::static_pointer_cast<ThreadExpr>(p);
+
+ThreadExprPtr AnyThreadExpr::create() {
+	INTERN_THREAD_EXPR(PredicateKey(PKIND_ANY_THREAD), new AnyThreadExpr());
+}
+
+ThreadExprPtr ThreadVarExpr::create(const ThreadVarPtr& t) {
+	INTERN_THREAD_EXPR(PredicateKey(PKIND_BY, PKEY_PTR(t)), new ThreadVarExpr(t));
+}
+
+ThreadExprPtr NegThreadVarExpr::create(const ThreadVarPtr& t) {
+	INTERN_THREAD_EXPR(PredicateKey(PKIND_NOT_BY, PKEY_PTR(t)), new NegThreadVarExpr(t));
+}
+
+ThreadExprPtr PlusThreadExpr::create(const ThreadExprPtr& e, const ThreadVarPtr& t) {
+	if(!TransitionPredicate::IsInterned(e)) {
+		ThreadExprPtr p(new PlusThreadExpr(e, t));
+		return p;
+	}
+	INTERN_THREAD_EXPR(PredicateKey(PKIND_PLUS_THREAD, PKEY_PTR(e), PKEY_PTR(t)), new PlusThreadExpr(e, t));
+}
+
+ThreadExprPtr MinusThreadExpr::create(const ThreadExprPtr& e, const ThreadVarPtr& t) {
+	if(!TransitionPredicate::IsInterned(e)) {
+		ThreadExprPtr p(new MinusThreadExpr(e, t));
+		return p;
+	}
+	INTERN_THREAD_EXPR(PredicateKey(PKIND_MINUS_THREAD, PKEY_PTR(e), PKEY_PTR(t)), new MinusThreadExpr(e, t));
+}
+
 ThreadExprPtr operator + (const ThreadExprPtr& e, const ThreadVarPtr& t) {
-	ThreadExprPtr p(new PlusThreadExpr(e, t));
-	return p;
+	return PlusThreadExpr::create(e, t);
 }
 
 ThreadExprPtr operator - (const ThreadExprPtr& e, const ThreadVarPtr& t) {
-	ThreadExprPtr p(new MinusThreadExpr(e, t));
-	return p;
+	return MinusThreadExpr::create(e, t);
 }
 
 ThreadExprPtr operator ! (const ThreadVarPtr& t) {
-	ThreadExprPtr p(new NegThreadVarExpr(t));
-	return p;
+	return NegThreadVarExpr::create(t);
 }
 
 
@@ -80,7 +80,8 @@ void short_sleep(long nanoseconds, bool continue_on_signal) {
 
 	int rval = 0;
 	do {
-		rval = nanosleep(&tv, &tv);
+		// the original, since the interposed nanosleep does not block on the virtual clock
+		rval = (PthreadOriginals::nanosleep(&tv, &tv) == 0) ? 0 : errno;
 		if(rval == EINVAL) {
 			safe_fail("Invalid time value: %lu\n", nanoseconds);
 		}